@@ -1,36 +1,85 @@
 #pragma once
 
+#include "AllocatorConfig.hpp"
 #include "DefaultAllocator.hpp"
 #include "AllocityHashtable.hpp"
 #include "MemoryPool.hpp"
+#include "LatencyHistogram.hpp"
+#include "TlsfHeap.hpp"
+#include "BuddyAllocator.hpp"
+#include "SlabArena.hpp"
+#include "PerCpuCache.hpp"
+#include "HeapSnapshot.hpp"
+#include "MemoryTag.hpp"
 #include <functional>
+#include <future>
 #include <mutex>
 #include <unordered_set>
 #include <vector>
 #include <thread>
 #include <queue>
 #include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace allocity {
 
+struct ReserveResult {
+    std::size_t PrefaultedBytes = 0;
+    std::size_t LockedBytes = 0;
+};
+
+enum class AllocationFlags : unsigned {
+    None = 0,
+    // Take the region's page faults on the worker threads.
+    Prefault = 1 << 0,
+    // Zero the region on the worker threads (implies Prefault).
+    Zero = 1 << 1
+};
+
+constexpr AllocationFlags operator|(AllocationFlags a, AllocationFlags b) {
+    return static_cast<AllocationFlags>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+}
+
+constexpr bool HasFlag(AllocationFlags flags, AllocationFlags flag) {
+    return (static_cast<unsigned>(flags) & static_cast<unsigned>(flag)) != 0;
+}
+
+class EpochDomain;
+
 class Allocator {
+    // Hands reclaimed batches to the worker pool.
+    friend class EpochDomain;
+
 private:
+    AllocatorConfig m_Config;
     DefaultAllocator m_DefaultAllocator;
     AllocityHashtable m_AllocationMap;
     mutable std::mutex m_AllocationMutex;
-    std::unordered_set<void*> m_DeallocatedPointers;
     std::atomic<bool> m_debugMode;
     static constexpr unsigned char DEBUG_PATTERN = 0xFE;
 
     
-    static constexpr size_t MAX_SMALL_OBJECT_SIZE = 256;
-    static constexpr size_t NUM_MEMORY_POOLS = MAX_SMALL_OBJECT_SIZE / 8;
+    static constexpr size_t MAX_SMALL_OBJECT_SIZE = AllocatorConfig::MAX_SMALL_OBJECT_LIMIT;
+    static constexpr size_t NUM_MEMORY_POOLS = MAX_SMALL_OBJECT_SIZE / AllocatorConfig::SIZE_CLASS_GRANULARITY;
+    BuddyAllocator m_PageHeap;
+    SlabArena m_SlabArena;
     std::vector<std::unique_ptr<MemoryPool>> m_MemoryPools;
+    std::atomic<MemoryPool*> m_PoolTable[NUM_MEMORY_POOLS];
+    std::mutex m_PoolCreationMutex;
+    // Null unless the config enables per-CPU caches.
+    std::unique_ptr<PerCpuCache> m_CpuCache;
+    // With per-CPU caches, pool blocks stay out of m_AllocationTracker;
+    // each pool gets one record per block instead, indexed by block.
+    struct PoolBlockRecord {
+        std::size_t size;
+        MemoryTag tag;
+    };
+    std::unique_ptr<PoolBlockRecord[]> m_PoolBlockRecords[NUM_MEMORY_POOLS];
 
-    
-    thread_local static std::unordered_map<void*, std::size_t> t_recentAllocations;
-    thread_local static std::unordered_set<void*> t_recentDeallocations;
+    TlsfHeap m_MediumHeap;
 
     
     std::vector<std::thread> m_ThreadPool;
@@ -38,17 +87,30 @@ private:
     std::condition_variable m_ThreadPoolCondition;
     std::atomic<bool> m_StopThreads;
     std::queue<std::function<void()>> m_WorkQueue;
+    std::once_flag m_ThreadPoolStarted;
+
+    static constexpr size_t PREFAULT_CHUNK_SIZE = 2 * 1024 * 1024;
+    static constexpr size_t ASYNC_CHUNKS_PER_WORKER = 4;
+    std::atomic<std::size_t> m_LockedBytes;
 
     
     struct AllocationInfo {
         std::size_t size;
-        bool isPoolAllocation;
+        AllocationPath path;
+        MemoryTag tag;
     };
-    std::unordered_map<void*, AllocationInfo> m_AllocationTracker;
+    // Grows incrementally, so no Allocate stalls on a full rehash under
+    // m_AllocationMutex.
+    BasicAllocityHashtable<AllocationInfo> m_AllocationTracker;
     mutable std::mutex m_AllocationTrackerMutex;
 
+    LatencyRecorder m_LatencyRecorder;
+
 public:
+    static constexpr std::size_t GUARANTEED_ALIGNMENT = 8;
+
     Allocator();
+    explicit Allocator(const AllocatorConfig& config);
     ~Allocator();
 
     Allocator(const Allocator&) = delete;
@@ -56,15 +118,93 @@ public:
     Allocator(Allocator&&) = delete;
     Allocator& operator=(Allocator&&) = delete;
 
+    const AllocatorConfig& GetConfig() const;
     const DefaultAllocator& GetDefaultAllocator() const;
     void SetDefaultAllocator(const DefaultAllocator& allocator);
 
-    void* Allocate(std::size_t size);
+    void* Allocate(std::size_t size) {
+        return Allocate(size, MemoryTags::GetCurrent());
+    }
+
+    void* Allocate(std::size_t size, MemoryTag tag) {
+        if (!MemoryTags::Charge(tag, size)) {
+            return nullptr;
+        }
+        // The constant bound is implied by Validate() but lets the compiler
+        // see that the pool index stays inside m_PoolTable.
+        const bool small = size != 0 && size <= MAX_SMALL_OBJECT_SIZE && size <= m_Config.MaxSmallObjectSize;
+        void* ptr = small ? AllocateSmall(PoolIndex(size), size, tag) : AllocateSlow(size, tag);
+        if (ptr == nullptr) {
+            MemoryTags::Release(tag, size);
+        }
+        return ptr;
+    }
+
     void Deallocate(void* ptr);
+
+    // Frees count pointers (nullptr entries are skipped) under a single
+    // acquisition of the tracking lock. All pointers are validated before
+    // any is released; an unknown pointer, or one listed twice, throws and
+    // leaves the whole batch allocated.
+    void DeallocateBatch(void* const* ptrs, std::size_t count);
+
+    // Reserves the region on the calling thread and prefaults or zeroes it
+    // in chunks on the worker threads. The future (or onReady, called on the
+    // worker that finishes last) yields the pointer once the region can be
+    // touched without faulting; nullptr if the allocation was refused. If
+    // preparing the region throws, it is freed and the future holds the
+    // exception (onReady gets nullptr). With no worker threads the work
+    // runs before AllocateAsync returns. The region must not be deallocated
+    // before it is ready; work queued before the allocator is destroyed
+    // still completes.
+    std::future<void*> AllocateAsync(std::size_t size, AllocationFlags flags = AllocationFlags::Prefault);
+    void AllocateAsync(std::size_t size, AllocationFlags flags, std::function<void(void*)> onReady);
+
+    template <std::size_t Size>
+    void* Allocate() {
+        static_assert(Size > 0, "Allocate<Size> requires a non-zero size");
+        const MemoryTag tag = MemoryTags::GetCurrent();
+        if (!MemoryTags::Charge(tag, Size)) {
+            return nullptr;
+        }
+        void* ptr;
+        if constexpr (Size <= MAX_SMALL_OBJECT_SIZE) {
+            ptr = Size <= m_Config.MaxSmallObjectSize ? AllocateSmall(PoolIndex(Size), Size, tag) : AllocateSlow(Size, tag);
+        } else {
+            ptr = AllocateSlow(Size, tag);
+        }
+        if (ptr == nullptr) {
+            MemoryTags::Release(tag, Size);
+        }
+        return ptr;
+    }
+
+    template <std::size_t Size>
+    void Deallocate(void* ptr) {
+        static_assert(Size > 0, "Deallocate<Size> requires a non-zero size");
+        if constexpr (Size <= MAX_SMALL_OBJECT_SIZE) {
+            DeallocateSmall(ptr, PoolIndex(Size));
+        } else {
+            Deallocate(ptr);
+        }
+    }
+    // Moves the allocation to a block of the new size, keeping its memory
+    // tag; copies at or above the config's ParallelThreshold run on the
+    // worker threads. Returns nullptr and leaves ptr intact if the new
+    // block cannot be allocated. Aligned allocations are not supported.
+    void* Reallocate(void* ptr, std::size_t size);
+
+    // memset/memcpy that use streaming stores for large sizes and split
+    // the work over the worker threads (and the caller) at or above
+    // ParallelThreshold.
+    void ParallelFill(void* destination, unsigned char value, std::size_t size);
+    void ParallelCopy(void* destination, const void* source, std::size_t size);
+
     void* Assign(void* ptr);
     void Deassign(void* ptr);
 
     void* AlignedAllocate(std::size_t size, std::size_t alignment);
+    void* AlignedAllocate(std::size_t size, std::size_t alignment, MemoryTag tag);
     void AlignedDeallocate(void* ptr);
 
     void SetOutOfMemoryHandler(std::function<void(std::size_t)> handler);
@@ -76,6 +216,35 @@ public:
 
     void ReportMemoryUsage() const;
 
+    // Describes every pool slab and heap span with its occupancy, live
+    // bytes, tags and resident pages (see HeapSnapshot). Holds the
+    // tracking lock throughout; allocations still in flight on other
+    // threads may be missing.
+    HeapSnapshot CaptureHeapSnapshot() const;
+    // Writes CaptureHeapSnapshot() to path for allocity_heap_analyzer.
+    void DumpHeapSnapshot(const std::string& path) const;
+
+    void ReserveMediumHeap(std::size_t bytes);
+
+    // Pre-populates the heap that serves `size` so that `count` such
+    // allocations take no page faults; page faults are taken here, split
+    // across the worker threads. With lockMemory the reserved pages are
+    // also mlock'ed (best effort: see ReserveResult::LockedBytes). Reserving
+    // page-sized classes stops the page heap from decommitting freed spans.
+    ReserveResult Reserve(std::size_t size, std::size_t count, bool lockMemory = false);
+    ReserveResult ReserveBytes(std::size_t bytes, bool lockMemory = false);
+    std::size_t GetLockedBytes() const;
+    std::vector<StandardBlock> DescribeMediumHeap() const;
+    const BuddyAllocator& GetPageHeap() const;
+    const SlabArena& GetSlabArena() const;
+    const PerCpuCache* GetPerCpuCache() const;
+
+    void SetLatencyTracking(bool enable);
+    bool IsLatencyTrackingEnabled() const;
+    LatencyHistogram GetLatencyHistogram(LatencyOperation operation, AllocationPath path) const;
+    double GetLatencyPercentile(LatencyOperation operation, AllocationPath path, double percentile) const;
+    void ResetLatencyHistograms();
+
     std::size_t* FindAllocation(void* ptr);
     std::size_t GetAllocationCount() const;
     bool IsEmpty() const;
@@ -90,13 +259,113 @@ public:
 
 private:
     void InitializeMemoryPools();
+    MemoryPool* CreatePool(std::size_t poolIndex, std::size_t minimumBlocks = 0);
     void InitializeThreadPool(size_t numThreads);
+    void StartThreadPool();
     void ThreadWorker();
-    void* AllocateFromPool(std::size_t size);
-    void DeallocateToPool(void* ptr, std::size_t size);
+    static constexpr std::size_t PoolIndex(std::size_t size) { return (size - 1) / 8; }
+
+    void* AllocateSmall(std::size_t poolIndex, std::size_t size, MemoryTag tag) {
+        const bool timed = m_LatencyRecorder.IsEnabled();
+        const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
+
+        MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool == nullptr && (pool = CreatePool(poolIndex)) == nullptr) {
+            return AllocateSlow(size, tag);
+        }
+        AllocationPath timedPath = AllocationPath::Pool;
+        void* ptr;
+        if (m_CpuCache != nullptr) {
+            // No lock on a cache hit: the block is found again from its
+            // address, and only its own bitmap bit and record are written.
+            ptr = m_CpuCache->Pop(poolIndex);
+            if (ptr != nullptr) {
+                if (!pool->MarkAllocated(ptr)) {
+                    throw std::runtime_error("Per-CPU cache handed out an allocated block");
+                }
+                timedPath = AllocationPath::CpuCache;
+            } else if ((ptr = pool->Allocate()) == nullptr) {
+                return AllocateSlow(size, tag);
+            }
+            m_PoolBlockRecords[poolIndex][pool->GetBlockIndex(ptr)] = {size, tag};
+        } else {
+            if ((ptr = pool->Allocate()) == nullptr) {
+                return AllocateSlow(size, tag);
+            }
+            std::lock_guard<std::mutex> lock(m_AllocationMutex);
+            TrackAllocation(ptr, size, AllocationPath::Pool, tag);
+        }
+        if (m_debugMode) {
+            CheckForUseAfterFree(ptr, size);
+        }
+
+        if (timed) {
+            m_LatencyRecorder.Record(LatencyOperation::Allocate, timedPath, start);
+        }
+        return ptr;
+    }
+
+    void DeallocateSmall(void* ptr, std::size_t poolIndex) {
+        MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (ptr == nullptr || pool == nullptr || !pool->Owns(ptr)) {
+            Deallocate(ptr);
+            return;
+        }
+
+        const bool timed = m_LatencyRecorder.IsEnabled();
+        const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
+
+        AllocationPath timedPath = AllocationPath::Pool;
+        if (m_CpuCache != nullptr) {
+            timedPath = ReleaseUntrackedBlock(pool, poolIndex, ptr);
+        } else {
+            ReleaseAllocation(ptr, "Attempting to deallocate unknown pointer");
+            pool->Deallocate(ptr);
+        }
+
+        if (timed) {
+            m_LatencyRecorder.Record(LatencyOperation::Deallocate, timedPath, start);
+        }
+    }
+
+    // Frees a pool block of the per-CPU mode, which has no tracker entry;
+    // returns the path that took it back, for the latency records. The
+    // record is read before the block is published to the cache.
+    AllocationPath ReleaseUntrackedBlock(MemoryPool* pool, std::size_t poolIndex, void* ptr) {
+        if (!pool->MarkFree(ptr)) {
+            ThrowInvalidFree(ptr, "Attempting to deallocate unknown pointer");
+        }
+        const PoolBlockRecord& record = m_PoolBlockRecords[poolIndex][pool->GetBlockIndex(ptr)];
+        MemoryTags::Release(record.tag, record.size);
+        if (m_CpuCache->Push(poolIndex, ptr)) {
+            return AllocationPath::CpuCache;
+        }
+        pool->ReleaseMarked(ptr);
+        return AllocationPath::Pool;
+    }
+
+    // The pool owning ptr if pool blocks are untracked (per-CPU mode),
+    // else nullptr.
+    MemoryPool* FindUntrackedPool(const void* ptr, std::size_t& poolIndex) const;
+    void ForEachUntrackedBlock(const std::function<void(std::size_t, void*, const PoolBlockRecord&)>& visit) const;
+
+    void* AllocateSlow(std::size_t size, MemoryTag tag);
+    AllocationInfo ReleaseAllocation(void* ptr, const char* unknownPointerMessage);
+    AllocationPath ReleaseBlock(void* ptr, const AllocationInfo& info);
+    [[noreturn]] void ThrowInvalidFree(void* ptr, const char* unknownPointerMessage) const;
+    void CheckForUseAfterFree(void* ptr, std::size_t size) const;
+    // Runs inline when there are no workers or they have been stopped.
     void AddWorkToQueue(std::function<void()> work);
+    // Both AllocateAsync overloads: finish gets the ready region, or
+    // nullptr and the exception that stopped it from being prepared.
+    void PrepareAsync(std::size_t size, AllocationFlags flags, std::function<void(void*, std::exception_ptr)> finish);
+    std::size_t ChunkSizeFor(std::size_t size);
+    void RunChunked(std::size_t chunkCount, const std::function<void(std::size_t)>& task);
+    void PrefaultRanges(const std::vector<std::pair<char*, std::size_t>>& ranges);
+    void LockRange(void* address, std::size_t size, ReserveResult& result);
     bool IsPoolAllocation(std::size_t size) const;
-    void TrackAllocation(void* ptr, std::size_t size, bool isPoolAllocation);
+    bool IsPageAllocation(std::size_t size) const;
+    void TrackAllocation(void* ptr, std::size_t size, AllocationPath path, MemoryTag tag);
     void UntrackAllocation(void* ptr);
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace allocity {
+
+enum class TrackingLevel {
+    // Only the per-pointer size/path record that Deallocate needs.
+    Minimal,
+    // Adds the lookup hashtable and the per-thread map of recent
+    // allocations.
+    Full
+};
+
+const char* ToString(TrackingLevel level);
+
+// Construction-time settings for Allocator. FromEnvironment() starts from
+// the defaults and applies ALLOCITY_CONFIG, a comma-separated list of
+// key=value pairs:
+//
+//   workers=<n|auto>  lazy=<0|1>  max_small=<bytes>  max_medium=<bytes>
+//   pool_blocks=<n>   tracking=<minimal|full>   parallel_threshold=<bytes>
+//   huge_slabs=<0|1>  percpu=<0|1>
+//
+// e.g. ALLOCITY_CONFIG="workers=0,tracking=minimal".
+struct AllocatorConfig {
+    static constexpr std::size_t AUTO_WORKER_THREADS = SIZE_MAX;
+    static constexpr std::size_t SIZE_CLASS_GRANULARITY = 8;
+    static constexpr std::size_t MAX_SMALL_OBJECT_LIMIT = 256;
+    static constexpr const char* ENVIRONMENT_VARIABLE = "ALLOCITY_CONFIG";
+
+    // Worker threads for background work; AUTO_WORKER_THREADS means
+    // hardware_concurrency(), zero runs queued work on the calling thread.
+    std::size_t WorkerThreads = AUTO_WORKER_THREADS;
+    // Create each size-class pool on its first allocation and start the
+    // workers on the first queued task instead of in the constructor.
+    bool LazyInitialization = true;
+    // Largest request served by the size-class pools (multiple of 8, at
+    // most MAX_SMALL_OBJECT_LIMIT); larger requests take the slow path.
+    std::size_t MaxSmallObjectSize = MAX_SMALL_OBJECT_LIMIT;
+    // Largest request served by the TLSF medium heap.
+    std::size_t MaxMediumObjectSize = 1024 * 1024;
+    // Minimum number of blocks in each size-class pool.
+    std::size_t PoolBlocks = 1024;
+    // Pack the pool slabs into 2 MiB-aligned regions advised for
+    // transparent huge pages; when off, slabs are ordinary page-heap spans.
+    bool HugePageSlabs = true;
+    // Keep freed pool blocks in per-CPU caches (Linux rseq, x86-64) so
+    // small allocations skip the pool lock; cached memory grows with the
+    // CPU count, not the thread count. Threads that cannot use rseq go
+    // straight to the pools. Pool blocks then bypass the allocation
+    // tracker and its lock: their size and tag are kept per block and
+    // double frees are caught by the pool bitmaps, so the Full level's
+    // diagnostics cover the other allocations only.
+    bool PerCpuCaches = false;
+    TrackingLevel Tracking = TrackingLevel::Full;
+    // Fills and copies of at least this many bytes (debug poisoning,
+    // Reallocate, ParallelFill/ParallelCopy) are split over the workers.
+    std::size_t ParallelThreshold = 64 * 1024 * 1024;
+
+    static AllocatorConfig FromString(const std::string& settings);
+    static AllocatorConfig FromEnvironment();
+
+    // Overrides the fields named in settings and validates the result.
+    void Apply(const std::string& settings);
+
+    std::size_t ResolveWorkerThreads() const;
+    void Validate() const;
+    std::string ToString() const;
+};
+
+}
@@ -4,10 +4,13 @@ namespace allocity {
 
     struct StandardBlock;
     class Blocks;
-    struct VariadicLayout;
+    struct LayoutDescriptor;
+    template <typename... Ts> struct VariadicLayout;
+    template <typename... Ts> class VariadicArrayLayout;
     class MemoryLayout;
     class DefaultAllocator;
     class Allocator;
+    struct AllocatorConfig;
     class MemoryManager;
 
 }
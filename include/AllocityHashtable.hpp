@@ -1,36 +1,278 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
-#include <vector>
+#include <type_traits>
 
 namespace allocity {
 
-class AllocityHashtable {
+// The parts of BasicAllocityHashtable that do not depend on the value
+// type: hashing and the VirtualMemory calls behind the tables.
+class AllocityHashtableBase {
 public:
-    AllocityHashtable(std::size_t initialCapacity = 16);
-    ~AllocityHashtable();
+    static constexpr std::size_t MIN_CAPACITY = 16;
+    static constexpr std::size_t REHASH_SLOTS_PER_OPERATION = 16;
 
-    void insert(void* key, std::size_t value);
-    bool remove(void* key);
-    std::size_t* find(void* key);
-    void clear();
+protected:
+    static constexpr std::uint8_t EMPTY = 0;
+    static constexpr std::uint8_t OCCUPIED = 1;
+    // Only found in the old table: a slot that was removed but may still
+    // sit on another key's probe sequence.
+    static constexpr std::uint8_t DELETED = 2;
+
+    static std::size_t hash(void* key);
+    static std::size_t roundUpToPowerOfTwo(std::size_t value);
+    static std::size_t tableBytes(std::size_t entryBytes, std::size_t capacity);
+    // Fresh pages are zero, and all-zero bytes are an EMPTY entry.
+    static void* mapTable(std::size_t bytes);
+    static void unmapTable(void* table, std::size_t bytes);
+    static void zeroTable(void* table, std::size_t bytes);
+    // Decommits the migrated part of an old table once it has grown by a
+    // batch; returns the new count of decommitted bytes.
+    static std::size_t decommitMigrated(void* table, std::size_t migratedBytes, std::size_t decommittedBytes);
+};
+
+// Open-addressing (linear probing) map from pointers to trivially
+// copyable values. Growing does not rehash in one go: the full table
+// becomes the old table, a table of twice the size is allocated, and
+// every insert or remove moves at most REHASH_SLOTS_PER_OPERATION old
+// slots across, so no single call pays for the whole table. Lookups check
+// both tables while a migration is running. Tables are mapped from
+// VirtualMemory: a new one needs no clearing, and the old one's pages are
+// decommitted as the migration passes them, so dropping it at the end is
+// cheap as well.
+template <typename Value>
+class BasicAllocityHashtable : public AllocityHashtableBase {
+    static_assert(std::is_trivially_copyable<Value>::value, "Table entries are moved and zeroed bytewise");
+
+public:
+    BasicAllocityHashtable(std::size_t initialCapacity = MIN_CAPACITY)
+        : m_entries(nullptr),
+          m_capacity(roundUpToPowerOfTwo(std::max(initialCapacity, MIN_CAPACITY))),
+          m_size(0),
+          m_oldEntries(nullptr),
+          m_oldCapacity(0),
+          m_migrateIndex(0),
+          m_oldDecommittedBytes(0) {
+        m_entries = allocateEntries(m_capacity);
+    }
+
+    ~BasicAllocityHashtable() {
+        releaseEntries(m_entries, m_capacity);
+        releaseEntries(m_oldEntries, m_oldCapacity);
+    }
+
+    BasicAllocityHashtable(const BasicAllocityHashtable&) = delete;
+    BasicAllocityHashtable& operator=(const BasicAllocityHashtable&) = delete;
+
+    void insert(void* key, const Value& value) {
+        if (m_size >= growThreshold()) {
+            startRehash(m_capacity * 2);
+        }
+        migrate(REHASH_SLOTS_PER_OPERATION);
+
+        if (m_oldEntries != nullptr) {
+            Entry* stale = probeOld(key);
+            if (stale != nullptr) {
+                stale->state = DELETED;
+                --m_size;
+            }
+        }
+        if (place(m_entries, m_capacity, key, value)) {
+            ++m_size;
+        }
+    }
+
+    bool remove(void* key) {
+        migrate(REHASH_SLOTS_PER_OPERATION);
+
+        Entry* entry = probe(m_entries, m_capacity, key);
+        if (entry != nullptr) {
+            eraseFromTable(static_cast<std::size_t>(entry - m_entries));
+            --m_size;
+            return true;
+        }
+        if (m_oldEntries != nullptr && (entry = probeOld(key)) != nullptr) {
+            entry->state = DELETED;
+            --m_size;
+            return true;
+        }
+        return false;
+    }
+
+    Value* find(void* key) {
+        Entry* entry = probe(m_entries, m_capacity, key);
+        if (entry == nullptr && m_oldEntries != nullptr) {
+            entry = probeOld(key);
+        }
+        return entry != nullptr ? &entry->value : nullptr;
+    }
+
+    const Value* find(void* key) const {
+        return const_cast<BasicAllocityHashtable*>(this)->find(key);
+    }
+
+    // Calls visit(key, value) for every entry, in no particular order.
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (std::size_t i = 0; i < m_capacity; ++i) {
+            if (m_entries[i].state == OCCUPIED) {
+                visit(m_entries[i].key, m_entries[i].value);
+            }
+        }
+        // Slots below the cursor have been moved and may be decommitted.
+        for (std::size_t i = m_migrateIndex; i < m_oldCapacity; ++i) {
+            if (m_oldEntries[i].state == OCCUPIED) {
+                visit(m_oldEntries[i].key, m_oldEntries[i].value);
+            }
+        }
+    }
+
+    void clear() {
+        releaseEntries(m_oldEntries, m_oldCapacity);
+        m_oldEntries = nullptr;
+        m_oldCapacity = 0;
+        m_migrateIndex = 0;
+        m_oldDecommittedBytes = 0;
+        zeroTable(m_entries, tableBytes(sizeof(Entry), m_capacity));
+        m_size = 0;
+    }
+
+    // Makes room for count entries without growing again; the move from
+    // the current table is incremental like any other growth.
+    void reserve(std::size_t count) {
+        const std::size_t capacity = roundUpToPowerOfTwo(count + count / 3 + 1);
+        if (capacity > m_capacity) {
+            startRehash(capacity);
+        }
+    }
 
     std::size_t size() const { return m_size; }
     bool empty() const { return m_size == 0; }
+    std::size_t capacity() const { return m_capacity; }
+    bool rehashing() const { return m_oldEntries != nullptr; }
 
 private:
     struct Entry {
         void* key;
-        std::size_t value;
-        bool occupied;
+        Value value;
+        std::uint8_t state;
     };
 
-    std::vector<Entry> m_entries;
-    std::size_t m_size;
+    Entry* m_entries;
     std::size_t m_capacity;
+    std::size_t m_size;
 
-    static std::size_t hash(void* key);
-    void rehash();
+    Entry* m_oldEntries;
+    std::size_t m_oldCapacity;
+    // Old slots below this index have been moved and may be decommitted.
+    std::size_t m_migrateIndex;
+    std::size_t m_oldDecommittedBytes;
+
+    static Entry* allocateEntries(std::size_t capacity) {
+        return static_cast<Entry*>(mapTable(tableBytes(sizeof(Entry), capacity)));
+    }
+
+    static void releaseEntries(Entry* entries, std::size_t capacity) {
+        unmapTable(entries, tableBytes(sizeof(Entry), capacity));
+    }
+
+    static Entry* probe(Entry* entries, std::size_t capacity, void* key) {
+        std::size_t index = hash(key) & (capacity - 1);
+        while (entries[index].state != EMPTY) {
+            if (entries[index].state == OCCUPIED && entries[index].key == key) {
+                return &entries[index];
+            }
+            index = (index + 1) & (capacity - 1);
+        }
+        return nullptr;
+    }
+
+    static bool place(Entry* entries, std::size_t capacity, void* key, const Value& value) {
+        std::size_t index = hash(key) & (capacity - 1);
+        while (entries[index].state == OCCUPIED && entries[index].key != key) {
+            index = (index + 1) & (capacity - 1);
+        }
+        const bool added = entries[index].state != OCCUPIED;
+        entries[index] = {key, value, OCCUPIED};
+        return added;
+    }
+
+    Entry* probeOld(void* key) {
+        // Slots below the migration cursor may already be decommitted, and a
+        // key that sat there has been moved, so the probe skips over them,
+        // including after wrapping around the end of the table.
+        std::size_t index = std::max(hash(key) & (m_oldCapacity - 1), m_migrateIndex);
+        for (std::size_t remaining = m_oldCapacity - m_migrateIndex; remaining != 0; --remaining) {
+            Entry& entry = m_oldEntries[index];
+            if (entry.state == EMPTY) {
+                return nullptr;
+            }
+            if (entry.state == OCCUPIED && entry.key == key) {
+                return &entry;
+            }
+            if (++index == m_oldCapacity) {
+                index = m_migrateIndex;
+            }
+        }
+        return nullptr;
+    }
+
+    std::size_t growThreshold() const { return m_capacity - m_capacity / 4; }
+
+    void startRehash(std::size_t capacity) {
+        // Growth by doubling moves 16 slots per insert against the 3/8 of the
+        // new capacity left before the next growth, so a previous migration
+        // is normally long done; reserve() may still land in the middle of
+        // one.
+        migrate(m_oldCapacity);
+        m_oldEntries = m_entries;
+        m_oldCapacity = m_capacity;
+        m_migrateIndex = 0;
+        m_oldDecommittedBytes = 0;
+        m_entries = allocateEntries(capacity);
+        m_capacity = capacity;
+    }
+
+    void migrate(std::size_t slots) {
+        if (m_oldEntries == nullptr) {
+            return;
+        }
+        const std::size_t end = std::min(m_oldCapacity, m_migrateIndex + slots);
+        for (; m_migrateIndex < end; ++m_migrateIndex) {
+            const Entry& entry = m_oldEntries[m_migrateIndex];
+            if (entry.state == OCCUPIED) {
+                place(m_entries, m_capacity, entry.key, entry.value);
+            }
+        }
+        if (m_migrateIndex == m_oldCapacity) {
+            releaseEntries(m_oldEntries, m_oldCapacity);
+            m_oldEntries = nullptr;
+            m_oldCapacity = 0;
+            m_migrateIndex = 0;
+            return;
+        }
+        m_oldDecommittedBytes = decommitMigrated(m_oldEntries, m_migrateIndex * sizeof(Entry), m_oldDecommittedBytes);
+    }
+
+    void eraseFromTable(std::size_t index) {
+        // Backward-shift deletion: pull later entries of the probe run into
+        // the hole unless that would move them before their home slot, so the
+        // current table never needs tombstones.
+        const std::size_t mask = m_capacity - 1;
+        std::size_t hole = index;
+        for (std::size_t next = (hole + 1) & mask; m_entries[next].state == OCCUPIED; next = (next + 1) & mask) {
+            const std::size_t home = hash(m_entries[next].key) & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                m_entries[hole] = m_entries[next];
+                hole = next;
+            }
+        }
+        m_entries[hole].state = EMPTY;
+    }
 };
 
-} 
\ No newline at end of file
+// Pointer to size, as kept by the Full tracking level.
+using AllocityHashtable = BasicAllocityHashtable<std::size_t>;
+
+}
@@ -5,21 +5,36 @@
 
 
 #include "Allocator.hpp"
+#include "AllocatorConfig.hpp"
 #include "Blocks.hpp"
 #include "DefaultAllocator.hpp"
+#include "EpochDomain.hpp"
+#include "HeapSnapshot.hpp"
+#include "LayoutDescriptor.hpp"
+#include "LockFreeMemoryPool.hpp"
+#include "Log.hpp"
 #include "MemoryLayout.hpp"
+#include "MemoryManager.hpp"
+#include "MemoryTag.hpp"
+#include "PerCpuCache.hpp"
+#include "PersistentPool.hpp"
+#include "ScratchStack.hpp"
+#include "SharedMemoryPool.hpp"
 #include "StandardBlock.hpp"
 #include "VariadicLayout.hpp"
 
 
 namespace allocity {
     using allocity::Allocator;
+    using allocity::AllocatorConfig;
     using allocity::Blocks;
     using allocity::DefaultAllocator;
+    using allocity::LayoutDescriptor;
     using allocity::MemoryLayout;
     using allocity::MemoryManager;
     using allocity::StandardBlock;
     using allocity::VariadicLayout;
+    using allocity::VariadicArrayLayout;
 }
 
 
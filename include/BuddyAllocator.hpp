@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace allocity {
+
+// Binary buddy allocator for page-granular spans carved out of large
+// reserved virtual regions. Free blocks are tracked out-of-band in one
+// bitmap per order (with a summary word per 64 bitmap words), so freed
+// pages are never touched again and can be decommitted; split and merge
+// walk at most one bitmap per order.
+class BuddyAllocator {
+public:
+    static constexpr std::size_t DEFAULT_MIN_BLOCK_SIZE = 4096;
+    static constexpr std::size_t DEFAULT_MAX_BLOCK_SIZE = 2 * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_REGION_SIZE = 256 * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_DECOMMIT_THRESHOLD = 64 * 1024;
+
+    explicit BuddyAllocator(std::size_t regionSize = DEFAULT_REGION_SIZE,
+                            std::size_t minBlockSize = DEFAULT_MIN_BLOCK_SIZE,
+                            std::size_t maxBlockSize = DEFAULT_MAX_BLOCK_SIZE);
+    ~BuddyAllocator();
+
+    BuddyAllocator(const BuddyAllocator&) = delete;
+    BuddyAllocator& operator=(const BuddyAllocator&) = delete;
+    BuddyAllocator(BuddyAllocator&&) = delete;
+    BuddyAllocator& operator=(BuddyAllocator&&) = delete;
+
+    void* Allocate(std::size_t size);
+    void Deallocate(void* ptr);
+
+    bool Owns(const void* ptr) const;
+    std::size_t GetBlockSize(const void* ptr) const;
+    std::size_t RoundUp(std::size_t size) const;
+
+    void SetDecommitThreshold(std::size_t bytes);
+
+    std::size_t GetMinBlockSize() const { return m_minBlockSize; }
+    std::size_t GetMaxBlockSize() const { return m_minBlockSize << m_maxOrder; }
+    std::size_t GetOrderCount() const { return m_maxOrder + 1; }
+
+    std::size_t GetRegionCount() const;
+    std::size_t GetReservedBytes() const;
+    std::size_t GetUsedBytes() const;
+    std::size_t GetFreeBytes() const;
+    std::size_t GetLargestFreeBlock() const;
+    std::vector<std::size_t> GetFreeBlockCounts() const;
+    double GetExternalFragmentation() const;
+
+    void ReportFragmentation(std::ostream& out) const;
+
+    // Calls visit for every allocated and free block of every region in
+    // address order, under the allocator lock.
+    using SpanVisitor = std::function<void(const void* address, std::size_t size, bool isFree)>;
+    void ForEachSpan(const SpanVisitor& visit) const;
+
+private:
+    static constexpr std::uint8_t NOT_ALLOCATED = 0xFF;
+
+    class OrderBitmap {
+    public:
+        explicit OrderBitmap(std::size_t bits);
+
+        void Set(std::size_t index);
+        void Clear(std::size_t index);
+        bool Test(std::size_t index) const {
+            return (m_words[index / 64] >> (index % 64)) & 1;
+        }
+        bool FindFirst(std::size_t& index) const;
+        std::size_t GetCount() const { return m_count; }
+
+    private:
+        std::vector<std::uint64_t> m_words;
+        std::vector<std::uint64_t> m_summary;
+        std::size_t m_count;
+    };
+
+    struct Region {
+        char* base;
+        std::vector<OrderBitmap> freeBlocks;
+        std::vector<std::uint8_t> allocatedOrder;
+    };
+
+    std::size_t OrderFor(std::size_t size) const;
+    Region* AddRegion();
+    Region* FindRegion(const char* ptr) const;
+    void* AllocateFrom(Region& region, std::size_t order);
+    bool LargestFreeOrder(std::size_t& order) const;
+
+    std::size_t m_regionSize;
+    std::size_t m_minBlockSize;
+    std::size_t m_maxOrder;
+    std::size_t m_decommitThreshold;
+    std::vector<std::unique_ptr<Region>> m_regions;
+    std::map<const char*, Region*> m_regionIndex;
+    std::size_t m_usedBytes;
+    mutable std::mutex m_mutex;
+};
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+namespace allocity {
+
+// Single-threaded fill and copy kernels for large buffers. At or above
+// NON_TEMPORAL_THRESHOLD they write with streaming (cache-bypassing) stores
+// where the target supports them, so that poisoning or zeroing a buffer
+// much larger than the cache does not evict the working set; below it they
+// are memset/memcpy. Copy always uses memcpy on glibc, whose memcpy
+// already streams large copies. Allocator splits larger jobs over its
+// worker threads and runs these kernels on each chunk.
+class BulkMemory {
+public:
+    static constexpr std::size_t NON_TEMPORAL_THRESHOLD = 1024 * 1024;
+
+    static void Fill(void* destination, unsigned char value, std::size_t size);
+    static void Copy(void* destination, const void* source, std::size_t size);
+
+    static bool HasNonTemporalStores();
+};
+
+}
@@ -53,7 +53,6 @@ private:
     std::function<void(const DefaultAllocator&)> MemoryUsageReporter;
     std::array<std::atomic<void*>, SMALL_OBJECT_THRESHOLD> smallObjectFreeLists;
     bool m_EnableDoubleFreeCheck;
-    std::unordered_set<void*> m_FreedPointers;
     std::unordered_set<void*> m_AllocatedPointers;
     mutable std::mutex m_AllocationMutex;
 };
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace allocity {
+
+class Allocator;
+
+// Epoch-based reclamation for lock-free structures whose nodes come from an
+// Allocator. Readers pin the current epoch with a Guard while they hold
+// pointers into the structure; a node that has been unlinked is passed to
+// Retire() instead of Deallocate() and is freed once every thread has left
+// the epoch in which it was retired (the global epoch has moved on twice).
+//
+// Retired nodes go to a per-thread list. When a list reaches the batch
+// size its owner tries to advance the epoch and hands the nodes that are
+// safe to the allocator's worker threads, which free them with one
+// DeallocateBatch call. Lists of threads that exit are freed when the
+// domain is destroyed; no thread may be inside a Guard at that point.
+class EpochDomain {
+public:
+    static constexpr std::size_t DEFAULT_RETIRE_BATCH = 256;
+
+    using Destructor = void (*)(void*);
+
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain) : m_domain(domain) { m_domain.Enter(); }
+        ~Guard() { m_domain.Leave(); }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        EpochDomain& m_domain;
+    };
+
+    explicit EpochDomain(Allocator& allocator, std::size_t retireBatch = DEFAULT_RETIRE_BATCH);
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Guards nest; only the outermost Enter/Leave pair pins and unpins.
+    void Enter();
+    void Leave();
+
+    // ptr must come from the domain's allocator and already be unreachable
+    // for threads that pin after this call. destroy, if given, runs just
+    // before the memory is freed.
+    void Retire(void* ptr, Destructor destroy = nullptr);
+
+    template <typename T>
+    void RetireObject(T* object) {
+        Retire(object, [](void* ptr) { static_cast<T*>(ptr)->~T(); });
+    }
+
+    // Moves the global epoch forward if every pinned thread has observed
+    // the current one.
+    bool TryAdvance();
+
+    // Frees whatever the calling thread retired that is already safe, on
+    // the calling thread; returns the number of nodes freed.
+    std::size_t Collect();
+
+    // Waits until everything the calling thread retired is safe and frees
+    // it. Must not be called from inside a Guard.
+    void Drain();
+
+    std::uint64_t GetEpoch() const { return m_epoch.load(std::memory_order_acquire); }
+    std::size_t GetPendingCount() const;
+    std::uint64_t GetReclaimedCount() const;
+
+private:
+    struct Retired {
+        void* ptr;
+        Destructor destroy;
+        std::uint64_t epoch;
+    };
+
+    // Owned by one thread; other threads only read the atomics.
+    struct ThreadRecord {
+        std::atomic<std::uint64_t> state{0};
+        std::atomic<std::size_t> pending{0};
+        std::size_t nesting = 0;
+        // List size at which Retire next tries to reclaim; pushed out by a
+        // batch after each attempt so a pinned straggler cannot make every
+        // Retire rescan the list.
+        std::size_t collectAt = 0;
+        std::vector<Retired> retired;
+    };
+
+    struct RecordCache {
+        std::uint64_t domainId;
+        ThreadRecord* record;
+    };
+
+    // Pinned threads publish (epoch << 1) | PINNED in their record.
+    static constexpr std::uint64_t PINNED = 1;
+
+    ThreadRecord& GetThreadRecord() {
+        if (t_recordCache.domainId != m_id) {
+            t_recordCache = {m_id, &RegisterThread()};
+        }
+        return *t_recordCache.record;
+    }
+
+    ThreadRecord& RegisterThread();
+    std::vector<Retired> TakeSafe(ThreadRecord& record);
+    static void Free(Allocator& allocator, std::vector<Retired>& batch);
+
+    thread_local static RecordCache t_recordCache;
+
+    Allocator& m_allocator;
+    std::size_t m_retireBatch;
+    std::uint64_t m_id;
+    std::atomic<std::uint64_t> m_epoch;
+    std::shared_ptr<std::atomic<std::uint64_t>> m_reclaimed;
+
+    mutable std::mutex m_recordsMutex;
+    std::vector<std::unique_ptr<ThreadRecord>> m_records;
+    std::unordered_map<std::thread::id, ThreadRecord*> m_threadRecords;
+};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "MemoryTag.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace allocity {
+
+// Point-in-time picture of an Allocator's memory, taken to find out why a
+// process holds more than it has live. It lists every size-class slab
+// with its block occupancy and page residency, and every page-heap span,
+// medium-heap block and system allocation. Each entry carries its live
+// bytes and the memory tags behind them.
+//
+// Write and Read use a compact binary format in host byte order, and Read
+// rejects files written with the other byte order. Report prints the
+// fragmentation and reclaim analysis that allocity_heap_analyzer shows.
+struct HeapSnapshot {
+    static constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    enum class SpanHeap : std::uint8_t {
+        Page,
+        Medium,
+        // Large and aligned allocations served by the DefaultAllocator.
+        System
+    };
+
+    struct Slab {
+        std::uint64_t Address = 0;
+        std::uint64_t BlockSize = 0;
+        std::uint64_t Capacity = 0;
+        // Blocks at or past the frontier have never been handed out.
+        std::uint64_t Frontier = 0;
+        // Blocks the pool counts as in use; those that are not live sit
+        // in the per-CPU caches.
+        std::uint64_t PoolUsedBlocks = 0;
+        // Requested bytes of the live allocations in the slab.
+        std::uint64_t LiveBytes = 0;
+        // One bit per block below the frontier, set for live blocks.
+        std::vector<std::uint64_t> Occupancy;
+        // One bit per page of the slab, set for resident pages.
+        std::vector<std::uint64_t> ResidentPages;
+        std::vector<std::pair<MemoryTag, std::uint64_t>> TagBytes;
+
+        bool IsLive(std::uint64_t block) const;
+        bool IsResident(std::uint64_t page) const;
+        std::uint64_t GetLiveBlocks() const;
+        std::uint64_t GetPageCount(std::uint64_t pageSize) const;
+    };
+
+    struct Span {
+        SpanHeap Heap = SpanHeap::Page;
+        bool Free = false;
+        MemoryTag Tag = MemoryTags::UNTAGGED;
+        std::uint64_t Address = 0;
+        std::uint64_t Size = 0;
+        // Requested bytes of the allocation occupying the span.
+        std::uint64_t LiveBytes = 0;
+        // Bytes of the span that lie on resident pages.
+        std::uint64_t ResidentBytes = 0;
+    };
+
+    std::uint64_t PageSize = 0;
+    std::uint64_t ProcessResidentBytes = 0;
+    std::vector<std::pair<MemoryTag, std::string>> TagNames;
+    std::vector<Slab> Slabs;
+    std::vector<Span> Spans;
+
+    // Throws std::runtime_error if the stream fails or holds no snapshot
+    // of this format version.
+    void Write(std::ostream& out) const;
+    static HeapSnapshot Read(std::istream& in);
+
+    std::uint64_t GetLiveBytes() const;
+    std::string GetTagName(MemoryTag tag) const;
+
+    // Per size class: internal fragmentation (bytes lost to rounding up to
+    // the block size), external fragmentation (free blocks below the
+    // frontier), a histogram of page occupancy and the resident bytes that
+    // purging empty pages or compacting live blocks would give back. Per
+    // span heap: the same figures from its allocated and free spans, with
+    // resident free spans as the external fragmentation. Then live bytes
+    // per tag.
+    void Report(std::ostream& out) const;
+};
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+namespace allocity {
+
+// Latency is recorded per path. Tracking records store the path that owns
+// the block, so a block served from the per-CPU caches is tracked as Pool
+// but timed as CpuCache.
+enum class AllocationPath : std::size_t {
+    CpuCache,
+    Pool,
+    Medium,
+    Page,
+    Large,
+    Aligned,
+    Count
+};
+
+enum class LatencyOperation : std::size_t {
+    Allocate,
+    Deallocate,
+    Count
+};
+
+const char* ToString(AllocationPath path);
+const char* ToString(LatencyOperation operation);
+
+// Log-linear histogram: every power of two is split into SUB_BUCKET_COUNT
+// linear sub-buckets, so the relative error stays below 1 / SUB_BUCKET_COUNT
+// across the whole 64-bit range. Record() is single-writer; readers may run
+// concurrently and see a slightly stale view.
+class LatencyHistogram {
+public:
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKET_COUNT = std::size_t(1) << SUB_BUCKET_BITS;
+    static constexpr std::size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void Record(std::uint64_t value) {
+        std::atomic<std::uint64_t>& bucket = m_buckets[BucketIndex(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > m_max.load(std::memory_order_relaxed)) {
+            m_max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void Merge(const LatencyHistogram& other);
+    void Reset();
+
+    std::uint64_t GetCount() const;
+    std::uint64_t GetMax() const { return m_max.load(std::memory_order_relaxed); }
+    std::uint64_t GetValueAtPercentile(double percentile) const;
+
+    static std::size_t BucketIndex(std::uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<std::size_t>(value);
+        }
+    #if defined(__GNUC__) || defined(__clang__)
+        const std::size_t msb = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+    #else
+        std::size_t msb = 63;
+        while ((value >> msb) == 0) {
+            --msb;
+        }
+    #endif
+        const std::size_t shift = msb - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKET_COUNT + static_cast<std::size_t>((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    static std::uint64_t BucketUpperBound(std::size_t index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> m_buckets;
+    std::atomic<std::uint64_t> m_max;
+};
+
+// Per-thread latency histograms for the Allocator's alloc/free paths.
+// Samples are raw timestamp ticks (TSC where available) recorded into a
+// shard owned by the calling thread; queries merge every shard and convert
+// to nanoseconds. When a thread exits, its samples are folded into a
+// retired shard and its shard is reused by the next new thread, so the
+// shard count follows the peak number of live threads, not the total.
+class LatencyRecorder {
+public:
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    void SetEnabled(bool enable) { m_enabled.store(enable, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    static std::uint64_t ReadTimestamp() {
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        return __rdtsc();
+    #elif defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+    #elif defined(__aarch64__)
+        std::uint64_t ticks;
+        __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+    #else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    #endif
+    }
+
+    static double TicksPerNanosecond();
+
+    void Record(LatencyOperation operation, AllocationPath path, std::uint64_t startTimestamp) {
+        const std::uint64_t now = ReadTimestamp();
+        GetThreadShard().histograms[Slot(operation, path)].Record(now > startTimestamp ? now - startTimestamp : 0);
+    }
+
+    LatencyHistogram GetHistogram(LatencyOperation operation, AllocationPath path) const;
+    std::uint64_t GetCount(LatencyOperation operation, AllocationPath path) const;
+    double GetPercentile(LatencyOperation operation, AllocationPath path, double percentile) const;
+    double GetMax(LatencyOperation operation, AllocationPath path) const;
+    void Reset();
+
+    void Report(std::ostream& out) const;
+
+private:
+    static constexpr std::size_t NUM_SLOTS =
+        static_cast<std::size_t>(LatencyOperation::Count) * static_cast<std::size_t>(AllocationPath::Count);
+
+    struct ThreadShard {
+        std::array<LatencyHistogram, NUM_SLOTS> histograms;
+    };
+
+    static std::size_t Slot(LatencyOperation operation, AllocationPath path) {
+        return static_cast<std::size_t>(operation) * static_cast<std::size_t>(AllocationPath::Count) +
+               static_cast<std::size_t>(path);
+    }
+
+    // Direct-mapped by recorder id. Ids are never reused, so an entry left
+    // by a destroyed recorder can only miss; a thread recording into a few
+    // recorders keeps a hit for each instead of evicting on every switch.
+    static constexpr std::size_t SHARD_CACHE_SIZE = 8;
+
+    struct ShardCacheEntry {
+        std::uint64_t ownerId;
+        ThreadShard* shard;
+    };
+
+    ThreadShard& GetThreadShard() {
+        ShardCacheEntry& entry = t_shardCache[m_id % SHARD_CACHE_SIZE];
+        if (entry.ownerId != m_id) {
+            entry = {m_id, &RegisterThreadShard()};
+        }
+        return *entry.shard;
+    }
+
+    ThreadShard& RegisterThreadShard();
+    void RetireThreadShard(ThreadShard* shard);
+
+    // The shards the thread holds in live recorders, handed back on exit.
+    struct ThreadShards {
+        std::vector<std::pair<std::uint64_t, ThreadShard*>> owned;
+        bool exited = false;
+        ~ThreadShards();
+    };
+
+    thread_local static std::array<ShardCacheEntry, SHARD_CACHE_SIZE> t_shardCache;
+    thread_local static ThreadShards t_threadShards;
+
+    std::uint64_t m_id;
+    std::atomic<bool> m_enabled;
+    mutable std::mutex m_shardsMutex;
+    std::vector<std::unique_ptr<ThreadShard>> m_shards;
+    std::vector<ThreadShard*> m_freeShards;
+    std::unordered_map<std::thread::id, ThreadShard*> m_threadShards;
+    // Samples of the threads that have exited.
+    ThreadShard m_retired;
+};
+
+}
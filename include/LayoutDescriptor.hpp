@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace allocity {
+
+// Runtime description of a layout (name, index and allocation bounds),
+// held by MemoryLayout. Compile-time packing of member types is
+// VariadicLayout<Ts...>.
+struct LayoutDescriptor {
+
+    std::string Name;
+    std::size_t indice;
+    std::size_t MaxAllocations;
+    std::size_t MinAllocations;
+
+    LayoutDescriptor() : Name(""), indice(0), MaxAllocations(0), MinAllocations(0) {}
+
+    LayoutDescriptor(std::string name,
+                     std::size_t indice,
+                     std::size_t maxAllocations,
+                     std::size_t minAllocations)
+        : Name(std::move(name)),
+          indice(indice),
+          MaxAllocations(maxAllocations),
+          MinAllocations(minAllocations) {}
+
+    LayoutDescriptor(const LayoutDescriptor&) = default;
+    LayoutDescriptor(LayoutDescriptor&&) = default;
+    LayoutDescriptor& operator=(const LayoutDescriptor&) = default;
+    LayoutDescriptor& operator=(LayoutDescriptor&&) = default;
+
+};
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "SlabBitmap.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace allocity {
+
+// MemoryPool variant for pools that many threads allocate from and free
+// to at once. The free list is a Treiber stack of block indices whose
+// 64-bit head carries a 32-bit ABA tag next to the top index; the links
+// live in a separate array, so freed blocks are never written by the pool
+// and a thread that loses a race never reads a block someone else owns.
+// The head and the used-block counter sit on cache lines of their own.
+//
+// Allocate and Deallocate are lock-free; Clear is not and must not race
+// with them.
+class LockFreeMemoryPool {
+public:
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+    static constexpr std::uint32_t EMPTY_INDEX = 0xFFFFFFFFu;
+
+    LockFreeMemoryPool(std::size_t blockSize, std::size_t blockCount);
+    LockFreeMemoryPool(std::size_t blockSize, std::size_t blockCount, void* memory);
+    ~LockFreeMemoryPool();
+
+    LockFreeMemoryPool(const LockFreeMemoryPool&) = delete;
+    LockFreeMemoryPool& operator=(const LockFreeMemoryPool&) = delete;
+
+    void* Allocate() {
+        std::uint64_t head = m_freeHead.load(std::memory_order_acquire);
+        std::uint32_t index;
+        do {
+            index = static_cast<std::uint32_t>(head);
+            if (index == EMPTY_INDEX) {
+                return nullptr;
+            }
+        } while (!m_freeHead.compare_exchange_weak(head, PackHead(head, m_next[index].load(std::memory_order_relaxed)),
+                                                   std::memory_order_acquire, std::memory_order_acquire));
+        if (!m_allocated.TestAndSet(index)) {
+            throw std::runtime_error("Memory pool free list is corrupted");
+        }
+        m_usedBlocks.fetch_add(1, std::memory_order_relaxed);
+        return m_memory + static_cast<std::size_t>(index) * m_blockSize;
+    }
+
+    // Throws std::invalid_argument for pointers that are not the start of
+    // one of this pool's blocks and std::runtime_error on a double free.
+    void Deallocate(void* ptr) {
+        if (ptr == nullptr) return;
+        if (!Owns(ptr)) {
+            throw std::invalid_argument("Pointer does not belong to this memory pool");
+        }
+        const std::size_t offset = static_cast<std::size_t>(static_cast<char*>(ptr) - m_memory);
+        if (offset % m_blockSize != 0) {
+            throw std::invalid_argument("Pointer is not the start of a block in this memory pool");
+        }
+        const std::uint32_t index = static_cast<std::uint32_t>(offset / m_blockSize);
+        if (!m_allocated.TestAndClear(index)) {
+            throw std::runtime_error("Double free detected");
+        }
+        m_usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+        std::uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+        do {
+            m_next[index].store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+        } while (!m_freeHead.compare_exchange_weak(head, PackHead(head, index), std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    void Clear();
+
+    bool Owns(const void* ptr) const {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= m_memory && p < m_memory + m_blockSize * m_capacity;
+    }
+
+    bool IsBlockStart(const void* ptr) const {
+        return Owns(ptr) && static_cast<std::size_t>(static_cast<const char*>(ptr) - m_memory) % m_blockSize == 0;
+    }
+
+    bool IsAllocated(const void* ptr) const {
+        return IsBlockStart(ptr) && m_allocated.Test(BlockIndex(ptr));
+    }
+
+    std::size_t GetBlockSize() const { return m_blockSize; }
+    std::size_t GetCapacity() const { return m_capacity; }
+    std::size_t GetUsedBlocks() const { return m_usedBlocks.load(std::memory_order_relaxed); }
+    std::size_t GetFreeBlocks() const { return m_allocated.CountClear(); }
+    const SlabBitmap& GetAllocationBitmap() const { return m_allocated; }
+    void* GetMemory() const { return m_memory; }
+
+private:
+    static std::uint64_t PackHead(std::uint64_t previous, std::uint32_t index) {
+        return (((previous >> 32) + 1) << 32) | index;
+    }
+
+    std::size_t BlockIndex(const void* ptr) const {
+        return static_cast<std::size_t>(static_cast<const char*>(ptr) - m_memory) / m_blockSize;
+    }
+
+    void InitializeFreeList();
+
+    std::size_t m_blockSize;
+    std::size_t m_capacity;
+    char* m_memory;
+    bool m_ownsMemory;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> m_next;
+    SlabBitmap m_allocated;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> m_freeHead;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_usedBlocks;
+};
+
+}
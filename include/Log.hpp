@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+// Lowest level compiled into the library: 0 Trace, 1 Debug, 2 Info,
+// 3 Warning, 4 Error, 5 Off. Set through the ALLOCITY_LOG_LEVEL CMake cache
+// variable; calls below it generate no code.
+#ifndef ALLOCITY_LOG_MIN_LEVEL
+    #define ALLOCITY_LOG_MIN_LEVEL 2
+#endif
+
+namespace allocity {
+
+enum class LogLevel : int {
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+const char* ToString(LogLevel level);
+
+struct LogMessage {
+    LogLevel Level;
+    std::uint64_t TimestampNs;
+    std::uint32_t ThreadIndex;
+    std::string Text;
+};
+
+using LogSink = std::function<void(const LogMessage& message)>;
+
+// Asynchronous logger. A call site stores its format string (which must be
+// a string literal) and up to MAX_ARGUMENTS scalar arguments into a
+// lock-free ring owned by the calling thread; a background thread drains
+// the rings, formats "{}" placeholders and passes each message to the sink.
+// Logging never blocks: a full ring drops the message and the drop is
+// reported on the next flush.
+class Log {
+public:
+    static constexpr std::size_t MAX_ARGUMENTS = 4;
+    static constexpr std::size_t RING_CAPACITY = 1024;
+
+    struct Argument {
+        enum class Kind : std::uint8_t { Signed, Unsigned, Pointer, Double, String };
+
+        Kind kind;
+        union {
+            std::int64_t i;
+            std::uint64_t u;
+            const void* p;
+            double d;
+            const char* s;
+        };
+    };
+
+    struct Record {
+        LogLevel level;
+        std::uint32_t argumentCount;
+        std::uint64_t timestamp;
+        const char* format;
+        Argument arguments[MAX_ARGUMENTS];
+    };
+
+    static bool IsEnabled(LogLevel level) {
+        return static_cast<int>(level) >= s_level.load(std::memory_order_relaxed);
+    }
+
+    static void SetLevel(LogLevel level);
+    static LogLevel GetLevel();
+
+    // Replaces the sink; an empty sink restores the default, which writes
+    // to std::cerr.
+    static void SetSink(LogSink sink);
+
+    // Formats and delivers everything logged so far, on the calling thread.
+    static void Flush();
+    static std::uint64_t GetDroppedCount();
+
+    template <typename... Args>
+    static void Write(LogLevel level, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGUMENTS, "Too many log arguments");
+        Record record;
+        record.level = level;
+        record.argumentCount = static_cast<std::uint32_t>(sizeof...(Args));
+        record.format = format;
+        std::size_t index = 0;
+        ((record.arguments[index++] = MakeArgument(args)), ...);
+        (void)index;
+        Submit(record);
+    }
+
+private:
+    template <typename T>
+    static Argument MakeArgument(const T& value) {
+        Argument argument;
+        if constexpr (std::is_same_v<T, bool>) {
+            argument.kind = Argument::Kind::Unsigned;
+            argument.u = value ? 1 : 0;
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            argument.kind = Argument::Kind::Signed;
+            argument.i = static_cast<std::int64_t>(value);
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            argument.kind = Argument::Kind::Unsigned;
+            argument.u = static_cast<std::uint64_t>(value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            argument.kind = Argument::Kind::Double;
+            argument.d = static_cast<double>(value);
+        } else if constexpr (std::is_convertible_v<T, const char*>) {
+            argument.kind = Argument::Kind::String;
+            argument.s = value;
+        } else {
+            static_assert(std::is_pointer_v<T>, "Log arguments must be scalars, pointers or string literals");
+            argument.kind = Argument::Kind::Pointer;
+            argument.p = static_cast<const void*>(value);
+        }
+        return argument;
+    }
+
+    static void Submit(Record& record);
+
+    static std::atomic<int> s_level;
+};
+
+}
+
+#define ALLOCITY_LOG(level, ...)                                                       \
+    do {                                                                               \
+        if constexpr (static_cast<int>(level) >= ALLOCITY_LOG_MIN_LEVEL) {             \
+            if (::allocity::Log::IsEnabled(level)) {                                   \
+                ::allocity::Log::Write(level, __VA_ARGS__);                            \
+            }                                                                          \
+        }                                                                              \
+    } while (false)
+
+#define ALLOCITY_LOG_TRACE(...) ALLOCITY_LOG(::allocity::LogLevel::Trace, __VA_ARGS__)
+#define ALLOCITY_LOG_DEBUG(...) ALLOCITY_LOG(::allocity::LogLevel::Debug, __VA_ARGS__)
+#define ALLOCITY_LOG_INFO(...) ALLOCITY_LOG(::allocity::LogLevel::Info, __VA_ARGS__)
+#define ALLOCITY_LOG_WARNING(...) ALLOCITY_LOG(::allocity::LogLevel::Warning, __VA_ARGS__)
+#define ALLOCITY_LOG_ERROR(...) ALLOCITY_LOG(::allocity::LogLevel::Error, __VA_ARGS__)
@@ -1,81 +1,220 @@
 #pragma once
 
+#include "LayoutDescriptor.hpp"
 #include "VariadicLayout.hpp"
+#include <cstddef>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 namespace allocity {
 
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+struct ColumnDescriptor {
+
+    std::string Name;
+    std::size_t ElementSize;
+    std::size_t ElementAlignment;
+    const std::type_info* Type;
+
+};
+
+// Contiguous, CACHE_LINE_SIZE-aligned view of one column. Data() carries
+// the alignment guarantee to the compiler so loops over it vectorise
+// without a peeling prologue.
+template <typename T>
+class ColumnSpan {
+
+public:
+
+    ColumnSpan(T* data, std::size_t size) : m_Data(data), m_Size(size) {}
+
+    T* Data() const {
+    #if defined(__GNUC__) || defined(__clang__)
+        return static_cast<T*>(__builtin_assume_aligned(m_Data, CACHE_LINE_SIZE));
+    #else
+        return m_Data;
+    #endif
+    }
+
+    std::size_t Size() const { return m_Size; }
+    bool Empty() const { return m_Size == 0; }
+
+    T& operator[](std::size_t index) const { return Data()[index]; }
+
+    T* begin() const { return Data(); }
+    T* end() const { return Data() + m_Size; }
+
+private:
+
+    T* m_Data;
+    std::size_t m_Size;
+
+};
+
+// Structure-of-arrays storage for a set of columns in a single aligned
+// region. Every column starts on a CACHE_LINE_SIZE boundary and is padded
+// (with zeroes) to a whole number of cache lines.
+class ColumnRegion {
+
+public:
+
+    ColumnRegion(Allocator& allocator, std::vector<ColumnDescriptor> columns, std::size_t capacity);
+    ~ColumnRegion();
+
+    ColumnRegion(const ColumnRegion&) = delete;
+    ColumnRegion& operator=(const ColumnRegion&) = delete;
+    ColumnRegion(ColumnRegion&& other) noexcept;
+    ColumnRegion& operator=(ColumnRegion&& other) noexcept;
+
+    std::size_t GetSize() const { return m_Size; }
+    std::size_t GetCapacity() const { return m_Capacity; }
+    std::size_t GetColumnCount() const { return m_Columns.size(); }
+    std::size_t GetRegionSize() const { return m_RegionSize; }
+    const ColumnDescriptor& GetColumnDescriptor(std::size_t index) const { return m_Columns.at(index); }
+    std::size_t FindColumn(const std::string& name) const;
+
+    // Growth throws std::bad_alloc if the allocator refuses the larger
+    // region, leaving the columns and their contents unchanged.
+    void Reserve(std::size_t capacity);
+    void Resize(std::size_t size);
+    std::size_t PushBack();
+    void Clear() { m_Size = 0; }
+
+    void* GetColumnData(std::size_t index) const { return m_Region + m_Offsets.at(index); }
+
+    template <typename T>
+    ColumnSpan<T> GetColumn(std::size_t index) const {
+        if (*m_Columns.at(index).Type != typeid(T)) {
+            throw std::invalid_argument("Column type does not match the requested element type");
+        }
+        return ColumnSpan<T>(static_cast<T*>(GetColumnData(index)), m_Size);
+    }
+
+    template <typename T>
+    ColumnSpan<T> GetColumn(const std::string& name) const {
+        return GetColumn<T>(FindColumn(name));
+    }
+
+private:
+
+    void Reallocate(std::size_t capacity);
+    void Release();
+
+    Allocator* m_Allocator;
+    std::vector<ColumnDescriptor> m_Columns;
+    std::vector<std::size_t> m_Offsets;
+    char* m_Region;
+    std::size_t m_RegionSize;
+    std::size_t m_Size;
+    std::size_t m_Capacity;
+
+};
+
 class MemoryLayout {
     
 private:
 
-    VariadicLayout m_VariadicLayout;
+    LayoutDescriptor m_LayoutDescriptor;
+    std::vector<ColumnDescriptor> m_Columns;
 
 public:
 
     MemoryLayout() = default;
 
-    explicit MemoryLayout(const VariadicLayout& layout) : m_VariadicLayout(layout) {}
+    explicit MemoryLayout(const LayoutDescriptor& descriptor) : m_LayoutDescriptor(descriptor) {}
 
-    const VariadicLayout& GetVariadicLayout() const {
+    const LayoutDescriptor& GetLayoutDescriptor() const {
 
-        return m_VariadicLayout;
+        return m_LayoutDescriptor;
 
     }
 
-    void SetVariadicLayout(const VariadicLayout& variadic) {
+    void SetLayoutDescriptor(const LayoutDescriptor& descriptor) {
 
-        m_VariadicLayout = variadic;
+        m_LayoutDescriptor = descriptor;
 
     }
 
     std::string GetName() const { 
 
-        return m_VariadicLayout.Name; 
+        return m_LayoutDescriptor.Name; 
 
     }
 
     void SetName(std::string name) { 
-        m_VariadicLayout.Name = std::move(name); 
+        m_LayoutDescriptor.Name = std::move(name); 
 
     }
 
     std::size_t GetIndice() const { 
 
-        return m_VariadicLayout.indice; 
+        return m_LayoutDescriptor.indice; 
 
     }
 
     void SetIndice(std::size_t indice) { 
 
-        m_VariadicLayout.indice = indice; 
+        m_LayoutDescriptor.indice = indice; 
 
     }
 
     std::size_t GetMaxAllocations() const { 
 
-        return m_VariadicLayout.MaxAllocations; 
+        return m_LayoutDescriptor.MaxAllocations; 
 
     }
 
     void SetMaxAllocations(std::size_t maxAllocations) {
 
-        m_VariadicLayout.MaxAllocations = maxAllocations; 
+        m_LayoutDescriptor.MaxAllocations = maxAllocations; 
 
     }
 
     std::size_t GetMinAllocations() const { 
 
-        return m_VariadicLayout.MinAllocations; 
+        return m_LayoutDescriptor.MinAllocations; 
 
     }
 
     void SetMinAllocations(std::size_t minAllocations) {
         
-        m_VariadicLayout.MinAllocations = minAllocations; 
+        m_LayoutDescriptor.MinAllocations = minAllocations; 
+
+    }
+
+    template <typename T>
+    MemoryLayout& AddColumn(std::string name) {
+
+        static_assert(std::is_trivially_copyable_v<T>, "Columns are relocated with memcpy and must be trivially copyable");
+        static_assert(alignof(T) <= CACHE_LINE_SIZE, "Column element alignment exceeds the cache line size");
+
+        m_Columns.push_back({std::move(name), sizeof(T), alignof(T), &typeid(T)});
+        return *this;
+
+    }
+
+    const std::vector<ColumnDescriptor>& GetColumns() const {
+
+        return m_Columns;
+
+    }
+
+    void ClearColumns() {
+
+        m_Columns.clear();
+
+    }
+
+    ColumnRegion AllocateColumns(Allocator& allocator, std::size_t capacity) const {
+
+        return ColumnRegion(allocator, m_Columns, capacity);
 
     }
 
 };
 
-} 
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "BuddyAllocator.hpp"
+#include "MemoryTag.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace allocity {
+
+// Opt-in relocatable heap. Objects are reached through a Handle and must be
+// pinned while their address is in use; unpinned objects in sparsely used
+// slabs may be moved by Compact() (or the background compactor when the
+// manager has been idle) so the emptied slabs can go back to the page heap.
+// Each memory tag fills its own slabs, so ReleaseTag() drops a subsystem's
+// objects by returning whole slabs without walking a free list.
+class MemoryManager {
+public:
+    static constexpr std::size_t DEFAULT_SLAB_SIZE = 64 * 1024;
+    static constexpr std::size_t OBJECT_ALIGNMENT = 16;
+    static constexpr double DEFAULT_OCCUPANCY_THRESHOLD = 0.5;
+
+    struct Handle {
+        std::uint32_t index = 0;
+        std::uint32_t generation = 0;
+
+        bool IsNull() const { return generation == 0; }
+        bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    class PinGuard {
+    public:
+        PinGuard(MemoryManager& manager, Handle handle)
+            : m_manager(&manager), m_handle(handle), m_ptr(manager.Pin(handle)) {}
+        ~PinGuard() {
+            if (m_manager) m_manager->Unpin(m_handle);
+        }
+
+        PinGuard(const PinGuard&) = delete;
+        PinGuard& operator=(const PinGuard&) = delete;
+        PinGuard(PinGuard&& other) noexcept
+            : m_manager(other.m_manager), m_handle(other.m_handle), m_ptr(other.m_ptr) {
+            other.m_manager = nullptr;
+        }
+        PinGuard& operator=(PinGuard&&) = delete;
+
+        void* Get() const { return m_ptr; }
+
+        template <typename T>
+        T* As() const { return static_cast<T*>(m_ptr); }
+
+    private:
+        MemoryManager* m_manager;
+        Handle m_handle;
+        void* m_ptr;
+    };
+
+    explicit MemoryManager(std::size_t slabSize = DEFAULT_SLAB_SIZE);
+    ~MemoryManager();
+
+    MemoryManager(const MemoryManager&) = delete;
+    MemoryManager& operator=(const MemoryManager&) = delete;
+    MemoryManager(MemoryManager&&) = delete;
+    MemoryManager& operator=(MemoryManager&&) = delete;
+
+    Handle Allocate(std::size_t size);
+    Handle Allocate(std::size_t size, MemoryTag tag);
+    void Free(Handle handle);
+    std::size_t ReleaseTag(MemoryTag tag);
+
+    void* Pin(Handle handle);
+    void Unpin(Handle handle);
+    PinGuard Acquire(Handle handle) { return PinGuard(*this, handle); }
+
+    bool IsValid(Handle handle) const;
+    std::size_t GetSize(Handle handle) const;
+
+    std::size_t Compact(double occupancyThreshold = DEFAULT_OCCUPANCY_THRESHOLD,
+                        std::size_t maxBytesToMove = SIZE_MAX);
+
+    void StartBackgroundCompaction(std::chrono::milliseconds idleInterval,
+                                   double occupancyThreshold = DEFAULT_OCCUPANCY_THRESHOLD);
+    void StopBackgroundCompaction();
+
+    std::size_t GetLiveObjects() const;
+    std::size_t GetLiveBytes() const;
+    std::size_t GetSlabCount() const;
+    std::size_t GetSlabBytes() const;
+    std::size_t GetMovedBytes() const;
+    std::size_t GetReleasedSlabs() const;
+
+private:
+    static constexpr std::uint32_t NO_SLAB = UINT32_MAX;
+
+    struct Entry {
+        char* address;
+        std::size_t size;
+        std::uint32_t generation;
+        std::uint32_t slab;
+        std::uint32_t slot;
+        std::uint32_t pins;
+    };
+
+    struct Slab {
+        char* memory;
+        std::size_t capacity;
+        std::size_t used;
+        std::size_t liveBytes;
+        std::uint32_t pinnedObjects;
+        MemoryTag tag;
+        std::vector<std::uint32_t> objects;
+    };
+
+    Entry& Lookup(Handle handle);
+    const Entry& Lookup(Handle handle) const;
+    std::uint32_t AcquireSlab(std::size_t size, MemoryTag tag);
+    std::uint32_t NewSlab(std::size_t capacity, MemoryTag tag);
+    void Place(std::uint32_t index, std::uint32_t slabIndex, std::size_t size);
+    void RemoveFromSlab(Entry& entry);
+    void ReleaseIfEmpty(std::uint32_t slabIndex);
+    void RetireEntry(std::uint32_t index);
+    void ReleaseSlab(std::uint32_t slabIndex);
+    std::size_t CompactLocked(double occupancyThreshold, std::size_t maxBytesToMove);
+    void BackgroundWorker(std::chrono::milliseconds idleInterval, double occupancyThreshold);
+    void Touch() { m_lastActivity.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed); }
+
+    std::size_t m_slabSize;
+    BuddyAllocator m_slabHeap;
+    std::vector<Entry> m_entries;
+    std::vector<std::uint32_t> m_freeEntries;
+    std::vector<std::unique_ptr<Slab>> m_slabs;
+    std::vector<std::uint32_t> m_freeSlabs;
+    std::vector<std::uint32_t> m_currentSlabs;
+    std::size_t m_liveObjects;
+    std::size_t m_liveBytes;
+    std::size_t m_slabBytes;
+    std::size_t m_movedBytes;
+    std::size_t m_releasedSlabs;
+    mutable std::mutex m_mutex;
+
+    std::thread m_compactor;
+    std::mutex m_compactorMutex;
+    std::condition_variable m_compactorCondition;
+    bool m_stopCompactor;
+    std::atomic<std::int64_t> m_lastActivity;
+};
+
+}
@@ -1,34 +1,136 @@
 #pragma once
 
+#include "SlabBitmap.hpp"
+#include <atomic>
 #include <cstddef>
 #include <vector>
 #include <mutex>
+#include <stdexcept>
 
 namespace allocity {
 
+// Fixed-size block pool over one contiguous slab. Blocks are handed out
+// from a recycled free list first and otherwise from a bump frontier, so a
+// block is first written when it is first allocated and the untouched tail
+// of the slab never becomes resident. Clear() only resets the frontier and
+// the free list; allocation bits past the frontier are stale until the
+// frontier reaches their word again, which clears it.
 class MemoryPool {
 public:
 
     MemoryPool(std::size_t blockSize, std::size_t blockCount);
+    MemoryPool(std::size_t blockSize, std::size_t blockCount, void* memory);
     ~MemoryPool();
 
-    void* Allocate();
-    void Deallocate(void* ptr);
+    void* Allocate() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        void* result = m_freeList;
+        if (result != nullptr) {
+            if (!m_allocated.TestAndSet(BlockIndex(result))) {
+                throw std::runtime_error("Memory pool free list is corrupted");
+            }
+            m_freeList = *reinterpret_cast<void**>(result);
+        } else {
+            const std::size_t index = m_frontier.load(std::memory_order_relaxed);
+            if (index == m_capacity) {
+                return nullptr;
+            }
+            if (index % SlabBitmap::BITS_PER_WORD == 0) {
+                m_allocated.ClearWord(index);
+            }
+            m_allocated.TestAndSet(index);
+            m_frontier.store(index + 1, std::memory_order_release);
+            result = m_memory + index * m_blockSize;
+        }
+        m_usedBlocks.store(m_usedBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return result;
+    }
+
+    // Throws std::invalid_argument for pointers that are not the start of
+    // one of this pool's blocks and std::runtime_error on a double free.
+    void Deallocate(void* ptr) {
+        if (ptr == nullptr) return;
+        if (!Owns(ptr)) {
+            throw std::invalid_argument("Pointer does not belong to this memory pool");
+        }
+        const std::size_t offset = static_cast<std::size_t>(static_cast<char*>(ptr) - m_memory);
+        if (offset % m_blockSize != 0) {
+            throw std::invalid_argument("Pointer is not the start of a block in this memory pool");
+        }
+        if (!MarkFree(ptr)) {
+            throw std::runtime_error("Double free detected");
+        }
+        ReleaseMarked(ptr);
+    }
+
+    // For caches in front of the pool (see PerCpuCache): a parked block is
+    // marked free in the allocation bitmap but stays off the free list and
+    // counted as used. MarkFree returns false if ptr is not an allocated
+    // block of this pool, MarkAllocated false if the block was not marked
+    // free, and ReleaseMarked hands a marked-free block back to the pool.
+    bool MarkFree(void* ptr) {
+        return IsBlockStart(ptr) && BlockIndex(ptr) < m_frontier.load(std::memory_order_acquire) &&
+               m_allocated.TestAndClear(BlockIndex(ptr));
+    }
+
+    bool MarkAllocated(void* ptr) {
+        return m_allocated.TestAndSet(BlockIndex(ptr));
+    }
+
+    void ReleaseMarked(void* ptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *reinterpret_cast<void**>(ptr) = m_freeList;
+        m_freeList = ptr;
+        m_usedBlocks.store(m_usedBlocks.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+
     void Clear();
 
+    bool Owns(const void* ptr) const {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= m_memory && p < m_memory + m_blockSize * m_capacity;
+    }
+
+    bool IsBlockStart(const void* ptr) const {
+        return Owns(ptr) && static_cast<std::size_t>(static_cast<const char*>(ptr) - m_memory) % m_blockSize == 0;
+    }
+
+    bool IsAllocated(const void* ptr) const {
+        return IsBlockStart(ptr) && BlockIndex(ptr) < m_frontier.load(std::memory_order_acquire) &&
+               m_allocated.Test(BlockIndex(ptr));
+    }
+
+    // Index of the block ptr points into; ptr must be owned by the pool.
+    std::size_t GetBlockIndex(const void* ptr) const { return BlockIndex(ptr); }
+
     std::size_t GetBlockSize() const { return m_blockSize; }
     std::size_t GetCapacity() const { return m_capacity; }
-    std::size_t GetUsedBlocks() const { return m_usedBlocks; }
+    std::size_t GetUsedBlocks() const { return m_usedBlocks.load(std::memory_order_relaxed); }
+    std::size_t GetFreeBlocks() const { return m_capacity - GetUsedBlocks(); }
+    // Blocks at or past the frontier have never been handed out since
+    // construction or the last Clear().
+    std::size_t GetFrontier() const { return m_frontier.load(std::memory_order_acquire); }
+    // Only bits below GetFrontier() are meaningful.
+    const SlabBitmap& GetAllocationBitmap() const { return m_allocated; }
+    void* GetMemory() const { return m_memory; }
 
 private:
     std::size_t m_blockSize;
     std::size_t m_capacity;
-    std::size_t m_usedBlocks;
+    // Written under m_mutex, read without it by GetUsedBlocks.
+    std::atomic<std::size_t> m_usedBlocks;
     char* m_memory;
+    bool m_ownsMemory;
+    // Recycled blocks only; never-used blocks are taken from m_frontier.
     void* m_freeList;
+    // Written under m_mutex, read without it by Deallocate and IsAllocated.
+    std::atomic<std::size_t> m_frontier;
+    SlabBitmap m_allocated;
     std::mutex m_mutex;
 
-    void InitializeFreeList();
+    std::size_t BlockIndex(const void* ptr) const {
+        return static_cast<std::size_t>(static_cast<const char*>(ptr) - m_memory) / m_blockSize;
+    }
 };
 
 } 
\ No newline at end of file
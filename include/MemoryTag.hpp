@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace allocity {
+
+using MemoryTag = std::uint16_t;
+
+enum class BudgetEvent {
+    SoftLimitExceeded,
+    HardLimitRejected
+};
+
+struct MemoryTagStats {
+    MemoryTag Tag;
+    std::string Name;
+    std::size_t LiveBytes;
+    std::size_t PeakBytes;
+    std::size_t SoftBudget;
+    std::size_t HardBudget;
+};
+
+using BudgetCallback = std::function<void(MemoryTag tag, BudgetEvent event, std::size_t liveBytes, std::size_t requested)>;
+
+// Process-wide accounting of which subsystem owns memory. Each thread keeps
+// a pending delta per tag and folds it into the shared counters only once
+// it reaches FLUSH_THRESHOLD, so the hot path touches no shared cache line
+// for small allocations. Live/peak figures and budget checks are therefore
+// exact to within FLUSH_THRESHOLD per thread.
+class MemoryTags {
+public:
+    static constexpr MemoryTag UNTAGGED = 0;
+    static constexpr std::size_t MAX_TAGS = 64;
+    static constexpr std::int64_t FLUSH_THRESHOLD = 64 * 1024;
+    static constexpr std::size_t NO_BUDGET = SIZE_MAX;
+
+    static MemoryTag Register(const std::string& name);
+    static bool Find(const std::string& name, MemoryTag& tag);
+    static std::string GetName(MemoryTag tag);
+
+    static MemoryTag GetCurrent() { return t_currentTag; }
+    static void SetCurrent(MemoryTag tag) {
+        if (tag >= MAX_TAGS) {
+            throw std::out_of_range("Memory tag out of range");
+        }
+        t_currentTag = tag;
+    }
+
+    static void SetBudget(MemoryTag tag, std::size_t softBudget, std::size_t hardBudget);
+    static void SetBudgetCallback(MemoryTag tag, BudgetCallback callback);
+
+    // Throws std::out_of_range for a tag past MAX_TAGS, so every explicit
+    // tag is checked before it indexes the per-tag arrays. Release needs
+    // no check, since it only follows a successful Charge.
+    static bool Charge(MemoryTag tag, std::size_t size) {
+        if (tag >= MAX_TAGS) {
+            throw std::out_of_range("Memory tag out of range");
+        }
+        std::int64_t& pending = t_pending.deltas[tag];
+        pending += static_cast<std::int64_t>(size);
+        if (pending >= FLUSH_THRESHOLD || s_budgeted[tag].load(std::memory_order_relaxed)) {
+            return ChargeSlow(tag, size);
+        }
+        return true;
+    }
+
+    static void Release(MemoryTag tag, std::size_t size) {
+        std::int64_t& pending = t_pending.deltas[tag];
+        pending -= static_cast<std::int64_t>(size);
+        if (pending <= -FLUSH_THRESHOLD) {
+            Flush(tag);
+        }
+    }
+
+    static void Flush();
+    static std::size_t GetLiveBytes(MemoryTag tag);
+    static std::size_t GetPeakBytes(MemoryTag tag);
+    static MemoryTagStats GetStats(MemoryTag tag);
+    static std::vector<MemoryTagStats> GetAllStats();
+    static void ResetPeak(MemoryTag tag);
+
+    static void Report(std::ostream& out);
+
+private:
+    struct PendingDeltas {
+        std::int64_t deltas[MAX_TAGS] = {};
+        ~PendingDeltas();
+    };
+
+    static bool ChargeSlow(MemoryTag tag, std::size_t size);
+    static void Flush(MemoryTag tag);
+
+    thread_local static MemoryTag t_currentTag;
+    thread_local static PendingDeltas t_pending;
+    static std::atomic<bool> s_budgeted[MAX_TAGS];
+};
+
+// Sets the calling thread's current tag for the lifetime of the scope.
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag) : m_previous(MemoryTags::GetCurrent()) {
+        MemoryTags::SetCurrent(tag);
+    }
+    ~MemoryTagScope() {
+        MemoryTags::SetCurrent(m_previous);
+    }
+
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+    MemoryTag m_previous;
+};
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "MemoryPool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace allocity {
+
+template <typename T>
+class ObjectPool {
+public:
+    static constexpr std::size_t ALIGNMENT = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+    static constexpr std::size_t BLOCK_SIZE =
+        ((sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    static constexpr std::size_t DEFAULT_CHUNK_CAPACITY = 256;
+
+    static_assert(ALIGNMENT <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                  "ObjectPool<T> does not support over-aligned types; use Allocator::AlignedAllocate");
+
+    struct Deleter {
+        ObjectPool* pool;
+
+        void operator()(T* object) const {
+            pool->Destroy(object);
+        }
+    };
+
+    using UniquePtr = std::unique_ptr<T, Deleter>;
+
+    explicit ObjectPool(std::size_t initialCapacity = DEFAULT_CHUNK_CAPACITY)
+        : m_currentChunk(0),
+          m_nextChunkCapacity(initialCapacity > 0 ? initialCapacity : 1),
+          m_freeList(nullptr),
+          m_freeBlocks(0),
+          m_liveObjects(0) {}
+
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ObjectPool(ObjectPool&&) = delete;
+    ObjectPool& operator=(ObjectPool&&) = delete;
+
+    template <typename... Args>
+    T* Create(Args&&... args) {
+        void* block = AcquireBlock();
+        try {
+            return ::new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            ReleaseBlock(block);
+            throw;
+        }
+    }
+
+    void Destroy(T* object) {
+        if (object == nullptr) return;
+        object->~T();
+        ReleaseBlock(object);
+    }
+
+    template <typename... Args>
+    UniquePtr MakeUnique(Args&&... args) {
+        return UniquePtr(Create(std::forward<Args>(args)...), Deleter{this});
+    }
+
+    void Reserve(std::size_t count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::size_t available = m_freeBlocks;
+        for (std::size_t i = m_currentChunk; i < m_chunks.size(); ++i) {
+            available += m_chunks[i]->GetCapacity() - m_chunks[i]->GetUsedBlocks();
+        }
+        if (available < count) {
+            AddChunk(count - available);
+        }
+    }
+
+    std::size_t GetLiveObjects() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_liveObjects;
+    }
+
+    std::size_t GetCapacity() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::size_t capacity = 0;
+        for (const auto& chunk : m_chunks) {
+            capacity += chunk->GetCapacity();
+        }
+        return capacity;
+    }
+
+private:
+    void* AcquireBlock() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        void* block = m_freeList;
+        if (block != nullptr) {
+            m_freeList = *static_cast<void**>(block);
+            --m_freeBlocks;
+        } else {
+            while (m_currentChunk < m_chunks.size() &&
+                   (block = m_chunks[m_currentChunk]->Allocate()) == nullptr) {
+                ++m_currentChunk;
+            }
+            if (block == nullptr) {
+                block = AddChunk(m_nextChunkCapacity).Allocate();
+            }
+        }
+        ++m_liveObjects;
+        return block;
+    }
+
+    void ReleaseBlock(void* block) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *static_cast<void**>(block) = m_freeList;
+        m_freeList = block;
+        ++m_freeBlocks;
+        --m_liveObjects;
+    }
+
+    MemoryPool& AddChunk(std::size_t capacity) {
+        m_chunks.push_back(std::make_unique<MemoryPool>(BLOCK_SIZE, capacity));
+        m_nextChunkCapacity = std::max(m_nextChunkCapacity, capacity * 2);
+        return *m_chunks.back();
+    }
+
+    std::vector<std::unique_ptr<MemoryPool>> m_chunks;
+    std::size_t m_currentChunk;
+    std::size_t m_nextChunkCapacity;
+    void* m_freeList;
+    std::size_t m_freeBlocks;
+    std::size_t m_liveObjects;
+    mutable std::mutex m_mutex;
+};
+
+}
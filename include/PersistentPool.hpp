@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace allocity {
+
+// Self-relative pointer for data structures that live inside a
+// PersistentPool. It stores the distance from itself to the target, so it
+// stays valid when the file is mapped at a different base address.
+template <typename T>
+class RelativePtr {
+public:
+    RelativePtr() : m_delta(0) {}
+    RelativePtr(T* target) { Set(target); }
+    RelativePtr(const RelativePtr& other) { Set(other.Get()); }
+
+    RelativePtr& operator=(const RelativePtr& other) {
+        Set(other.Get());
+        return *this;
+    }
+
+    RelativePtr& operator=(T* target) {
+        Set(target);
+        return *this;
+    }
+
+    T* Get() const {
+        if (m_delta == 0) return nullptr;
+        return reinterpret_cast<T*>(reinterpret_cast<std::intptr_t>(this) + m_delta);
+    }
+
+    T* operator->() const { return Get(); }
+    T& operator*() const { return *Get(); }
+    explicit operator bool() const { return m_delta != 0; }
+
+private:
+    void Set(T* target) {
+        m_delta = target == nullptr ? 0 : reinterpret_cast<std::intptr_t>(target) - reinterpret_cast<std::intptr_t>(this);
+    }
+
+    std::intptr_t m_delta;
+};
+
+// Fixed-size block pool backed by a memory-mapped file. The free list, an
+// allocation bitmap and a user root are stored in the file as offsets, so
+// reopening the file restores the pool without touching the blocks; pass a
+// base address to ask for the same mapping as last time, or store
+// RelativePtr/offsets so the pool can be relocated.
+//
+// Crash consistency: the allocation bitmap is authoritative. A pool that
+// was not closed cleanly is detected on open and its free list and counters
+// are rebuilt from the bitmap (one pass over the bitmap, not the blocks).
+// A process crash loses nothing that was stored before it, since the pages
+// live in the OS page cache. After an OS crash or power loss only the state
+// as of the last Sync() is durable, and pages written after it may be
+// persisted in any order. Block contents are never made transactional.
+class PersistentPool {
+public:
+    static constexpr std::uint64_t NULL_OFFSET = 0;
+    static constexpr std::size_t BLOCK_ALIGNMENT = alignof(std::uint64_t);
+
+    PersistentPool(const std::string& path, std::size_t blockSize, std::size_t blockCount, void* baseAddress = nullptr);
+    ~PersistentPool();
+
+    PersistentPool(const PersistentPool&) = delete;
+    PersistentPool& operator=(const PersistentPool&) = delete;
+    PersistentPool(PersistentPool&&) = delete;
+    PersistentPool& operator=(PersistentPool&&) = delete;
+
+    void* Allocate();
+    void Deallocate(void* ptr);
+
+    bool Owns(const void* ptr) const;
+
+    std::uint64_t ToOffset(const void* ptr) const;
+    void* FromOffset(std::uint64_t offset) const;
+
+    template <typename T>
+    T* Get(std::uint64_t offset) const {
+        return static_cast<T*>(FromOffset(offset));
+    }
+
+    void SetRoot(const void* ptr);
+    void* GetRoot() const;
+
+    void Sync();
+
+    bool WasCreated() const { return m_created; }
+    bool WasRecovered() const { return m_recovered; }
+    bool IsRelocated() const { return m_relocated; }
+
+    const std::string& GetPath() const { return m_path; }
+    void* GetBaseAddress() const { return m_base; }
+    std::size_t GetMappedSize() const { return m_mappedSize; }
+    std::size_t GetBlockSize() const;
+    std::size_t GetCapacity() const;
+    std::size_t GetUsedBlocks() const;
+
+private:
+    struct Header;
+
+    void Map(std::size_t size, void* baseAddress);
+    void Unmap();
+    void Format(std::size_t blockSize, std::size_t blockCount, std::size_t bitmapOffset, std::size_t blocksOffset);
+    void Recover();
+    std::size_t BlockIndex(const void* ptr) const;
+
+    std::string m_path;
+    char* m_base;
+    std::size_t m_mappedSize;
+    Header* m_header;
+    std::uint64_t* m_bitmap;
+    char* m_blocks;
+    bool m_created;
+    bool m_recovered;
+    bool m_relocated;
+#if defined(_WIN32)
+    void* m_file;
+    void* m_mapping;
+#endif
+    mutable std::mutex m_mutex;
+};
+
+}
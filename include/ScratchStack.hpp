@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace allocity {
+
+// Growable LIFO bump allocator for scope-local temporaries. Memory comes
+// in chunks straight from VirtualMemory, so scratch buffers never touch
+// the Allocator's pools or its tracker. A Position taken with
+// GetPosition() is restored by Rewind() in O(1): chunks past it stay
+// linked as spares for the next overflow unless the stack holds more than
+// its retain limit, in which case the spares are unmapped newest first.
+//
+// A ScratchStack is not thread-safe; ForThread() returns the calling
+// thread's own instance, which is what ScratchMarker uses by default.
+class ScratchStack {
+    struct Chunk;
+
+public:
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+    static constexpr std::size_t DEFAULT_ALIGNMENT = 16;
+    static constexpr std::size_t UNLIMITED = SIZE_MAX;
+
+    struct Position {
+        Chunk* chunk;
+        std::size_t offset;
+    };
+
+    explicit ScratchStack(std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    ~ScratchStack();
+
+    ScratchStack(const ScratchStack&) = delete;
+    ScratchStack& operator=(const ScratchStack&) = delete;
+
+    static ScratchStack& ForThread();
+
+    void* Allocate(std::size_t size, std::size_t alignment = DEFAULT_ALIGNMENT) {
+        const std::size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (m_current != nullptr && offset >= m_offset && offset <= m_capacity && size <= m_capacity - offset &&
+            (alignment & (alignment - 1)) == 0) {
+            m_offset = offset + size;
+            return reinterpret_cast<char*>(m_current) + offset;
+        }
+        return AllocateSlow(size, alignment);
+    }
+
+    // Storage for count objects of T; the objects are default-initialized
+    // and are never destroyed, hence the trivially destructible T.
+    template <typename T>
+    T* AllocateArray(std::size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Scratch memory is rewound without running destructors");
+        if (count > SIZE_MAX / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        T* objects = static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+        for (std::size_t i = 0; i < count; ++i) {
+            ::new (static_cast<void*>(objects + i)) T;
+        }
+        return objects;
+    }
+
+    Position GetPosition() const { return {m_current, m_offset}; }
+    void Rewind(const Position& position);
+
+    // Bytes of chunk memory kept mapped once the stack rewinds; anything
+    // above it is returned to the OS. UNLIMITED keeps every chunk.
+    void SetRetainLimit(std::size_t bytes);
+    // Unmaps every chunk past the current position.
+    void Trim();
+
+    // Used bytes include chunk headers and alignment padding.
+    std::size_t GetUsedBytes() const;
+    std::size_t GetHighWaterBytes() const;
+    std::size_t GetReservedBytes() const { return m_reservedBytes; }
+    std::size_t GetChunkCount() const { return m_chunkCount; }
+
+private:
+    struct Chunk {
+        Chunk* previous;
+        Chunk* next;
+        std::size_t size;
+        // Used bytes of the stack below this chunk while it is in use.
+        std::size_t base;
+    };
+
+    void* AllocateSlow(std::size_t size, std::size_t alignment);
+    Chunk* CreateChunk(std::size_t minimumSize);
+    void ReleaseChunk(Chunk* chunk);
+    void ReleaseSpares(std::size_t keepBytes);
+
+    std::size_t m_chunkSize;
+    std::size_t m_retainLimit;
+    Chunk* m_head;
+    Chunk* m_tail;
+    Chunk* m_current;
+    // Offsets count from the chunk's start, so they include the header.
+    std::size_t m_offset;
+    std::size_t m_capacity;
+    std::size_t m_reservedBytes;
+    std::size_t m_chunkCount;
+    std::size_t m_highWaterBytes;
+};
+
+// Restores the stack to where it was at construction when it goes out of
+// scope; everything allocated through it (or through the same stack in
+// the meantime) is released together.
+class ScratchMarker {
+public:
+    ScratchMarker() : ScratchMarker(ScratchStack::ForThread()) {}
+    explicit ScratchMarker(ScratchStack& stack) : m_stack(stack), m_position(stack.GetPosition()) {}
+    ~ScratchMarker() { m_stack.Rewind(m_position); }
+
+    ScratchMarker(const ScratchMarker&) = delete;
+    ScratchMarker& operator=(const ScratchMarker&) = delete;
+
+    void* Allocate(std::size_t size, std::size_t alignment = ScratchStack::DEFAULT_ALIGNMENT) {
+        return m_stack.Allocate(size, alignment);
+    }
+
+    template <typename T>
+    T* AllocateArray(std::size_t count) {
+        return m_stack.AllocateArray<T>(count);
+    }
+
+    ScratchStack& GetStack() const { return m_stack; }
+
+private:
+    ScratchStack& m_stack;
+    ScratchStack::Position m_position;
+};
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace allocity {
+
+// Fixed-size block pool in a shared memory object (memfd_create, or
+// shm_open for named pools) that several processes can allocate from and
+// free to. Blocks are exchanged between processes as offsets, so a message
+// is handed over without being copied; the anonymous constructor's mapping
+// is inherited across fork(), named pools are attached by name.
+//
+// The free list is a lock-free Treiber stack of block indices with an ABA
+// tag, kept in a metadata array next to the blocks, so freed blocks are
+// never written by the pool. Every allocated block records its owning
+// process; RecoverDeadOwners() returns blocks held by processes that have
+// exited. A process that dies between popping a block and recording itself
+// as owner leaks that one block.
+class SharedMemoryPool {
+public:
+    static constexpr std::uint64_t NULL_OFFSET = 0;
+    static constexpr std::size_t BLOCK_ALIGNMENT = alignof(std::uint64_t);
+
+    SharedMemoryPool(std::size_t blockSize, std::size_t blockCount);
+    SharedMemoryPool(const std::string& name, std::size_t blockSize, std::size_t blockCount);
+    ~SharedMemoryPool();
+
+    SharedMemoryPool(const SharedMemoryPool&) = delete;
+    SharedMemoryPool& operator=(const SharedMemoryPool&) = delete;
+    SharedMemoryPool(SharedMemoryPool&&) = delete;
+    SharedMemoryPool& operator=(SharedMemoryPool&&) = delete;
+
+    static void Unlink(const std::string& name);
+
+    void* Allocate();
+    void Deallocate(void* ptr);
+
+    // Hands ownership of a block to another process, so the block survives
+    // the sender exiting before the receiver frees it.
+    void Transfer(const void* ptr, int processId);
+    int GetOwner(const void* ptr) const;
+    std::size_t RecoverDeadOwners();
+
+    bool Owns(const void* ptr) const;
+
+    std::uint64_t ToOffset(const void* ptr) const;
+    void* FromOffset(std::uint64_t offset) const;
+
+    template <typename T>
+    T* Get(std::uint64_t offset) const {
+        return static_cast<T*>(FromOffset(offset));
+    }
+
+    int GetFileDescriptor() const { return m_fd; }
+    void* GetBaseAddress() const { return m_base; }
+    std::size_t GetMappedSize() const { return m_mappedSize; }
+    std::size_t GetBlockSize() const;
+    std::size_t GetCapacity() const;
+    std::size_t GetUsedBlocks() const;
+
+private:
+    struct Header;
+    struct BlockMeta;
+
+    static std::size_t MappedSizeFor(std::size_t blockSize, std::size_t blockCount,
+                                     std::size_t& metaOffset, std::size_t& blocksOffset);
+
+    void MapDescriptor(std::size_t size);
+    void Format(std::size_t blockSize, std::size_t blockCount, std::size_t metaOffset, std::size_t blocksOffset);
+    void Attach(std::size_t blockSize, std::size_t blockCount);
+    void Push(std::uint32_t index);
+    std::size_t BlockIndex(const void* ptr) const;
+
+    int m_fd;
+    char* m_base;
+    std::size_t m_mappedSize;
+    Header* m_header;
+    BlockMeta* m_meta;
+    char* m_blocks;
+};
+
+}
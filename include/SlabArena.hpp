@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace allocity {
+
+// Source of slabs for the size-class pools. Slabs are carved back to back
+// out of large regions aligned to VirtualMemory::HUGE_PAGE_SIZE, so the
+// pools of all size classes share as few huge pages as possible instead of
+// being scattered between other page-heap spans. With huge pages enabled
+// each region is advised for transparent huge pages, and a pointer chase
+// over small objects needs one TLB entry per 2 MiB instead of one per
+// page.
+//
+// Slabs live until the arena is destroyed. The arena does no locking of
+// its own; the Allocator only calls Allocate under its pool-creation lock.
+class SlabArena {
+public:
+    static constexpr std::size_t DEFAULT_REGION_SIZE = 64 * 1024 * 1024;
+
+    explicit SlabArena(bool hugePages = true, std::size_t regionSize = DEFAULT_REGION_SIZE);
+    ~SlabArena();
+
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    // Returns a page-aligned slab of at least size bytes. Throws
+    // std::bad_alloc if no address space is left.
+    void* Allocate(std::size_t size);
+
+    bool Owns(const void* ptr) const;
+
+    bool UsesHugePages() const { return m_hugePages; }
+    std::size_t GetRegionCount() const { return m_regions.size(); }
+    std::size_t GetReservedBytes() const;
+    std::size_t GetUsedBytes() const { return m_usedBytes; }
+    // Bytes of regions the OS accepted the huge page hint for.
+    std::size_t GetHugePageBytes() const { return m_hugePageBytes; }
+
+private:
+    struct Region {
+        char* base;
+        std::size_t size;
+    };
+
+    void AddRegion(std::size_t minimumSize);
+
+    bool m_hugePages;
+    std::size_t m_regionSize;
+    std::vector<Region> m_regions;
+    std::size_t m_offset;
+    std::size_t m_usedBytes;
+    std::size_t m_hugePageBytes;
+};
+
+}
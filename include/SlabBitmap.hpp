@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace allocity {
+
+// One bit per block of a slab, set while the block is allocated. Setting and
+// clearing are single atomic read-modify-writes that report the previous
+// state, so a second free of the same block is seen by whichever thread
+// loses the race. Memory use is fixed at capacity / 8 bytes.
+class SlabBitmap {
+public:
+    static constexpr std::size_t BITS_PER_WORD = 64;
+    static constexpr std::size_t NOT_FOUND = SIZE_MAX;
+
+    explicit SlabBitmap(std::size_t capacity);
+
+    SlabBitmap(const SlabBitmap&) = delete;
+    SlabBitmap& operator=(const SlabBitmap&) = delete;
+
+    // Returns false if the bit was already set.
+    bool TestAndSet(std::size_t index) {
+        const std::uint64_t mask = Mask(index);
+        return (m_words[index / BITS_PER_WORD].fetch_or(mask, std::memory_order_acq_rel) & mask) == 0;
+    }
+
+    // Returns false if the bit was already clear.
+    bool TestAndClear(std::size_t index) {
+        const std::uint64_t mask = Mask(index);
+        return (m_words[index / BITS_PER_WORD].fetch_and(~mask, std::memory_order_acq_rel) & mask) != 0;
+    }
+
+    bool Test(std::size_t index) const {
+        return (m_words[index / BITS_PER_WORD].load(std::memory_order_acquire) & Mask(index)) != 0;
+    }
+
+    std::size_t CountSet() const;
+    std::size_t CountClear() const { return m_capacity - CountSet(); }
+
+    // Index of the first set/clear bit at or after start, or NOT_FOUND.
+    std::size_t FindFirstSet(std::size_t start = 0) const;
+    std::size_t FindFirstClear(std::size_t start = 0) const;
+
+    // Writes the indices of up to maxCount clear bits, in ascending order
+    // from start, to indices; returns how many were written.
+    std::size_t FindClear(std::size_t* indices, std::size_t maxCount, std::size_t start = 0) const;
+
+    void ClearAll();
+
+    // Clears the whole word holding index, i.e. BITS_PER_WORD bits.
+    void ClearWord(std::size_t index) {
+        m_words[index / BITS_PER_WORD].store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t GetCapacity() const { return m_capacity; }
+
+private:
+    static std::uint64_t Mask(std::size_t index) { return std::uint64_t(1) << (index % BITS_PER_WORD); }
+
+    // Word `word` with bits past the capacity forced to one, as seen by a
+    // search for clear bits.
+    std::uint64_t LoadForClearSearch(std::size_t word) const;
+
+    std::size_t m_capacity;
+    std::size_t m_wordCount;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_words;
+};
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "StandardBlock.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace allocity {
+
+// Two-Level Segregated Fit heap for medium-sized objects. Every block
+// carries an in-band boundary tag (previous physical block + size/free
+// bit); free blocks are kept in SL_INDEX_COUNT segregated lists per power
+// of two, indexed by a first-level and per-row second-level bitmap, so
+// Allocate and Deallocate (including split and coalesce) are O(1).
+// Arenas are only requested from the system when no free block fits.
+class TlsfHeap {
+public:
+    static constexpr std::size_t ALIGNMENT_LOG2 = 4;
+    static constexpr std::size_t ALIGNMENT = std::size_t(1) << ALIGNMENT_LOG2;
+    static constexpr std::size_t SL_INDEX_COUNT_LOG2 = 5;
+    static constexpr std::size_t SL_INDEX_COUNT = std::size_t(1) << SL_INDEX_COUNT_LOG2;
+    static constexpr std::size_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + ALIGNMENT_LOG2;
+    static constexpr std::size_t FL_INDEX_MAX = 32;
+    static constexpr std::size_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+    static constexpr std::size_t SMALL_BLOCK_SIZE = std::size_t(1) << FL_INDEX_SHIFT;
+    static constexpr std::size_t DEFAULT_ARENA_SIZE = 8 * 1024 * 1024;
+
+    explicit TlsfHeap(std::size_t arenaSize = DEFAULT_ARENA_SIZE);
+    ~TlsfHeap();
+
+    TlsfHeap(const TlsfHeap&) = delete;
+    TlsfHeap& operator=(const TlsfHeap&) = delete;
+    TlsfHeap(TlsfHeap&&) = delete;
+    TlsfHeap& operator=(TlsfHeap&&) = delete;
+
+    void* Allocate(std::size_t size);
+    void Deallocate(void* ptr);
+    // Called under the heap lock for each arena added by Reserve, before
+    // any of it can be handed out.
+    using ArenaCallback = std::function<void(void* memory, std::size_t size)>;
+
+    void Reserve(std::size_t bytes, const ArenaCallback& onArenaAdded = ArenaCallback());
+    static std::size_t GetBlockFootprint(std::size_t size);
+
+    bool Owns(const void* ptr) const;
+    std::size_t GetUsableSize(const void* ptr) const;
+
+    std::size_t GetArenaCount() const;
+    std::size_t GetArenaBytes() const;
+    std::size_t GetUsedBytes() const;
+    std::size_t GetFreeBytes() const;
+
+    std::vector<StandardBlock> DescribeBlocks() const;
+
+    // Calls visit for every block of every arena in address order, under
+    // the heap lock. blockSize includes the block header.
+    using BlockVisitor = std::function<void(const void* payload, std::size_t blockSize, bool isFree)>;
+    void ForEachBlock(const BlockVisitor& visit) const;
+
+private:
+    struct BlockHeader;
+
+    struct Arena {
+        char* memory;
+        std::size_t size;
+    };
+
+    static std::size_t BlockSizeFor(std::size_t size);
+    static void MappingInsert(std::size_t size, std::size_t& fl, std::size_t& sl);
+    static void MappingSearch(std::size_t size, std::size_t& fl, std::size_t& sl);
+
+    BlockHeader* FindSuitableBlock(std::size_t& fl, std::size_t& sl) const;
+    void InsertFreeBlock(BlockHeader* block);
+    void RemoveFreeBlock(BlockHeader* block);
+    void RemoveFreeBlock(BlockHeader* block, std::size_t fl, std::size_t sl);
+    BlockHeader* AddArena(std::size_t minimumBlockSize);
+    bool OwnsUnlocked(const char* ptr) const;
+
+    std::size_t m_arenaSize;
+    std::vector<Arena> m_arenas;
+    std::map<const char*, std::size_t> m_arenaRanges;
+    std::uint32_t m_flBitmap;
+    std::uint32_t m_slBitmap[FL_INDEX_COUNT];
+    BlockHeader* m_freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+    std::size_t m_arenaBytes;
+    std::size_t m_usedBytes;
+    mutable std::mutex m_mutex;
+};
+
+}
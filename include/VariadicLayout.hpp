@@ -1,33 +1,230 @@
 #pragma once
 
-#include <string>
+#include "Allocator.hpp"
+#include "VirtualMemory.hpp"
+#include <array>
 #include <cstddef>
+#include <limits>
+#include <new>
+#include <tuple>
+#include <type_traits>
 
 namespace allocity {
 
+namespace detail {
+
+template <std::size_t N>
+constexpr std::size_t MaxOf(const std::array<std::size_t, N>& values) {
+    std::size_t result = 1;
+    for (std::size_t i = 0; i < N; ++i) {
+        if (values[i] > result) result = values[i];
+    }
+    return result;
+}
+
+// Size arithmetic on runtime counts; a layout that does not fit in
+// size_t cannot be allocated, so it fails like an allocation would.
+constexpr std::size_t CheckedAdd(std::size_t a, std::size_t b) {
+    if (b > std::numeric_limits<std::size_t>::max() - a) throw std::bad_alloc();
+    return a + b;
+}
+
+constexpr std::size_t CheckedMultiply(std::size_t a, std::size_t b) {
+    if (a != 0 && b > std::numeric_limits<std::size_t>::max() / a) throw std::bad_alloc();
+    return a * b;
+}
+
+constexpr std::size_t CheckedAlignUp(std::size_t value, std::size_t alignment) {
+    return CheckedAdd(value, alignment - 1) & ~(alignment - 1);
+}
+
+template <std::size_t N>
+constexpr std::array<std::size_t, N> PackedOffsets(const std::array<std::size_t, N>& sizes,
+                                                   const std::array<std::size_t, N>& alignments,
+                                                   const std::array<std::size_t, N>& counts) {
+    std::array<std::size_t, N> offsets{};
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        offset = CheckedAlignUp(offset, alignments[i]);
+        offsets[i] = offset;
+        offset = CheckedAdd(offset, CheckedMultiply(sizes[i], counts[i]));
+    }
+    return offsets;
+}
+
+template <typename Layout>
+void* AllocateComposite(Allocator& allocator, std::size_t size) {
+    if constexpr (Layout::ALIGNMENT > Allocator::GUARANTEED_ALIGNMENT) {
+        return allocator.AlignedAllocate(size, Layout::ALIGNMENT);
+    } else {
+        return allocator.Allocate(size);
+    }
+}
+
+template <typename Layout>
+void DeallocateComposite(Allocator& allocator, void* base) {
+    if constexpr (Layout::ALIGNMENT > Allocator::GUARANTEED_ALIGNMENT) {
+        allocator.AlignedDeallocate(base);
+    } else {
+        allocator.Deallocate(base);
+    }
+}
+
+}
+
+// Compile-time layout of one object of each of Ts..., packed in declaration
+// order with each member at its natural alignment, so a composite needs a
+// single allocation.
+template <typename... Ts>
 struct VariadicLayout {
 
-    std::string Name;
-    std::size_t indice;
-    std::size_t MaxAllocations;
-    std::size_t MinAllocations;
+    static_assert(sizeof...(Ts) > 0, "VariadicLayout needs at least one member type");
+
+    static constexpr std::size_t COUNT = sizeof...(Ts);
+    static constexpr std::array<std::size_t, COUNT> SIZES = {sizeof(Ts)...};
+    static constexpr std::array<std::size_t, COUNT> ALIGNMENTS = {alignof(Ts)...};
+    static constexpr std::size_t ALIGNMENT = detail::MaxOf(ALIGNMENTS);
+    static constexpr std::array<std::size_t, COUNT> OFFSETS =
+        detail::PackedOffsets(SIZES, ALIGNMENTS, std::array<std::size_t, COUNT>{((void)sizeof(Ts), 1)...});
+    static constexpr std::size_t SIZE = AlignUp(OFFSETS[COUNT - 1] + SIZES[COUNT - 1], ALIGNMENT);
+
+    template <std::size_t I>
+    using ElementType = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    template <std::size_t I>
+    static ElementType<I>* Get(void* base) {
+        return std::launder(reinterpret_cast<ElementType<I>*>(static_cast<char*>(base) + OFFSETS[I]));
+    }
+
+    static void* Allocate(Allocator& allocator) {
+        return detail::AllocateComposite<VariadicLayout>(allocator, SIZE);
+    }
+
+    static void Deallocate(Allocator& allocator, void* base) {
+        detail::DeallocateComposite<VariadicLayout>(allocator, base);
+    }
+
+    // Returns nullptr, like Allocator::Allocate, when a hard tag budget
+    // refuses the allocation.
+    static void* Create(Allocator& allocator) {
+        static_assert((std::is_nothrow_default_constructible_v<Ts> && ...),
+                      "Create requires nothrow default-constructible members; use Allocate and construct in place");
+        void* base = Allocate(allocator);
+        if (base == nullptr) return nullptr;
+        ConstructAll(base, std::index_sequence_for<Ts...>{});
+        return base;
+    }
+
+    static void Destroy(Allocator& allocator, void* base) {
+        if (base == nullptr) return;
+        DestroyAll(base, std::index_sequence_for<Ts...>{});
+        Deallocate(allocator, base);
+    }
+
+private:
+    template <std::size_t... Is>
+    static void ConstructAll(void* base, std::index_sequence<Is...>) {
+        (::new (static_cast<char*>(base) + OFFSETS[Is]) Ts(), ...);
+    }
+
+    template <std::size_t... Is>
+    static void DestroyAll(void* base, std::index_sequence<Is...>) {
+        (Get<Is>(base)->~Ts(), ...);
+    }
+
+};
+
+// Same packing as VariadicLayout<Ts...>, but member I is an array of
+// counts[I] elements whose length is only known at runtime (e.g. a header
+// followed by trailing arrays). Alignment is still resolved at compile time.
+template <typename... Ts>
+class VariadicArrayLayout {
+
+public:
+
+    static_assert(sizeof...(Ts) > 0, "VariadicArrayLayout needs at least one member type");
+
+    static constexpr std::size_t COUNT = sizeof...(Ts);
+    static constexpr std::array<std::size_t, COUNT> SIZES = {sizeof(Ts)...};
+    static constexpr std::array<std::size_t, COUNT> ALIGNMENTS = {alignof(Ts)...};
+    static constexpr std::size_t ALIGNMENT = detail::MaxOf(ALIGNMENTS);
+
+    template <std::size_t I>
+    using ElementType = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    // Throws std::bad_alloc if the composite would not fit in size_t.
+    explicit VariadicArrayLayout(const std::array<std::size_t, COUNT>& counts)
+        : m_Counts(counts),
+          m_Offsets(detail::PackedOffsets(SIZES, ALIGNMENTS, counts)),
+          m_Size(detail::CheckedAlignUp(
+              detail::CheckedAdd(m_Offsets[COUNT - 1], detail::CheckedMultiply(SIZES[COUNT - 1], counts[COUNT - 1])),
+              ALIGNMENT)) {}
+
+    std::size_t GetSize() const { return m_Size; }
+    std::size_t GetCount(std::size_t index) const { return m_Counts[index]; }
+    std::size_t GetOffset(std::size_t index) const { return m_Offsets[index]; }
+
+    template <std::size_t I>
+    ElementType<I>* Get(void* base) const {
+        return std::launder(reinterpret_cast<ElementType<I>*>(static_cast<char*>(base) + m_Offsets[I]));
+    }
+
+    void* Allocate(Allocator& allocator) const {
+        return detail::AllocateComposite<VariadicArrayLayout>(allocator, m_Size);
+    }
+
+    void Deallocate(Allocator& allocator, void* base) const {
+        detail::DeallocateComposite<VariadicArrayLayout>(allocator, base);
+    }
+
+    // Returns nullptr when a hard tag budget refuses the allocation.
+    void* Create(Allocator& allocator) const {
+        static_assert((std::is_nothrow_default_constructible_v<Ts> && ...),
+                      "Create requires nothrow default-constructible members; use Allocate and construct in place");
+        void* base = Allocate(allocator);
+        if (base == nullptr) return nullptr;
+        ConstructAll(base, std::index_sequence_for<Ts...>{});
+        return base;
+    }
+
+    void Destroy(Allocator& allocator, void* base) const {
+        if (base == nullptr) return;
+        DestroyAll(base, std::index_sequence_for<Ts...>{});
+        Deallocate(allocator, base);
+    }
+
+private:
+
+    template <std::size_t... Is>
+    void ConstructAll(void* base, std::index_sequence<Is...>) const {
+        (ConstructArray<Is>(base), ...);
+    }
+
+    template <std::size_t I>
+    void ConstructArray(void* base) const {
+        char* first = static_cast<char*>(base) + m_Offsets[I];
+        for (std::size_t i = 0; i < m_Counts[I]; ++i) {
+            ::new (first + i * SIZES[I]) ElementType<I>();
+        }
+    }
 
-    VariadicLayout() : Name(""), indice(0), MaxAllocations(0), MinAllocations(0) {}
+    template <std::size_t... Is>
+    void DestroyAll(void* base, std::index_sequence<Is...>) const {
+        (DestroyArray<Is>(base), ...);
+    }
 
-    VariadicLayout(std::string name, 
-                   std::size_t indice, 
-                   std::size_t maxAllocations, 
-                   std::size_t minAllocations)
-        : Name(std::move(name)), 
-          indice(indice), 
-          MaxAllocations(maxAllocations), 
-          MinAllocations(minAllocations) {}
+    template <std::size_t I>
+    void DestroyArray(void* base) const {
+        ElementType<I>* first = Get<I>(base);
+        for (std::size_t i = 0; i < m_Counts[I]; ++i) {
+            first[i].~ElementType<I>();
+        }
+    }
 
-    VariadicLayout(const VariadicLayout&) = default;
-    VariadicLayout(VariadicLayout&&) = default;
-    VariadicLayout& operator=(const VariadicLayout&) = default;
-    VariadicLayout& operator=(VariadicLayout&&) = default;
+    std::array<std::size_t, COUNT> m_Counts;
+    std::array<std::size_t, COUNT> m_Offsets;
+    std::size_t m_Size;
 
 };
 
-} 
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace allocity {
+
+// Rounds value up to a multiple of alignment, which must be a power of two.
+constexpr std::size_t AlignUp(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Thin wrapper over the platform's page-level memory API. Reserve() hands
+// out address space whose pages only become resident when first touched
+// (POSIX) or after Commit() (Windows); Decommit() returns the physical
+// pages to the OS while keeping the range reserved.
+class VirtualMemory {
+public:
+    // Transparent huge page size on x86-64 and most arm64 kernels.
+    static constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    static std::size_t PageSize();
+
+    static void* Reserve(std::size_t size);
+    static void* ReserveAligned(std::size_t size, std::size_t alignment);
+    static void Release(void* address, std::size_t size);
+
+    static void Commit(void* address, std::size_t size);
+    static void Decommit(void* address, std::size_t size);
+
+    // Asks the OS to back the range with transparent huge pages once it is
+    // touched. Returns false where the hint is unsupported or refused; the
+    // range stays usable with normal pages either way.
+    static bool AdviseHugePages(void* address, std::size_t size);
+
+    // Faults in every page of the range for writing without changing its
+    // contents. Falls back to touching each page, which is only safe while
+    // no other thread writes to the range.
+    static void Prefault(void* address, std::size_t size);
+    static bool Lock(void* address, std::size_t size);
+    static void Unlock(void* address, std::size_t size);
+
+    static std::size_t GetResidentBytes();
+    // One entry per page overlapping the range: whether it is resident.
+    // Pages that are not mapped at all count as not resident.
+    static std::vector<bool> GetResidentPages(const void* address, std::size_t size);
+};
+
+}
@@ -1,22 +1,79 @@
 #include "../include/Allocator.hpp"
 #include "../include/AllocityThread.hpp"
+#include "../include/BulkMemory.hpp"
+#include "../include/Log.hpp"
+#include "../include/ScratchStack.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <cstring>
+#include <new>
 #include <thread>
 
 namespace allocity {
 
-Allocator::Allocator() 
-    : m_DefaultAllocator(), 
+namespace {
+
+// The allocator whose worker pool the current thread belongs to; work it
+// would queue for that pool runs inline instead of waiting on itself.
+thread_local const Allocator* t_workerOwner = nullptr;
+
+std::vector<std::uint64_t> PackBits(const std::vector<bool>& bits) {
+    std::vector<std::uint64_t> words((bits.size() + 63) / 64, 0);
+    for (std::size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i]) {
+            words[i / 64] |= std::uint64_t(1) << (i % 64);
+        }
+    }
+    return words;
+}
+
+// Bytes of [address, address + size) that lie on resident pages.
+std::uint64_t ResidentBytesIn(const void* address, std::size_t size) {
+    const std::vector<bool> resident = VirtualMemory::GetResidentPages(address, size);
+    const std::size_t pageSize = VirtualMemory::PageSize();
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(address);
+    const std::uintptr_t end = begin + size;
+    const std::uintptr_t firstPage = begin & ~(pageSize - 1);
+    std::uint64_t bytes = 0;
+    for (std::size_t i = 0; i < resident.size(); ++i) {
+        if (resident[i]) {
+            const std::uintptr_t pageBegin = std::max(begin, firstPage + i * pageSize);
+            const std::uintptr_t pageEnd = std::min(end, firstPage + (i + 1) * pageSize);
+            bytes += pageEnd - pageBegin;
+        }
+    }
+    return bytes;
+}
+
+}
+
+Allocator::Allocator() : Allocator(AllocatorConfig::FromEnvironment()) {}
+
+Allocator::Allocator(const AllocatorConfig& config)
+    : m_Config(config),
+      m_DefaultAllocator(), 
       m_AllocationMap(), 
       m_AllocationMutex(), 
-      m_DeallocatedPointers(), 
       m_debugMode(false),
-      m_MemoryPools(NUM_MEMORY_POOLS),
-      m_StopThreads(false) {
-    InitializeMemoryPools();
-    InitializeThreadPool(std::thread::hardware_concurrency());
+      m_SlabArena(config.HugePageSlabs),
+      m_StopThreads(false),
+      m_LockedBytes(0) {
+    m_Config.Validate();
+    for (auto& slot : m_PoolTable) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+    if (m_Config.PerCpuCaches) {
+        m_CpuCache = std::make_unique<PerCpuCache>(NUM_MEMORY_POOLS);
+    }
+    if (!m_Config.LazyInitialization) {
+        InitializeMemoryPools();
+        StartThreadPool();
+    }
 }
 
 Allocator::~Allocator() {
@@ -24,15 +81,59 @@ Allocator::~Allocator() {
 }
 
 void Allocator::InitializeMemoryPools() {
-    m_MemoryPools.clear();
-    m_MemoryPools.reserve(NUM_MEMORY_POOLS);
-    for (size_t i = 0; i < NUM_MEMORY_POOLS; ++i) {
-        m_MemoryPools.push_back(std::make_unique<MemoryPool>((i + 1) * 8, 1024));
+    for (size_t i = 0; i < m_Config.MaxSmallObjectSize / AllocatorConfig::SIZE_CLASS_GRANULARITY; ++i) {
+        if (CreatePool(i) == nullptr) {
+            throw std::bad_alloc();
+        }
     }
 }
 
+MemoryPool* Allocator::CreatePool(std::size_t poolIndex, std::size_t minimumBlocks) {
+    std::lock_guard<std::mutex> lock(m_PoolCreationMutex);
+    MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_relaxed);
+    if (pool != nullptr) {
+        return pool;
+    }
+    const std::size_t blockSize = (poolIndex + 1) * AllocatorConfig::SIZE_CLASS_GRANULARITY;
+    const std::size_t blocks = std::max(m_Config.PoolBlocks, minimumBlocks);
+    const std::size_t slabBytes = std::min(blockSize * blocks, m_PageHeap.GetMaxBlockSize());
+    std::size_t slabSize;
+    void* slab;
+    if (m_Config.HugePageSlabs) {
+        // Slabs of all classes sit next to each other in the arena, so a
+        // handful of huge pages covers every pool.
+        slabSize = (slabBytes + VirtualMemory::PageSize() - 1) / VirtualMemory::PageSize() * VirtualMemory::PageSize();
+        // The arena throws where the page heap returns nullptr; callers
+        // expect the latter so they can fall back to the slow path.
+        try {
+            slab = m_SlabArena.Allocate(slabSize);
+        } catch (const std::bad_alloc&) {
+            slab = nullptr;
+        }
+    } else {
+        slabSize = m_PageHeap.RoundUp(slabBytes);
+        slab = m_PageHeap.Allocate(slabSize);
+    }
+    if (slab == nullptr) {
+        return nullptr;
+    }
+    m_MemoryPools.push_back(std::make_unique<MemoryPool>(blockSize, slabSize / blockSize, slab));
+    pool = m_MemoryPools.back().get();
+    if (m_CpuCache != nullptr) {
+        // Left uninitialized, so records of untouched blocks stay unbacked.
+        m_PoolBlockRecords[poolIndex].reset(new PoolBlockRecord[pool->GetCapacity()]);
+    }
+    m_PoolTable[poolIndex].store(pool, std::memory_order_release);
+    return pool;
+}
+
 bool Allocator::IsPoolAllocation(std::size_t size) const {
-    return size <= MAX_SMALL_OBJECT_SIZE;
+    return size <= m_Config.MaxSmallObjectSize;
+}
+
+bool Allocator::IsPageAllocation(std::size_t size) const {
+    const std::size_t pageSize = m_PageHeap.GetMinBlockSize();
+    return size >= pageSize && size <= m_PageHeap.GetMaxBlockSize() && size % pageSize == 0;
 }
 
 void Allocator::InitializeThreadPool(size_t numThreads) {
@@ -41,28 +142,54 @@ void Allocator::InitializeThreadPool(size_t numThreads) {
     }
 }
 
+void Allocator::StartThreadPool() {
+    std::call_once(m_ThreadPoolStarted, [this] { InitializeThreadPool(m_Config.ResolveWorkerThreads()); });
+}
+
 void Allocator::AddWorkToQueue(std::function<void()> work) {
+    StartThreadPool();
     {
         std::lock_guard<std::mutex> lock(m_ThreadPoolMutex);
-        m_WorkQueue.push(std::move(work));
+        if (!m_ThreadPool.empty() && !m_StopThreads) {
+            m_WorkQueue.push(std::move(work));
+            m_ThreadPoolCondition.notify_one();
+            return;
+        }
     }
-    m_ThreadPoolCondition.notify_one();
+    work();
 }
 
 void Allocator::ThreadWorker() {
-    while (!m_StopThreads) {
-        std::unique_lock<std::mutex> lock(m_ThreadPoolMutex);
-        m_ThreadPoolCondition.wait(lock, [this] { return m_StopThreads || !m_WorkQueue.empty(); });
-
-        if (!m_WorkQueue.empty()) {
-            auto work = m_WorkQueue.front();
+    t_workerOwner = this;
+    for (;;) {
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(m_ThreadPoolMutex);
+            m_ThreadPoolCondition.wait(lock, [this] { return m_StopThreads || !m_WorkQueue.empty(); });
+            // A stop request lets the queue drain first, so no promise is
+            // broken and no onReady is skipped.
+            if (m_WorkQueue.empty()) {
+                return;
+            }
+            work = std::move(m_WorkQueue.front());
             m_WorkQueue.pop();
-            lock.unlock();
+        }
+        // Tasks report their own failures where they have a caller or a
+        // future to report to; whatever still escapes must not terminate.
+        try {
             work();
+        } catch (const std::exception& e) {
+            ALLOCITY_LOG_ERROR("Worker task threw: {}", e.what());
+        } catch (...) {
+            ALLOCITY_LOG_ERROR("Worker task threw a non-standard exception");
         }
     }
 }
 
+const AllocatorConfig& Allocator::GetConfig() const {
+    return m_Config;
+}
+
 const DefaultAllocator& Allocator::GetDefaultAllocator() const {
     return m_DefaultAllocator;
 }
@@ -71,80 +198,321 @@ void Allocator::SetDefaultAllocator(const DefaultAllocator& allocator) {
     m_DefaultAllocator = allocator;
 }
 
-void* Allocator::Allocate(std::size_t size) {
+void* Allocator::AllocateSlow(std::size_t size, MemoryTag tag) {
     if (size == 0) {
-        std::cout << "Allocating 0 bytes, returning nullptr\n";
+        ALLOCITY_LOG_DEBUG("Allocating 0 bytes, returning nullptr");
         return nullptr;
     }
 
+    const bool timed = m_LatencyRecorder.IsEnabled();
+    const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
+
+    AllocationPath path = AllocationPath::Large;
     void* ptr = nullptr;
-    bool isPoolAllocation = IsPoolAllocation(size);
+    if (IsPageAllocation(size)) {
+        path = AllocationPath::Page;
+        ptr = m_PageHeap.Allocate(size);
+    } else if (size <= m_Config.MaxMediumObjectSize) {
+        path = AllocationPath::Medium;
+        ptr = m_MediumHeap.Allocate(size);
+    }
+    if (ptr == nullptr) {
+        path = AllocationPath::Large;
+        try {
+            ptr = m_DefaultAllocator.Allocate(size);
+        } catch (...) {
+            MemoryTags::Release(tag, size);
+            throw;
+        }
+    }
+    if (ptr) {
+        {
+            std::lock_guard<std::mutex> lock(m_AllocationMutex);
+            TrackAllocation(ptr, size, path, tag);
+        }
+        if (m_debugMode) {
+            CheckForUseAfterFree(ptr, size);
+        }
+    }
 
-    if (isPoolAllocation) {
-        ptr = AllocateFromPool(size);
-    } else {
-        ptr = m_DefaultAllocator.Allocate(size);
+    if (timed) {
+        m_LatencyRecorder.Record(LatencyOperation::Allocate, path, start);
     }
+    return ptr;
+}
 
-    if (ptr) {
-        std::lock_guard<std::mutex> lock(m_AllocationMutex);
-        TrackAllocation(ptr, size, isPoolAllocation);
+void Allocator::CheckForUseAfterFree(void* ptr, std::size_t size) const {
+    for (std::size_t i = 0; i < size; ++i) {
+        if (static_cast<unsigned char*>(ptr)[i] == DEBUG_PATTERN) {
+            ALLOCITY_LOG_WARNING("Possible use-after-free detected at {}", ptr);
+            break;
+        }
+    }
+}
 
-        if (m_debugMode) {
-            for (std::size_t i = 0; i < size; ++i) {
-                if (static_cast<unsigned char*>(ptr)[i] == DEBUG_PATTERN) {
-                    std::cerr << "Warning: Possible use-after-free detected at " << ptr << std::endl;
-                    break;
+Allocator::AllocationInfo Allocator::ReleaseAllocation(void* ptr, const char* unknownPointerMessage) {
+    std::lock_guard<std::mutex> lock(m_AllocationMutex);
+    const AllocationInfo* tracked = m_AllocationTracker.find(ptr);
+    if (tracked == nullptr) {
+        ThrowInvalidFree(ptr, unknownPointerMessage);
+    }
+    const AllocationInfo info = *tracked;
+    UntrackAllocation(ptr);
+    MemoryTags::Release(info.tag, info.size);
+    return info;
+}
+
+std::future<void*> Allocator::AllocateAsync(std::size_t size, AllocationFlags flags) {
+    auto promise = std::make_shared<std::promise<void*>>();
+    std::future<void*> future = promise->get_future();
+    try {
+        PrepareAsync(size, flags, [promise](void* ptr, std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value(ptr);
+            }
+        });
+    } catch (...) {
+        promise->set_exception(std::current_exception());
+    }
+    return future;
+}
+
+void Allocator::AllocateAsync(std::size_t size, AllocationFlags flags, std::function<void(void*)> onReady) {
+    PrepareAsync(size, flags, [onReady = std::move(onReady)](void* ptr, std::exception_ptr) { onReady(ptr); });
+}
+
+void Allocator::PrepareAsync(std::size_t size, AllocationFlags flags, std::function<void(void*, std::exception_ptr)> finish) {
+    void* ptr = Allocate(size);
+    const bool zero = HasFlag(flags, AllocationFlags::Zero);
+    if (ptr == nullptr || (!zero && !HasFlag(flags, AllocationFlags::Prefault))) {
+        finish(ptr, nullptr);
+        return;
+    }
+
+    const std::size_t chunkSize = ChunkSizeFor(size);
+
+    // The last chunk to finish hands the region over; no worker ever waits
+    // on another, so this cannot starve a small pool. The first chunk to
+    // fail records why, and the last one frees the region instead.
+    struct State {
+        std::atomic<std::size_t> pending;
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::function<void(void*, std::exception_ptr)> finish;
+    };
+    auto state = std::make_shared<State>();
+    state->pending.store((size + chunkSize - 1) / chunkSize, std::memory_order_relaxed);
+    state->finish = std::move(finish);
+    char* base = static_cast<char*>(ptr);
+    for (std::size_t offset = 0; offset < size; offset += chunkSize) {
+        const std::size_t length = std::min(chunkSize, size - offset);
+        AddWorkToQueue([this, base, offset, length, zero, state] {
+            try {
+                if (zero) {
+                    BulkMemory::Fill(base + offset, 0, length);
+                } else {
+                    VirtualMemory::Prefault(base + offset, length);
+                }
+            } catch (...) {
+                if (!state->failed.exchange(true, std::memory_order_relaxed)) {
+                    state->error = std::current_exception();
                 }
             }
-        }
+            if (state->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            if (state->error) {
+                Deallocate(base);
+                state->finish(nullptr, state->error);
+            } else {
+                state->finish(base, nullptr);
+            }
+        });
     }
-    return ptr;
 }
 
-void* Allocator::AllocateFromPool(std::size_t size) {
-    size_t poolIndex = (size - 1) / 8;
-    return m_MemoryPools[poolIndex]->Allocate();
+void Allocator::ThrowInvalidFree(void* ptr, const char* unknownPointerMessage) const {
+    for (std::size_t poolIndex = 0; poolIndex < NUM_MEMORY_POOLS; ++poolIndex) {
+        const MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool == nullptr || !pool->Owns(ptr)) {
+            continue;
+        }
+        if (!pool->IsBlockStart(ptr)) {
+            throw std::invalid_argument("Invalid free of a pointer into the middle of a pool block");
+        }
+        // Blocks in the per-CPU caches are marked free in their pool.
+        if (!pool->IsAllocated(ptr)) {
+            throw std::runtime_error("Double free detected");
+        }
+    }
+    throw std::runtime_error(unknownPointerMessage);
 }
 
 void Allocator::Deallocate(void* ptr) {
     if (ptr == nullptr) {
-        std::cout << "Attempting to deallocate nullptr, ignoring\n";
+        ALLOCITY_LOG_DEBUG("Attempting to deallocate nullptr, ignoring");
         return;
     }
 
-    std::size_t size;
-    bool isPoolAllocation;
+    const bool timed = m_LatencyRecorder.IsEnabled();
+    const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
+
+    std::size_t poolIndex;
+    AllocationPath timedPath;
+    if (MemoryPool* pool = FindUntrackedPool(ptr, poolIndex)) {
+        timedPath = ReleaseUntrackedBlock(pool, poolIndex, ptr);
+    } else {
+        timedPath = ReleaseBlock(ptr, ReleaseAllocation(ptr, "Attempting to deallocate unknown pointer"));
+    }
+
+    if (timed) {
+        m_LatencyRecorder.Record(LatencyOperation::Deallocate, timedPath, start);
+    }
+}
+
+void Allocator::DeallocateBatch(void* const* ptrs, std::size_t count) {
+    ScratchMarker scratch;
+    AllocationInfo* infos = scratch.AllocateArray<AllocationInfo>(count);
+    // A pointer listed twice would pass the tracker check below, so
+    // duplicates are found on a sorted copy before anything is untracked.
+    void** sorted = scratch.AllocateArray<void*>(count);
+    std::size_t pointerCount = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (ptrs[i] != nullptr) {
+            sorted[pointerCount++] = ptrs[i];
+        }
+    }
+    std::sort(sorted, sorted + pointerCount, std::less<void*>());
+    if (std::adjacent_find(sorted, sorted + pointerCount) != sorted + pointerCount) {
+        throw std::runtime_error("Double free detected");
+    }
+    // Untracked pool blocks (per-CPU mode) are checked against their
+    // pool's bitmap and freed on their own, like DeallocateSmall does.
+    MemoryPool** untrackedPools = scratch.AllocateArray<MemoryPool*>(count);
+    std::size_t* poolIndices = scratch.AllocateArray<std::size_t>(count);
     {
         std::lock_guard<std::mutex> lock(m_AllocationMutex);
-        auto it = m_AllocationTracker.find(ptr);
-        if (it == m_AllocationTracker.end()) {
-            throw std::runtime_error("Attempting to deallocate unknown pointer");
+        for (std::size_t i = 0; i < count; ++i) {
+            if (ptrs[i] == nullptr) {
+                continue;
+            }
+            untrackedPools[i] = FindUntrackedPool(ptrs[i], poolIndices[i]);
+            const bool known = untrackedPools[i] != nullptr ? untrackedPools[i]->IsAllocated(ptrs[i])
+                                                            : m_AllocationTracker.find(ptrs[i]) != nullptr;
+            if (!known) {
+                ThrowInvalidFree(ptrs[i], "Attempting to deallocate unknown pointer");
+            }
         }
-        if (m_DeallocatedPointers.find(ptr) != m_DeallocatedPointers.end()) {
-            throw std::runtime_error("Double free detected");
+        for (std::size_t i = 0; i < count; ++i) {
+            if (ptrs[i] == nullptr || untrackedPools[i] != nullptr) {
+                continue;
+            }
+            infos[i] = *m_AllocationTracker.find(ptrs[i]);
+            UntrackAllocation(ptrs[i]);
+            MemoryTags::Release(infos[i].tag, infos[i].size);
+        }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        if (ptrs[i] == nullptr) {
+            continue;
+        }
+        if (untrackedPools[i] != nullptr) {
+            ReleaseUntrackedBlock(untrackedPools[i], poolIndices[i], ptrs[i]);
+        } else {
+            ReleaseBlock(ptrs[i], infos[i]);
         }
-        size = it->second.size;
-        isPoolAllocation = it->second.isPoolAllocation;
     }
+}
 
-    if (isPoolAllocation) {
-        DeallocateToPool(ptr, size);
+AllocationPath Allocator::ReleaseBlock(void* ptr, const AllocationInfo& info) {
+    if (info.path == AllocationPath::Pool) {
+        m_PoolTable[PoolIndex(info.size)].load(std::memory_order_acquire)->Deallocate(ptr);
+        return info.path;
+    }
+    if (m_debugMode) {
+        ParallelFill(ptr, DEBUG_PATTERN, info.size);
+    }
+    if (info.path == AllocationPath::Medium) {
+        m_MediumHeap.Deallocate(ptr);
+    } else if (info.path == AllocationPath::Page) {
+        m_PageHeap.Deallocate(ptr);
+    } else if (info.path == AllocationPath::Aligned) {
+        m_DefaultAllocator.AlignedDeallocate(ptr, info.size);
     } else {
-        std::cout << "Deallocating known pointer: " << ptr << " of size " << size << std::endl;
-        if (m_debugMode) {
-            std::memset(ptr, DEBUG_PATTERN, size);
+        ALLOCITY_LOG_TRACE("Deallocating known pointer: {} of size {}", ptr, info.size);
+        m_DefaultAllocator.Deallocate(ptr, info.size);
+    }
+    return info.path;
+}
+
+void* Allocator::Reallocate(void* ptr, std::size_t size) {
+    if (ptr == nullptr) {
+        return Allocate(size);
+    }
+    if (size == 0) {
+        Deallocate(ptr);
+        return nullptr;
+    }
+
+    AllocationInfo info;
+    std::size_t poolIndex;
+    if (const MemoryPool* pool = FindUntrackedPool(ptr, poolIndex)) {
+        if (!pool->IsAllocated(ptr)) {
+            ThrowInvalidFree(ptr, "Attempting to reallocate unknown pointer");
         }
-        m_DefaultAllocator.Deallocate(ptr, size);
+        const PoolBlockRecord& record = m_PoolBlockRecords[poolIndex][pool->GetBlockIndex(ptr)];
+        info = {record.size, AllocationPath::Pool, record.tag};
+    } else {
+        std::lock_guard<std::mutex> lock(m_AllocationMutex);
+        const AllocationInfo* tracked = m_AllocationTracker.find(ptr);
+        if (tracked == nullptr) {
+            ThrowInvalidFree(ptr, "Attempting to reallocate unknown pointer");
+        }
+        info = *tracked;
+    }
+    if (info.path == AllocationPath::Aligned) {
+        throw std::invalid_argument("Reallocate does not support aligned allocations");
+    }
+    if (size == info.size) {
+        return ptr;
     }
 
-    std::lock_guard<std::mutex> lock(m_AllocationMutex);
-    UntrackAllocation(ptr);
+    void* result = Allocate(size, info.tag);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    ParallelCopy(result, ptr, std::min(size, info.size));
+    Deallocate(ptr);
+    return result;
+}
+
+void Allocator::ParallelFill(void* destination, unsigned char value, std::size_t size) {
+    if (size < m_Config.ParallelThreshold) {
+        BulkMemory::Fill(destination, value, size);
+        return;
+    }
+    char* base = static_cast<char*>(destination);
+    const std::size_t chunkSize = ChunkSizeFor(size);
+    RunChunked((size + chunkSize - 1) / chunkSize, [=](std::size_t chunk) {
+        const std::size_t offset = chunk * chunkSize;
+        BulkMemory::Fill(base + offset, value, std::min(chunkSize, size - offset));
+    });
 }
 
-void Allocator::DeallocateToPool(void* ptr, std::size_t size) {
-    size_t poolIndex = (size - 1) / 8;
-    m_MemoryPools[poolIndex]->Deallocate(ptr);
+void Allocator::ParallelCopy(void* destination, const void* source, std::size_t size) {
+    if (size < m_Config.ParallelThreshold) {
+        BulkMemory::Copy(destination, source, size);
+        return;
+    }
+    char* to = static_cast<char*>(destination);
+    const char* from = static_cast<const char*>(source);
+    const std::size_t chunkSize = ChunkSizeFor(size);
+    RunChunked((size + chunkSize - 1) / chunkSize, [=](std::size_t chunk) {
+        const std::size_t offset = chunk * chunkSize;
+        BulkMemory::Copy(to + offset, from + offset, std::min(chunkSize, size - offset));
+    });
 }
 
 void* Allocator::Assign(void* ptr) {
@@ -156,46 +524,58 @@ void Allocator::Deassign(void* ptr) {
 }
 
 void* Allocator::AlignedAllocate(std::size_t size, std::size_t alignment) {
-    void* ptr = m_DefaultAllocator.AlignedAllocate(size, alignment);
-    if (ptr) {
-        std::lock_guard<std::mutex> lock(m_AllocationMutex);
-        TrackAllocation(ptr, size, false);
+    return AlignedAllocate(size, alignment, MemoryTags::GetCurrent());
+}
 
+void* Allocator::AlignedAllocate(std::size_t size, std::size_t alignment, MemoryTag tag) {
+    if (!MemoryTags::Charge(tag, size)) {
+        return nullptr;
+    }
+
+    const bool timed = m_LatencyRecorder.IsEnabled();
+    const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
+
+    void* ptr;
+    try {
+        ptr = m_DefaultAllocator.AlignedAllocate(size, alignment);
+    } catch (...) {
+        MemoryTags::Release(tag, size);
+        throw;
+    }
+    if (ptr == nullptr) {
+        MemoryTags::Release(tag, size);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_AllocationMutex);
+            TrackAllocation(ptr, size, AllocationPath::Aligned, tag);
+        }
         if (m_debugMode) {
-            for (std::size_t i = 0; i < size; ++i) {
-                if (static_cast<unsigned char*>(ptr)[i] == DEBUG_PATTERN) {
-                    std::cerr << "Warning: Possible use-after-free detected at " << ptr << std::endl;
-                    break;
-                }
-            }
+            CheckForUseAfterFree(ptr, size);
         }
     }
+
+    if (timed) {
+        m_LatencyRecorder.Record(LatencyOperation::Allocate, AllocationPath::Aligned, start);
+    }
     return ptr;
 }
 
 void Allocator::AlignedDeallocate(void* ptr) {
     if (ptr) {
-        std::size_t size;
-        {
-            std::lock_guard<std::mutex> lock(m_AllocationMutex);
-            auto it = m_AllocationTracker.find(ptr);
-            if (it == m_AllocationTracker.end()) {
-                throw std::runtime_error("Attempting to aligned deallocate unknown pointer");
-            }
-            if (m_DeallocatedPointers.find(ptr) != m_DeallocatedPointers.end()) {
-                throw std::runtime_error("Double free detected");
-            }
-            size = it->second.size;
-        }
+        const bool timed = m_LatencyRecorder.IsEnabled();
+        const std::uint64_t start = timed ? LatencyRecorder::ReadTimestamp() : 0;
 
-        std::cout << "Deallocating aligned pointer: " << ptr << " of size " << size << std::endl;
+        const std::size_t size = ReleaseAllocation(ptr, "Attempting to aligned deallocate unknown pointer").size;
+
+        ALLOCITY_LOG_TRACE("Deallocating aligned pointer: {} of size {}", ptr, size);
         if (m_debugMode) {
-            std::memset(ptr, DEBUG_PATTERN, size);
+            ParallelFill(ptr, DEBUG_PATTERN, size);
         }
         m_DefaultAllocator.AlignedDeallocate(ptr, size);
 
-        std::lock_guard<std::mutex> lock(m_AllocationMutex);
-        UntrackAllocation(ptr);
+        if (timed) {
+            m_LatencyRecorder.Record(LatencyOperation::Deallocate, AllocationPath::Aligned, start);
+        }
     }
 }
 
@@ -221,40 +601,363 @@ std::size_t Allocator::GetPeakMemoryUsage() const {
 
 void Allocator::ReportMemoryUsage() const {
     m_DefaultAllocator.ReportMemoryUsage();
+    m_PageHeap.ReportFragmentation(std::cout);
+    MemoryTags::Report(std::cout);
+    m_LatencyRecorder.Report(std::cout);
 }
 
-std::size_t* Allocator::FindAllocation(void* ptr) {
+HeapSnapshot Allocator::CaptureHeapSnapshot() const {
+    HeapSnapshot snapshot;
+    snapshot.PageSize = VirtualMemory::PageSize();
     std::lock_guard<std::mutex> lock(m_AllocationMutex);
-    auto it = m_AllocationTracker.find(ptr);
-    if (it != m_AllocationTracker.end()) {
-        return &(it->second.size);
+
+    // Pools are never destroyed before the allocator, so the table can be
+    // read without the creation lock.
+    std::size_t slabOf[NUM_MEMORY_POOLS];
+    std::unordered_set<const void*> poolSlabs;
+    for (std::size_t poolIndex = 0; poolIndex < NUM_MEMORY_POOLS; ++poolIndex) {
+        slabOf[poolIndex] = SIZE_MAX;
+        const MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool == nullptr) {
+            continue;
+        }
+        HeapSnapshot::Slab slab;
+        slab.Address = reinterpret_cast<std::uintptr_t>(pool->GetMemory());
+        slab.BlockSize = pool->GetBlockSize();
+        slab.Capacity = pool->GetCapacity();
+        slab.Frontier = pool->GetFrontier();
+        slab.PoolUsedBlocks = pool->GetUsedBlocks();
+        slab.Occupancy.assign((slab.Frontier + 63) / 64, 0);
+        slab.ResidentPages = PackBits(VirtualMemory::GetResidentPages(pool->GetMemory(), slab.Capacity * slab.BlockSize));
+        slabOf[poolIndex] = snapshot.Slabs.size();
+        snapshot.Slabs.push_back(std::move(slab));
+        poolSlabs.insert(pool->GetMemory());
     }
-    return nullptr;
+
+    std::vector<std::map<MemoryTag, std::uint64_t>> slabTags(snapshot.Slabs.size());
+    std::unordered_set<MemoryTag> tags;
+    auto addPoolBlock = [&](std::size_t poolIndex, const void* address, std::size_t size, MemoryTag tag) {
+        tags.insert(tag);
+        HeapSnapshot::Slab& slab = snapshot.Slabs[slabOf[poolIndex]];
+        const std::uint64_t block = (reinterpret_cast<std::uintptr_t>(address) - slab.Address) / slab.BlockSize;
+        if (block < slab.Frontier) {
+            slab.Occupancy[block / 64] |= std::uint64_t(1) << (block % 64);
+        }
+        slab.LiveBytes += size;
+        slabTags[slabOf[poolIndex]][tag] += size;
+    };
+    ForEachUntrackedBlock([&](std::size_t poolIndex, void* block, const PoolBlockRecord& record) {
+        addPoolBlock(poolIndex, block, record.size, record.tag);
+    });
+    m_AllocationTracker.forEach([&](void* address, const AllocationInfo& info) {
+        tags.insert(info.tag);
+        if (info.path == AllocationPath::Pool) {
+            addPoolBlock(PoolIndex(info.size), address, info.size, info.tag);
+        } else if (info.path == AllocationPath::Large || info.path == AllocationPath::Aligned) {
+            HeapSnapshot::Span span;
+            span.Heap = HeapSnapshot::SpanHeap::System;
+            span.Tag = info.tag;
+            span.Address = reinterpret_cast<std::uintptr_t>(address);
+            span.Size = info.size;
+            span.LiveBytes = info.size;
+            span.ResidentBytes = ResidentBytesIn(address, info.size);
+            snapshot.Spans.push_back(span);
+        }
+    });
+    for (std::size_t i = 0; i < slabTags.size(); ++i) {
+        snapshot.Slabs[i].TagBytes.assign(slabTags[i].begin(), slabTags[i].end());
+    }
+
+    auto addSpan = [&](HeapSnapshot::SpanHeap heap, const void* address, std::size_t size, bool isFree) {
+        HeapSnapshot::Span span;
+        span.Heap = heap;
+        span.Free = isFree;
+        span.Address = reinterpret_cast<std::uintptr_t>(address);
+        span.Size = size;
+        span.ResidentBytes = ResidentBytesIn(address, size);
+        const AllocationInfo* tracked = isFree ? nullptr : m_AllocationTracker.find(const_cast<void*>(address));
+        if (tracked != nullptr) {
+            span.LiveBytes = tracked->size;
+            span.Tag = tracked->tag;
+        }
+        snapshot.Spans.push_back(span);
+    };
+    m_PageHeap.ForEachSpan([&](const void* address, std::size_t size, bool isFree) {
+        // Pool slabs taken from the page heap are already listed as slabs.
+        if (isFree || poolSlabs.count(address) == 0) {
+            addSpan(HeapSnapshot::SpanHeap::Page, address, size, isFree);
+        }
+    });
+    m_MediumHeap.ForEachBlock([&](const void* payload, std::size_t blockSize, bool isFree) {
+        addSpan(HeapSnapshot::SpanHeap::Medium, payload, blockSize, isFree);
+    });
+    std::sort(snapshot.Spans.begin(), snapshot.Spans.end(),
+              [](const HeapSnapshot::Span& a, const HeapSnapshot::Span& b) { return a.Address < b.Address; });
+
+    for (MemoryTag tag : tags) {
+        snapshot.TagNames.emplace_back(tag, MemoryTags::GetName(tag));
+    }
+    std::sort(snapshot.TagNames.begin(), snapshot.TagNames.end());
+    snapshot.ProcessResidentBytes = VirtualMemory::GetResidentBytes();
+    return snapshot;
+}
+
+void Allocator::DumpHeapSnapshot(const std::string& path) const {
+    const HeapSnapshot snapshot = CaptureHeapSnapshot();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to open heap snapshot file: " + path);
+    }
+    snapshot.Write(out);
+}
+
+void Allocator::ReserveMediumHeap(std::size_t bytes) {
+    m_MediumHeap.Reserve(bytes);
+}
+
+ReserveResult Allocator::Reserve(std::size_t size, std::size_t count, bool lockMemory) {
+    ReserveResult result;
+    if (size == 0 || count == 0) {
+        return result;
+    }
+    {
+        // Grow the trackers now rather than from inside a later Allocate.
+        std::lock_guard<std::mutex> lock(m_AllocationMutex);
+        m_AllocationTracker.reserve(m_AllocationTracker.size() + count);
+        if (m_Config.Tracking == TrackingLevel::Full) {
+            m_AllocationMap.reserve(m_AllocationMap.size() + count);
+        }
+    }
+
+    if (size <= m_Config.MaxSmallObjectSize) {
+        // Pools only write a block when they first hand it out, so the
+        // slab is prefaulted like any other reserved range.
+        const std::size_t poolIndex = PoolIndex(size);
+        MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool == nullptr) {
+            pool = CreatePool(poolIndex, count);
+        }
+        std::size_t available = 0;
+        if (pool != nullptr) {
+            const std::size_t slabBytes = pool->GetCapacity() * pool->GetBlockSize();
+            PrefaultRanges({{static_cast<char*>(pool->GetMemory()), slabBytes}});
+            result.PrefaultedBytes += slabBytes;
+            if (lockMemory) {
+                LockRange(pool->GetMemory(), slabBytes, result);
+            }
+            available = pool->GetCapacity() - pool->GetUsedBlocks();
+        }
+        if (available < count) {
+            const ReserveResult overflow = ReserveBytes((count - available) * TlsfHeap::GetBlockFootprint(size), lockMemory);
+            result.PrefaultedBytes += overflow.PrefaultedBytes;
+            result.LockedBytes += overflow.LockedBytes;
+        }
+        return result;
+    }
+
+    if (IsPageAllocation(size)) {
+        m_PageHeap.SetDecommitThreshold(SIZE_MAX);
+        std::vector<std::pair<char*, std::size_t>> spans;
+        for (std::size_t i = 0; i < count; ++i) {
+            void* span = m_PageHeap.Allocate(size);
+            if (span == nullptr) {
+                break;
+            }
+            spans.emplace_back(static_cast<char*>(span), size);
+        }
+        PrefaultRanges(spans);
+        for (const auto& span : spans) {
+            result.PrefaultedBytes += span.second;
+            if (lockMemory) {
+                LockRange(span.first, span.second, result);
+            }
+            m_PageHeap.Deallocate(span.first);
+        }
+        return result;
+    }
+
+    if (size <= m_Config.MaxMediumObjectSize) {
+        return ReserveBytes(count * TlsfHeap::GetBlockFootprint(size), lockMemory);
+    }
+    return result;
+}
+
+ReserveResult Allocator::ReserveBytes(std::size_t bytes, bool lockMemory) {
+    ReserveResult result;
+    m_MediumHeap.Reserve(bytes, [&](void* memory, std::size_t size) {
+        PrefaultRanges({{static_cast<char*>(memory), size}});
+        result.PrefaultedBytes += size;
+        if (lockMemory) {
+            LockRange(memory, size, result);
+        }
+    });
+    return result;
+}
+
+std::size_t Allocator::GetLockedBytes() const {
+    return m_LockedBytes.load(std::memory_order_relaxed);
+}
+
+void Allocator::LockRange(void* address, std::size_t size, ReserveResult& result) {
+    if (VirtualMemory::Lock(address, size)) {
+        result.LockedBytes += size;
+        m_LockedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+std::size_t Allocator::ChunkSizeFor(std::size_t size) {
+    StartThreadPool();
+    const std::size_t workers = std::max<std::size_t>(m_ThreadPool.size(), 1);
+    const std::size_t perWorker = size / (workers * ASYNC_CHUNKS_PER_WORKER);
+    return std::max(PREFAULT_CHUNK_SIZE, (perWorker + PREFAULT_CHUNK_SIZE - 1) / PREFAULT_CHUNK_SIZE * PREFAULT_CHUNK_SIZE);
+}
+
+void Allocator::RunChunked(std::size_t chunkCount, const std::function<void(std::size_t)>& task) {
+    StartThreadPool();
+    // The caller takes part, so one core is already busy.
+    std::size_t helpers = t_workerOwner == this || chunkCount < 2 ? 0 : std::min(m_ThreadPool.size(), chunkCount - 1);
+    const std::size_t cores = std::thread::hardware_concurrency();
+    if (cores != 0) {
+        helpers = std::min(helpers, cores - 1);
+    }
+    if (helpers == 0) {
+        for (std::size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            task(chunk);
+        }
+        return;
+    }
+
+    // The caller and the helpers claim chunks from a shared counter. A
+    // helper that only starts after every chunk is claimed returns without
+    // touching task, so the state outlives this call but task need not.
+    // A chunk that throws still counts as finished, so the caller never
+    // waits forever; the first exception is rethrown to the caller.
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> finished{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    auto work = [state, &task, chunkCount] {
+        for (std::size_t chunk; (chunk = state->next.fetch_add(1, std::memory_order_relaxed)) < chunkCount;) {
+            try {
+                task(chunk);
+            } catch (...) {
+                if (!state->failed.exchange(true, std::memory_order_relaxed)) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->finished.fetch_add(1, std::memory_order_acq_rel) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+    for (std::size_t i = 0; i < helpers; ++i) {
+        AddWorkToQueue(work);
+    }
+    work();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&] { return state->finished.load(std::memory_order_acquire) == chunkCount; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+void Allocator::PrefaultRanges(const std::vector<std::pair<char*, std::size_t>>& ranges) {
+    std::vector<std::pair<char*, std::size_t>> chunks;
+    for (const auto& range : ranges) {
+        for (std::size_t offset = 0; offset < range.second; offset += PREFAULT_CHUNK_SIZE) {
+            chunks.emplace_back(range.first + offset, std::min(PREFAULT_CHUNK_SIZE, range.second - offset));
+        }
+    }
+    RunChunked(chunks.size(), [&](std::size_t chunk) {
+        VirtualMemory::Prefault(chunks[chunk].first, chunks[chunk].second);
+    });
+}
+
+std::vector<StandardBlock> Allocator::DescribeMediumHeap() const {
+    return m_MediumHeap.DescribeBlocks();
+}
+
+const BuddyAllocator& Allocator::GetPageHeap() const {
+    return m_PageHeap;
+}
+
+const SlabArena& Allocator::GetSlabArena() const {
+    return m_SlabArena;
+}
+
+const PerCpuCache* Allocator::GetPerCpuCache() const {
+    return m_CpuCache.get();
+}
+
+void Allocator::SetLatencyTracking(bool enable) {
+    m_LatencyRecorder.SetEnabled(enable);
+}
+
+bool Allocator::IsLatencyTrackingEnabled() const {
+    return m_LatencyRecorder.IsEnabled();
+}
+
+LatencyHistogram Allocator::GetLatencyHistogram(LatencyOperation operation, AllocationPath path) const {
+    return m_LatencyRecorder.GetHistogram(operation, path);
+}
+
+double Allocator::GetLatencyPercentile(LatencyOperation operation, AllocationPath path, double percentile) const {
+    return m_LatencyRecorder.GetPercentile(operation, path, percentile);
+}
+
+void Allocator::ResetLatencyHistograms() {
+    m_LatencyRecorder.Reset();
+}
+
+std::size_t* Allocator::FindAllocation(void* ptr) {
+    std::size_t poolIndex;
+    if (const MemoryPool* pool = FindUntrackedPool(ptr, poolIndex)) {
+        return pool->IsAllocated(ptr) ? &m_PoolBlockRecords[poolIndex][pool->GetBlockIndex(ptr)].size : nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_AllocationMutex);
+    AllocationInfo* tracked = m_AllocationTracker.find(ptr);
+    return tracked != nullptr ? &tracked->size : nullptr;
 }
 
 std::size_t Allocator::GetAllocationCount() const {
+    std::size_t count = 0;
+    ForEachUntrackedBlock([&count](std::size_t, void*, const PoolBlockRecord&) { ++count; });
     std::lock_guard<std::mutex> lock(m_AllocationMutex);
-    return m_AllocationTracker.size();
+    return count + m_AllocationTracker.size();
 }
 
 bool Allocator::IsEmpty() const {
-    std::lock_guard<std::mutex> lock(m_AllocationMutex);
-    return m_AllocationTracker.empty();
+    return GetAllocationCount() == 0;
 }
 
 void Allocator::ClearAllocationMap() {
     std::lock_guard<std::mutex> lock(m_AllocationMutex);
+    // Untracked pool blocks are forgotten by marking them free; like
+    // tracked ones, they are not reused before the pools are cleared.
+    ForEachUntrackedBlock([this](std::size_t poolIndex, void* block, const PoolBlockRecord& record) {
+        MemoryTags::Release(record.tag, record.size);
+        m_PoolTable[poolIndex].load(std::memory_order_acquire)->MarkFree(block);
+    });
+    m_AllocationTracker.forEach([](void*, const AllocationInfo& info) { MemoryTags::Release(info.tag, info.size); });
     m_AllocationTracker.clear();
     m_AllocationMap.clear();
-    m_DeallocatedPointers.clear();
     AllocityThread::ClearThreadLocalStorage();
 }
 
 void Allocator::ClearSmallObjectFreeLists() {
     m_DefaultAllocator.ClearSmallObjectFreeLists();
     std::lock_guard<std::mutex> lock(m_AllocationMutex);
-    m_DeallocatedPointers.clear();
     AllocityThread::ClearThreadLocalStorage();
+    std::lock_guard<std::mutex> poolLock(m_PoolCreationMutex);
+    if (m_CpuCache != nullptr) {
+        m_CpuCache->Clear();
+    }
     for (auto& pool : m_MemoryPools) {
         pool->Clear();
     }
@@ -269,7 +972,12 @@ void Allocator::SetDebugMode(bool enable) {
 }
 
 void Allocator::FinalCleanup() {
-    m_StopThreads = true;
+    {
+        // Under the queue lock, so no work is queued after the workers
+        // have checked the queue for the last time.
+        std::lock_guard<std::mutex> lock(m_ThreadPoolMutex);
+        m_StopThreads = true;
+    }
     m_ThreadPoolCondition.notify_all();
     for (auto& thread : m_ThreadPool) {
         if (thread.joinable()) {
@@ -281,19 +989,52 @@ void Allocator::FinalCleanup() {
     m_DefaultAllocator.ClearSmallObjectFreeLists();
 }
 
-void Allocator::TrackAllocation(void* ptr, std::size_t size, bool isPoolAllocation) {
-    m_AllocationTracker[ptr] = {size, isPoolAllocation};
+MemoryPool* Allocator::FindUntrackedPool(const void* ptr, std::size_t& poolIndex) const {
+    if (m_CpuCache == nullptr) {
+        return nullptr;
+    }
+    for (poolIndex = 0; poolIndex < NUM_MEMORY_POOLS; ++poolIndex) {
+        MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool != nullptr && pool->Owns(ptr)) {
+            return pool;
+        }
+    }
+    return nullptr;
+}
+
+void Allocator::ForEachUntrackedBlock(const std::function<void(std::size_t, void*, const PoolBlockRecord&)>& visit) const {
+    if (m_CpuCache == nullptr) {
+        return;
+    }
+    for (std::size_t poolIndex = 0; poolIndex < NUM_MEMORY_POOLS; ++poolIndex) {
+        const MemoryPool* pool = m_PoolTable[poolIndex].load(std::memory_order_acquire);
+        if (pool == nullptr) {
+            continue;
+        }
+        const std::size_t frontier = pool->GetFrontier();
+        const SlabBitmap& allocated = pool->GetAllocationBitmap();
+        for (std::size_t block = allocated.FindFirstSet(); block < frontier; block = allocated.FindFirstSet(block + 1)) {
+            visit(poolIndex, static_cast<char*>(pool->GetMemory()) + block * pool->GetBlockSize(),
+                  m_PoolBlockRecords[poolIndex][block]);
+        }
+    }
+}
+
+void Allocator::TrackAllocation(void* ptr, std::size_t size, AllocationPath path, MemoryTag tag) {
+    m_AllocationTracker.insert(ptr, {size, path, tag});
+    if (m_Config.Tracking == TrackingLevel::Minimal) {
+        return;
+    }
     m_AllocationMap.insert(ptr, size);
-    m_DeallocatedPointers.erase(ptr);
     AllocityThread::GetRecentAllocations()[ptr] = size;
-    AllocityThread::GetRecentDeallocations().erase(ptr);
 }
 
 void Allocator::UntrackAllocation(void* ptr) {
-    m_AllocationTracker.erase(ptr);
+    m_AllocationTracker.remove(ptr);
+    if (m_Config.Tracking == TrackingLevel::Minimal) {
+        return;
+    }
     m_AllocationMap.remove(ptr);
-    m_DeallocatedPointers.insert(ptr);
-    AllocityThread::GetRecentDeallocations().insert(ptr);
     AllocityThread::GetRecentAllocations().erase(ptr);
 }
 
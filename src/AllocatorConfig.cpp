@@ -0,0 +1,147 @@
+#include "../include/AllocatorConfig.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace allocity {
+
+namespace {
+
+std::string Trim(const std::string& text) {
+    std::size_t begin = 0;
+    std::size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) --end;
+    return text.substr(begin, end - begin);
+}
+
+std::size_t ParseSize(const std::string& key, const std::string& value) {
+    std::size_t consumed = 0;
+    unsigned long long parsed = 0;
+    try {
+        parsed = std::stoull(value, &consumed);
+    } catch (const std::exception&) {
+        consumed = 0;
+    }
+    if (consumed == 0 || consumed != value.size() || value[0] == '-') {
+        throw std::invalid_argument("Invalid value for allocator setting '" + key + "': " + value);
+    }
+    return static_cast<std::size_t>(parsed);
+}
+
+bool ParseBool(const std::string& key, const std::string& value) {
+    if (value == "1" || value == "true" || value == "on" || value == "yes") return true;
+    if (value == "0" || value == "false" || value == "off" || value == "no") return false;
+    throw std::invalid_argument("Invalid value for allocator setting '" + key + "': " + value);
+}
+
+}
+
+const char* ToString(TrackingLevel level) {
+    switch (level) {
+        case TrackingLevel::Minimal: return "minimal";
+        case TrackingLevel::Full: return "full";
+        default: return "unknown";
+    }
+}
+
+AllocatorConfig AllocatorConfig::FromString(const std::string& settings) {
+    AllocatorConfig config;
+    config.Apply(settings);
+    return config;
+}
+
+AllocatorConfig AllocatorConfig::FromEnvironment() {
+    AllocatorConfig config;
+    if (const char* settings = std::getenv(ENVIRONMENT_VARIABLE)) {
+        config.Apply(settings);
+    }
+    return config;
+}
+
+void AllocatorConfig::Apply(const std::string& settings) {
+    std::stringstream stream(settings);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        entry = Trim(entry);
+        if (entry.empty()) continue;
+
+        const std::size_t separator = entry.find('=');
+        if (separator == std::string::npos) {
+            throw std::invalid_argument("Allocator setting is not key=value: " + entry);
+        }
+        const std::string key = Trim(entry.substr(0, separator));
+        const std::string value = Trim(entry.substr(separator + 1));
+
+        if (key == "workers") {
+            WorkerThreads = value == "auto" ? AUTO_WORKER_THREADS : ParseSize(key, value);
+        } else if (key == "lazy") {
+            LazyInitialization = ParseBool(key, value);
+        } else if (key == "max_small") {
+            MaxSmallObjectSize = ParseSize(key, value);
+        } else if (key == "max_medium") {
+            MaxMediumObjectSize = ParseSize(key, value);
+        } else if (key == "pool_blocks") {
+            PoolBlocks = ParseSize(key, value);
+        } else if (key == "huge_slabs") {
+            HugePageSlabs = ParseBool(key, value);
+        } else if (key == "percpu") {
+            PerCpuCaches = ParseBool(key, value);
+        } else if (key == "parallel_threshold") {
+            ParallelThreshold = ParseSize(key, value);
+        } else if (key == "tracking") {
+            if (value == "minimal") {
+                Tracking = TrackingLevel::Minimal;
+            } else if (value == "full") {
+                Tracking = TrackingLevel::Full;
+            } else {
+                throw std::invalid_argument("Invalid value for allocator setting 'tracking': " + value);
+            }
+        } else {
+            throw std::invalid_argument("Unknown allocator setting: " + key);
+        }
+    }
+    Validate();
+}
+
+std::size_t AllocatorConfig::ResolveWorkerThreads() const {
+    if (WorkerThreads != AUTO_WORKER_THREADS) {
+        return WorkerThreads;
+    }
+    return std::thread::hardware_concurrency();
+}
+
+void AllocatorConfig::Validate() const {
+    if (MaxSmallObjectSize > MAX_SMALL_OBJECT_LIMIT || MaxSmallObjectSize % SIZE_CLASS_GRANULARITY != 0) {
+        throw std::invalid_argument("MaxSmallObjectSize must be a multiple of 8 no larger than 256");
+    }
+    if (MaxMediumObjectSize < MaxSmallObjectSize) {
+        throw std::invalid_argument("MaxMediumObjectSize must not be smaller than MaxSmallObjectSize");
+    }
+    if (MaxSmallObjectSize != 0 && PoolBlocks == 0) {
+        throw std::invalid_argument("PoolBlocks must be non-zero when size-class pools are enabled");
+    }
+}
+
+std::string AllocatorConfig::ToString() const {
+    std::ostringstream out;
+    out << "workers=";
+    if (WorkerThreads == AUTO_WORKER_THREADS) {
+        out << "auto";
+    } else {
+        out << WorkerThreads;
+    }
+    out << ",lazy=" << (LazyInitialization ? 1 : 0)
+        << ",max_small=" << MaxSmallObjectSize
+        << ",max_medium=" << MaxMediumObjectSize
+        << ",pool_blocks=" << PoolBlocks
+        << ",huge_slabs=" << (HugePageSlabs ? 1 : 0)
+        << ",percpu=" << (PerCpuCaches ? 1 : 0)
+        << ",tracking=" << allocity::ToString(Tracking)
+        << ",parallel_threshold=" << ParallelThreshold;
+    return out.str();
+}
+
+}
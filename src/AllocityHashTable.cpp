@@ -1,84 +1,64 @@
 #include "../include/AllocityHashtable.hpp"
-#include <algorithm>
+#include "../include/VirtualMemory.hpp"
 #include <cstdint>
 
 namespace allocity {
 
-AllocityHashtable::AllocityHashtable(std::size_t initialCapacity)
-    : m_entries(initialCapacity), m_size(0), m_capacity(initialCapacity) {}
+namespace {
 
-AllocityHashtable::~AllocityHashtable() = default;
+// Migrated old slots are returned to the OS in steps of this size, so
+// only one operation in a few hundred pays for an madvise.
+constexpr std::size_t DECOMMIT_BATCH_BYTES = 64 * 1024;
 
-void AllocityHashtable::insert(void* key, std::size_t value) {
-    if (m_size >= m_capacity * 0.75) {
-        rehash();
-    }
+}
 
-    std::size_t index = hash(key) & (m_capacity - 1);
-    while (m_entries[index].occupied && m_entries[index].key != key) {
-        index = (index + 1) & (m_capacity - 1);
+std::size_t AllocityHashtableBase::roundUpToPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
     }
+    return result;
+}
 
-    if (!m_entries[index].occupied) {
-        ++m_size;
-    }
+std::size_t AllocityHashtableBase::tableBytes(std::size_t entryBytes, std::size_t capacity) {
+    return AlignUp(capacity * entryBytes, VirtualMemory::PageSize());
+}
 
-    m_entries[index] = {key, value, true};
+void* AllocityHashtableBase::mapTable(std::size_t bytes) {
+    void* table = VirtualMemory::Reserve(bytes);
+    VirtualMemory::Commit(table, bytes);
+    return table;
 }
 
-bool AllocityHashtable::remove(void* key) {
-    std::size_t index = hash(key) & (m_capacity - 1);
-    while (m_entries[index].occupied) {
-        if (m_entries[index].key == key) {
-            m_entries[index].occupied = false;
-            --m_size;
-            return true;
-        }
-        index = (index + 1) & (m_capacity - 1);
-    }
-    return false;
+void AllocityHashtableBase::unmapTable(void* table, std::size_t bytes) {
+    VirtualMemory::Release(table, bytes);
 }
 
-std::size_t* AllocityHashtable::find(void* key) {
-    std::size_t index = hash(key) & (m_capacity - 1);
-    while (m_entries[index].occupied) {
-        if (m_entries[index].key == key) {
-            return &m_entries[index].value;
-        }
-        index = (index + 1) & (m_capacity - 1);
-    }
-    return nullptr;
+void AllocityHashtableBase::zeroTable(void* table, std::size_t bytes) {
+    VirtualMemory::Decommit(table, bytes);
+    VirtualMemory::Commit(table, bytes);
 }
 
-void AllocityHashtable::clear() {
-    std::fill(m_entries.begin(), m_entries.end(), Entry{nullptr, 0, false});
-    m_size = 0;
+std::size_t AllocityHashtableBase::decommitMigrated(void* table, std::size_t migratedBytes, std::size_t decommittedBytes) {
+    const std::size_t pageSize = VirtualMemory::PageSize();
+    migratedBytes = migratedBytes / pageSize * pageSize;
+    if (migratedBytes < decommittedBytes + DECOMMIT_BATCH_BYTES) {
+        return decommittedBytes;
+    }
+    VirtualMemory::Decommit(static_cast<char*>(table) + decommittedBytes, migratedBytes - decommittedBytes);
+    return migratedBytes;
 }
 
-std::size_t AllocityHashtable::hash(void* key) {
-    
+std::size_t AllocityHashtableBase::hash(void* key) {
+
     std::uint64_t h = 14695981039346656037ULL;
     std::uintptr_t k = reinterpret_cast<std::uintptr_t>(key);
     for (std::size_t i = 0; i < sizeof(void*); ++i) {
         h ^= (k >> (i * 8)) & 0xFF;
         h *= 1099511628211ULL;
     }
-    
+
     return static_cast<std::size_t>((h >> 32) ^ h);
 }
 
-
-void AllocityHashtable::rehash() {
-    m_capacity *= 2;
-    std::vector<Entry> oldEntries = std::move(m_entries);
-    m_entries.resize(m_capacity);
-    m_size = 0;
-
-    for (const auto& entry : oldEntries) {
-        if (entry.occupied) {
-            insert(entry.key, entry.value);
-        }
-    }
 }
-
-} 
\ No newline at end of file
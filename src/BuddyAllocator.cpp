@@ -0,0 +1,336 @@
+#include "../include/BuddyAllocator.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <iomanip>
+#include <new>
+#include <stdexcept>
+
+namespace allocity {
+
+namespace {
+
+bool IsPowerOfTwo(std::size_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+std::size_t Log2(std::size_t value) {
+    std::size_t log = 0;
+    while ((std::size_t(1) << log) < value) {
+        ++log;
+    }
+    return log;
+}
+
+int FindFirstSet(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int bit = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+}
+
+BuddyAllocator::OrderBitmap::OrderBitmap(std::size_t bits)
+    : m_words((bits + 63) / 64, 0), m_summary((m_words.size() + 63) / 64, 0), m_count(0) {}
+
+void BuddyAllocator::OrderBitmap::Set(std::size_t index) {
+    const std::size_t word = index / 64;
+    m_words[word] |= std::uint64_t(1) << (index % 64);
+    m_summary[word / 64] |= std::uint64_t(1) << (word % 64);
+    ++m_count;
+}
+
+void BuddyAllocator::OrderBitmap::Clear(std::size_t index) {
+    const std::size_t word = index / 64;
+    m_words[word] &= ~(std::uint64_t(1) << (index % 64));
+    if (m_words[word] == 0) {
+        m_summary[word / 64] &= ~(std::uint64_t(1) << (word % 64));
+    }
+    --m_count;
+}
+
+bool BuddyAllocator::OrderBitmap::FindFirst(std::size_t& index) const {
+    if (m_count == 0) {
+        return false;
+    }
+    for (std::size_t i = 0; i < m_summary.size(); ++i) {
+        if (m_summary[i] != 0) {
+            const std::size_t word = i * 64 + static_cast<std::size_t>(FindFirstSet(m_summary[i]));
+            index = word * 64 + static_cast<std::size_t>(FindFirstSet(m_words[word]));
+            return true;
+        }
+    }
+    return false;
+}
+
+BuddyAllocator::BuddyAllocator(std::size_t regionSize, std::size_t minBlockSize, std::size_t maxBlockSize)
+    : m_regionSize(regionSize),
+      m_minBlockSize(minBlockSize),
+      m_maxOrder(0),
+      m_decommitThreshold(DEFAULT_DECOMMIT_THRESHOLD),
+      m_usedBytes(0) {
+    if (!IsPowerOfTwo(minBlockSize) || !IsPowerOfTwo(maxBlockSize) || maxBlockSize < minBlockSize) {
+        throw std::invalid_argument("Buddy block sizes must be powers of two with min <= max");
+    }
+    if (minBlockSize % VirtualMemory::PageSize() != 0) {
+        throw std::invalid_argument("Buddy minimum block size must be a multiple of the page size");
+    }
+    if (regionSize == 0 || regionSize % maxBlockSize != 0) {
+        throw std::invalid_argument("Buddy region size must be a non-zero multiple of the maximum block size");
+    }
+    m_maxOrder = Log2(maxBlockSize / minBlockSize);
+    if (m_maxOrder >= NOT_ALLOCATED) {
+        throw std::invalid_argument("Too many buddy orders");
+    }
+}
+
+BuddyAllocator::~BuddyAllocator() {
+    for (const auto& region : m_regions) {
+        VirtualMemory::Release(region->base, m_regionSize);
+    }
+}
+
+std::size_t BuddyAllocator::OrderFor(std::size_t size) const {
+    return Log2((size + m_minBlockSize - 1) / m_minBlockSize);
+}
+
+std::size_t BuddyAllocator::RoundUp(std::size_t size) const {
+    return m_minBlockSize << OrderFor(size == 0 ? 1 : size);
+}
+
+BuddyAllocator::Region* BuddyAllocator::AddRegion() {
+    const std::size_t maxBlockSize = GetMaxBlockSize();
+    auto region = std::make_unique<Region>();
+    region->base = static_cast<char*>(VirtualMemory::ReserveAligned(m_regionSize, maxBlockSize));
+    region->allocatedOrder.assign(m_regionSize / m_minBlockSize, NOT_ALLOCATED);
+    region->freeBlocks.reserve(m_maxOrder + 1);
+    for (std::size_t order = 0; order <= m_maxOrder; ++order) {
+        region->freeBlocks.emplace_back(m_regionSize / (m_minBlockSize << order));
+    }
+    for (std::size_t i = 0; i < m_regionSize / maxBlockSize; ++i) {
+        region->freeBlocks[m_maxOrder].Set(i);
+    }
+
+    Region* result = region.get();
+    m_regionIndex.emplace(result->base, result);
+    m_regions.push_back(std::move(region));
+    return result;
+}
+
+BuddyAllocator::Region* BuddyAllocator::FindRegion(const char* ptr) const {
+    auto it = m_regionIndex.upper_bound(ptr);
+    if (it == m_regionIndex.begin()) {
+        return nullptr;
+    }
+    --it;
+    return ptr < it->first + m_regionSize ? it->second : nullptr;
+}
+
+void* BuddyAllocator::AllocateFrom(Region& region, std::size_t order) {
+    std::size_t current = order;
+    std::size_t index = 0;
+    while (current <= m_maxOrder && !region.freeBlocks[current].FindFirst(index)) {
+        ++current;
+    }
+    if (current > m_maxOrder) {
+        return nullptr;
+    }
+
+    region.freeBlocks[current].Clear(index);
+    while (current > order) {
+        --current;
+        index *= 2;
+        region.freeBlocks[current].Set(index + 1);
+    }
+
+    const std::size_t blockSize = m_minBlockSize << order;
+    region.allocatedOrder[index << order] = static_cast<std::uint8_t>(order);
+    m_usedBytes += blockSize;
+
+    char* block = region.base + index * blockSize;
+    VirtualMemory::Commit(block, blockSize);
+    return block;
+}
+
+void* BuddyAllocator::Allocate(std::size_t size) {
+    if (size == 0 || size > GetMaxBlockSize()) {
+        return nullptr;
+    }
+    const std::size_t order = OrderFor(size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& region : m_regions) {
+        if (void* block = AllocateFrom(*region, order)) {
+            return block;
+        }
+    }
+    try {
+        return AllocateFrom(*AddRegion(), order);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void BuddyAllocator::Deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Region* region = FindRegion(static_cast<const char*>(ptr));
+    if (region == nullptr) {
+        throw std::invalid_argument("Pointer does not belong to this buddy allocator");
+    }
+    const std::size_t offset = static_cast<std::size_t>(static_cast<char*>(ptr) - region->base);
+    const std::size_t minIndex = offset / m_minBlockSize;
+    if (offset % m_minBlockSize != 0 || region->allocatedOrder[minIndex] == NOT_ALLOCATED) {
+        throw std::runtime_error("Double free or invalid pointer in buddy allocator");
+    }
+
+    std::size_t order = region->allocatedOrder[minIndex];
+    region->allocatedOrder[minIndex] = NOT_ALLOCATED;
+    m_usedBytes -= m_minBlockSize << order;
+
+    std::size_t index = minIndex >> order;
+    while (order < m_maxOrder && region->freeBlocks[order].Test(index ^ 1)) {
+        region->freeBlocks[order].Clear(index ^ 1);
+        index >>= 1;
+        ++order;
+    }
+    region->freeBlocks[order].Set(index);
+
+    const std::size_t blockSize = m_minBlockSize << order;
+    if (blockSize >= m_decommitThreshold) {
+        VirtualMemory::Decommit(region->base + index * blockSize, blockSize);
+    }
+}
+
+bool BuddyAllocator::Owns(const void* ptr) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return FindRegion(static_cast<const char*>(ptr)) != nullptr;
+}
+
+std::size_t BuddyAllocator::GetBlockSize(const void* ptr) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Region* region = FindRegion(static_cast<const char*>(ptr));
+    if (region == nullptr) {
+        return 0;
+    }
+    const std::size_t offset = static_cast<std::size_t>(static_cast<const char*>(ptr) - region->base);
+    const std::uint8_t order = region->allocatedOrder[offset / m_minBlockSize];
+    return order == NOT_ALLOCATED ? 0 : m_minBlockSize << order;
+}
+
+void BuddyAllocator::SetDecommitThreshold(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_decommitThreshold = bytes;
+}
+
+std::size_t BuddyAllocator::GetRegionCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_regions.size();
+}
+
+std::size_t BuddyAllocator::GetReservedBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_regions.size() * m_regionSize;
+}
+
+std::size_t BuddyAllocator::GetUsedBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usedBytes;
+}
+
+std::size_t BuddyAllocator::GetFreeBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_regions.size() * m_regionSize - m_usedBytes;
+}
+
+bool BuddyAllocator::LargestFreeOrder(std::size_t& order) const {
+    for (std::size_t current = m_maxOrder + 1; current-- > 0;) {
+        for (const auto& region : m_regions) {
+            if (region->freeBlocks[current].GetCount() != 0) {
+                order = current;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::size_t BuddyAllocator::GetLargestFreeBlock() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::size_t order = 0;
+    return LargestFreeOrder(order) ? m_minBlockSize << order : 0;
+}
+
+std::vector<std::size_t> BuddyAllocator::GetFreeBlockCounts() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::size_t> counts(m_maxOrder + 1, 0);
+    for (const auto& region : m_regions) {
+        for (std::size_t order = 0; order <= m_maxOrder; ++order) {
+            counts[order] += region->freeBlocks[order].GetCount();
+        }
+    }
+    return counts;
+}
+
+// Share of free memory that is split below the maximum block size: 0 when
+// every free byte could still serve a maximum-size request, approaching 1
+// as the free space splinters into small buddies.
+double BuddyAllocator::GetExternalFragmentation() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::size_t freeBytes = m_regions.size() * m_regionSize - m_usedBytes;
+    if (freeBytes == 0) {
+        return 0.0;
+    }
+    std::size_t maxOrderBytes = 0;
+    for (const auto& region : m_regions) {
+        maxOrderBytes += region->freeBlocks[m_maxOrder].GetCount() * GetMaxBlockSize();
+    }
+    return 1.0 - static_cast<double>(maxOrderBytes) / static_cast<double>(freeBytes);
+}
+
+void BuddyAllocator::ForEachSpan(const SpanVisitor& visit) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::size_t minBlocks = m_regionSize / m_minBlockSize;
+    for (const auto& region : m_regions) {
+        std::size_t index = 0;
+        while (index < minBlocks) {
+            const std::uint8_t allocated = region->allocatedOrder[index];
+            if (allocated != NOT_ALLOCATED) {
+                visit(region->base + index * m_minBlockSize, m_minBlockSize << allocated, false);
+                index += std::size_t(1) << allocated;
+                continue;
+            }
+            // A free block starts here at exactly one order; look from the
+            // largest the index is aligned for.
+            std::size_t order = m_maxOrder;
+            while (order > 0 && (index & ((std::size_t(1) << order) - 1)) != 0) {
+                --order;
+            }
+            while (order > 0 && !region->freeBlocks[order].Test(index >> order)) {
+                --order;
+            }
+            visit(region->base + index * m_minBlockSize, m_minBlockSize << order, true);
+            index += std::size_t(1) << order;
+        }
+    }
+}
+
+void BuddyAllocator::ReportFragmentation(std::ostream& out) const {
+    const std::vector<std::size_t> counts = GetFreeBlockCounts();
+    out << "Buddy heap: " << GetRegionCount() << " region(s), " << GetUsedBytes() << " of "
+        << GetReservedBytes() << " bytes used, external fragmentation "
+        << std::fixed << std::setprecision(3) << GetExternalFragmentation() << std::defaultfloat << std::endl;
+    out << "  free blocks per order:";
+    for (std::size_t order = 0; order < counts.size(); ++order) {
+        out << ' ' << (m_minBlockSize << order) / 1024 << "K:" << counts[order];
+    }
+    out << std::endl;
+}
+
+}
@@ -0,0 +1,102 @@
+#include "../include/BulkMemory.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ALLOCITY_HAS_STREAMING_STORES 1
+#else
+    #define ALLOCITY_HAS_STREAMING_STORES 0
+#endif
+
+namespace allocity {
+
+namespace {
+
+#if ALLOCITY_HAS_STREAMING_STORES
+
+constexpr std::size_t VECTOR_SIZE = sizeof(__m128i);
+constexpr std::size_t STREAM_BLOCK = 4 * VECTOR_SIZE;
+
+std::size_t BytesToAlignment(const void* address) {
+    return (VECTOR_SIZE - reinterpret_cast<std::uintptr_t>(address) % VECTOR_SIZE) % VECTOR_SIZE;
+}
+
+void StreamFill(char* destination, unsigned char value, std::size_t size) {
+    const std::size_t head = BytesToAlignment(destination);
+    std::memset(destination, value, head);
+    destination += head;
+    size -= head;
+
+    const __m128i pattern = _mm_set1_epi8(static_cast<char>(value));
+    char* const end = destination + size / STREAM_BLOCK * STREAM_BLOCK;
+    for (; destination != end; destination += STREAM_BLOCK) {
+        __m128i* out = reinterpret_cast<__m128i*>(destination);
+        _mm_stream_si128(out, pattern);
+        _mm_stream_si128(out + 1, pattern);
+        _mm_stream_si128(out + 2, pattern);
+        _mm_stream_si128(out + 3, pattern);
+    }
+    std::memset(destination, value, size % STREAM_BLOCK);
+    _mm_sfence();
+}
+
+#if !defined(__GLIBC__)
+
+void StreamCopy(char* destination, const char* source, std::size_t size) {
+    const std::size_t head = BytesToAlignment(destination);
+    std::memcpy(destination, source, head);
+    destination += head;
+    source += head;
+    size -= head;
+
+    char* const end = destination + size / STREAM_BLOCK * STREAM_BLOCK;
+    for (; destination != end; destination += STREAM_BLOCK, source += STREAM_BLOCK) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(source);
+        __m128i* out = reinterpret_cast<__m128i*>(destination);
+        const __m128i a = _mm_loadu_si128(in);
+        const __m128i b = _mm_loadu_si128(in + 1);
+        const __m128i c = _mm_loadu_si128(in + 2);
+        const __m128i d = _mm_loadu_si128(in + 3);
+        _mm_stream_si128(out, a);
+        _mm_stream_si128(out + 1, b);
+        _mm_stream_si128(out + 2, c);
+        _mm_stream_si128(out + 3, d);
+    }
+    std::memcpy(destination, source, size % STREAM_BLOCK);
+    _mm_sfence();
+}
+
+#endif
+
+#endif
+
+}
+
+void BulkMemory::Fill(void* destination, unsigned char value, std::size_t size) {
+#if ALLOCITY_HAS_STREAMING_STORES
+    if (size >= NON_TEMPORAL_THRESHOLD) {
+        StreamFill(static_cast<char*>(destination), value, size);
+        return;
+    }
+#endif
+    std::memset(destination, value, size);
+}
+
+void BulkMemory::Copy(void* destination, const void* source, std::size_t size) {
+    // glibc's memcpy already switches to streaming stores for copies larger
+    // than the cache, with wider vectors than the SSE2 kernel here.
+#if ALLOCITY_HAS_STREAMING_STORES && !defined(__GLIBC__)
+    if (size >= NON_TEMPORAL_THRESHOLD) {
+        StreamCopy(static_cast<char*>(destination), static_cast<const char*>(source), size);
+        return;
+    }
+#endif
+    std::memcpy(destination, source, size);
+}
+
+bool BulkMemory::HasNonTemporalStores() {
+    return ALLOCITY_HAS_STREAMING_STORES != 0;
+}
+
+}
@@ -1,4 +1,5 @@
 #include "../include/DefaultAllocator.hpp"
+#include "../include/Log.hpp"
 #include <cstdlib>
 #include <new>
 #include <iostream>
@@ -28,7 +29,6 @@ DefaultAllocator::DefaultAllocator(const DefaultAllocator& other)
       OutOfMemoryHandler(other.OutOfMemoryHandler),
       MemoryUsageReporter(other.MemoryUsageReporter),
       m_EnableDoubleFreeCheck(other.m_EnableDoubleFreeCheck),
-      m_FreedPointers(other.m_FreedPointers),
       m_AllocatedPointers(other.m_AllocatedPointers) {
     for (size_t i = 0; i < SMALL_OBJECT_THRESHOLD; ++i) {
         smallObjectFreeLists[i].store(other.smallObjectFreeLists[i].load());
@@ -46,7 +46,6 @@ DefaultAllocator::DefaultAllocator(DefaultAllocator&& other) noexcept
       OutOfMemoryHandler(std::move(other.OutOfMemoryHandler)),
       MemoryUsageReporter(std::move(other.MemoryUsageReporter)),
       m_EnableDoubleFreeCheck(other.m_EnableDoubleFreeCheck),
-      m_FreedPointers(std::move(other.m_FreedPointers)),
       m_AllocatedPointers(std::move(other.m_AllocatedPointers)) {
     for (size_t i = 0; i < SMALL_OBJECT_THRESHOLD; ++i) {
         smallObjectFreeLists[i].store(other.smallObjectFreeLists[i].load());
@@ -62,7 +61,6 @@ DefaultAllocator& DefaultAllocator::operator=(const DefaultAllocator& other) {
         OutOfMemoryHandler = other.OutOfMemoryHandler;
         MemoryUsageReporter = other.MemoryUsageReporter;
         m_EnableDoubleFreeCheck = other.m_EnableDoubleFreeCheck;
-        m_FreedPointers = other.m_FreedPointers;
         m_AllocatedPointers = other.m_AllocatedPointers;
         for (size_t i = 0; i < SMALL_OBJECT_THRESHOLD; ++i) {
             smallObjectFreeLists[i].store(other.smallObjectFreeLists[i].load());
@@ -85,7 +83,6 @@ DefaultAllocator& DefaultAllocator::operator=(DefaultAllocator&& other) noexcept
         OutOfMemoryHandler = std::move(other.OutOfMemoryHandler);
         MemoryUsageReporter = std::move(other.MemoryUsageReporter);
         m_EnableDoubleFreeCheck = other.m_EnableDoubleFreeCheck;
-        m_FreedPointers = std::move(other.m_FreedPointers);
         m_AllocatedPointers = std::move(other.m_AllocatedPointers);
         for (size_t i = 0; i < SMALL_OBJECT_THRESHOLD; ++i) {
             smallObjectFreeLists[i].store(other.smallObjectFreeLists[i].load());
@@ -103,7 +100,7 @@ void DefaultAllocator::Initialize() {
     }
 
     OutOfMemoryHandler = [](std::size_t size) {
-        std::cerr << "Out of memory! Failed to allocate " << size << " bytes." << std::endl;
+        ALLOCITY_LOG_ERROR("Out of memory! Failed to allocate {} bytes", size);
     };
 
     MemoryUsageReporter = [](const DefaultAllocator& allocator) {
@@ -226,16 +223,10 @@ void DefaultAllocator::ClearSmallObjectFreeLists() {
         }
     }
     TotalFreed.store(TotalAllocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
-    if (m_EnableDoubleFreeCheck) {
-        m_FreedPointers.clear();
-    }
 }
 
 void DefaultAllocator::SetEnableDoubleFreeCheck(bool enable) {
     m_EnableDoubleFreeCheck = enable;
-    if (!enable) {
-        m_FreedPointers.clear();
-    }
 }
 
 void DefaultAllocator::SetOutOfMemoryHandler(std::function<void(std::size_t)> handler) {
@@ -0,0 +1,167 @@
+#include "../include/EpochDomain.hpp"
+#include "../include/Allocator.hpp"
+#include "../include/Log.hpp"
+#include "../include/ScratchStack.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace allocity {
+
+namespace {
+
+std::atomic<std::uint64_t> g_nextDomainId{1};
+
+}
+
+thread_local EpochDomain::RecordCache EpochDomain::t_recordCache{0, nullptr};
+
+EpochDomain::EpochDomain(Allocator& allocator, std::size_t retireBatch)
+    : m_allocator(allocator),
+      m_retireBatch(std::max<std::size_t>(retireBatch, 1)),
+      m_id(g_nextDomainId.fetch_add(1, std::memory_order_relaxed)),
+      m_epoch(0),
+      m_reclaimed(std::make_shared<std::atomic<std::uint64_t>>(0)) {}
+
+EpochDomain::~EpochDomain() {
+    std::lock_guard<std::mutex> lock(m_recordsMutex);
+    for (auto& record : m_records) {
+        Free(m_allocator, record->retired);
+    }
+}
+
+EpochDomain::ThreadRecord& EpochDomain::RegisterThread() {
+    std::lock_guard<std::mutex> lock(m_recordsMutex);
+    ThreadRecord*& record = m_threadRecords[std::this_thread::get_id()];
+    if (record == nullptr) {
+        m_records.push_back(std::make_unique<ThreadRecord>());
+        record = m_records.back().get();
+        record->collectAt = m_retireBatch;
+        record->retired.reserve(m_retireBatch);
+    }
+    return *record;
+}
+
+void EpochDomain::Enter() {
+    ThreadRecord& record = GetThreadRecord();
+    if (record.nesting++ == 0) {
+        record.state.store((m_epoch.load(std::memory_order_relaxed) << 1) | PINNED, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void EpochDomain::Leave() {
+    ThreadRecord& record = GetThreadRecord();
+    if (--record.nesting == 0) {
+        record.state.store(0, std::memory_order_release);
+    }
+}
+
+bool EpochDomain::TryAdvance() {
+    const std::uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> lock(m_recordsMutex);
+        for (const auto& record : m_records) {
+            const std::uint64_t state = record->state.load(std::memory_order_relaxed);
+            if ((state & PINNED) != 0 && (state >> 1) != epoch) {
+                return false;
+            }
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t expected = epoch;
+    return m_epoch.compare_exchange_strong(expected, epoch + 1, std::memory_order_release, std::memory_order_relaxed) ||
+           expected != epoch;
+}
+
+void EpochDomain::Retire(void* ptr, Destructor destroy) {
+    if (ptr == nullptr) {
+        return;
+    }
+    ThreadRecord& record = GetThreadRecord();
+    record.retired.push_back({ptr, destroy, m_epoch.load(std::memory_order_acquire)});
+    record.pending.store(record.retired.size(), std::memory_order_relaxed);
+    if (record.retired.size() < record.collectAt) {
+        return;
+    }
+
+    TryAdvance();
+    auto batch = std::make_shared<std::vector<Retired>>(TakeSafe(record));
+    record.collectAt = record.retired.size() + m_retireBatch;
+    if (batch->empty()) {
+        return;
+    }
+    Allocator& allocator = m_allocator;
+    auto reclaimed = m_reclaimed;
+    allocator.AddWorkToQueue([&allocator, batch, reclaimed] {
+        const std::size_t count = batch->size();
+        // An invalid batch (a node retired twice, or one the allocator does
+        // not own) is rejected whole; a worker has no caller to throw to.
+        try {
+            Free(allocator, *batch);
+        } catch (const std::exception& e) {
+            ALLOCITY_LOG_ERROR("Dropped a batch of {} retired nodes: {}", count, e.what());
+            return;
+        }
+        reclaimed->fetch_add(count, std::memory_order_relaxed);
+    });
+}
+
+std::vector<EpochDomain::Retired> EpochDomain::TakeSafe(ThreadRecord& record) {
+    // Retired in epoch e: threads pinned in e - 1 may still hold it, and
+    // by the time the global epoch reaches e + 2 none of them can be.
+    const std::uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+    auto unsafe = std::partition(record.retired.begin(), record.retired.end(),
+                                 [epoch](const Retired& retired) { return retired.epoch + 2 <= epoch; });
+    std::vector<Retired> safe(record.retired.begin(), unsafe);
+    record.retired.erase(record.retired.begin(), unsafe);
+    record.pending.store(record.retired.size(), std::memory_order_relaxed);
+    return safe;
+}
+
+void EpochDomain::Free(Allocator& allocator, std::vector<Retired>& batch) {
+    ScratchMarker scratch;
+    void** ptrs = scratch.AllocateArray<void*>(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i].destroy != nullptr) {
+            batch[i].destroy(batch[i].ptr);
+        }
+        ptrs[i] = batch[i].ptr;
+    }
+    allocator.DeallocateBatch(ptrs, batch.size());
+    batch.clear();
+}
+
+std::size_t EpochDomain::Collect() {
+    ThreadRecord& record = GetThreadRecord();
+    TryAdvance();
+    std::vector<Retired> safe = TakeSafe(record);
+    const std::size_t count = safe.size();
+    Free(m_allocator, safe);
+    m_reclaimed->fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+void EpochDomain::Drain() {
+    ThreadRecord& record = GetThreadRecord();
+    while (!record.retired.empty()) {
+        if (Collect() == 0 && !TryAdvance()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::size_t EpochDomain::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_recordsMutex);
+    std::size_t pending = 0;
+    for (const auto& record : m_records) {
+        pending += record->pending.load(std::memory_order_relaxed);
+    }
+    return pending;
+}
+
+std::uint64_t EpochDomain::GetReclaimedCount() const {
+    return m_reclaimed->load(std::memory_order_relaxed);
+}
+
+}
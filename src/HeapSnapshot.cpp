@@ -0,0 +1,390 @@
+#include "../include/HeapSnapshot.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+
+namespace allocity {
+
+namespace {
+
+constexpr char MAGIC[8] = {'A', 'L', 'C', 'Y', 'H', 'E', 'A', 'P'};
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+template <typename T>
+void Put(std::ostream& out, T value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshot fields must be trivially copyable");
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(std::istream& in) {
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshot fields must be trivially copyable");
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Heap snapshot is truncated");
+    }
+    return value;
+}
+
+void PutWords(std::ostream& out, const std::vector<std::uint64_t>& words) {
+    Put<std::uint64_t>(out, words.size());
+    out.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(words[0])));
+}
+
+// Elements are read one at a time, so a corrupt count fails on the
+// truncated stream instead of on a huge allocation.
+std::vector<std::uint64_t> GetWords(std::istream& in) {
+    const std::uint64_t count = Get<std::uint64_t>(in);
+    std::vector<std::uint64_t> words;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        words.push_back(Get<std::uint64_t>(in));
+    }
+    return words;
+}
+
+int CountBits(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word != 0; word &= word - 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+std::uint64_t RoundUpToPages(std::uint64_t bytes, std::uint64_t pageSize) {
+    return (bytes + pageSize - 1) / pageSize * pageSize;
+}
+
+double Percent(std::uint64_t part, std::uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+
+// Share of used bytes that holds no live data.
+double WastePercent(std::uint64_t liveBytes, std::uint64_t usedBytes) {
+    return usedBytes == 0 ? 0.0 : 100.0 - Percent(liveBytes, usedBytes);
+}
+
+const char* ToString(HeapSnapshot::SpanHeap heap) {
+    switch (heap) {
+        case HeapSnapshot::SpanHeap::Page: return "page";
+        case HeapSnapshot::SpanHeap::Medium: return "medium";
+        case HeapSnapshot::SpanHeap::System: return "system";
+    }
+    return "unknown";
+}
+
+constexpr std::size_t OCCUPANCY_BUCKETS = 6;
+const char* const OCCUPANCY_LABELS[OCCUPANCY_BUCKETS] = {"empty", "<=25%", "<=50%", "<=75%", "<100%", "full"};
+
+std::size_t OccupancyBucket(std::uint64_t live, std::uint64_t total) {
+    if (live == 0) return 0;
+    if (live == total) return 5;
+    const std::uint64_t quarters = (4 * live + total - 1) / total;
+    return static_cast<std::size_t>(std::min<std::uint64_t>(quarters, 4));
+}
+
+}
+
+bool HeapSnapshot::Slab::IsLive(std::uint64_t block) const {
+    return block < Frontier && (Occupancy[block / 64] >> (block % 64)) & 1;
+}
+
+bool HeapSnapshot::Slab::IsResident(std::uint64_t page) const {
+    return page / 64 < ResidentPages.size() && (ResidentPages[page / 64] >> (page % 64)) & 1;
+}
+
+std::uint64_t HeapSnapshot::Slab::GetLiveBlocks() const {
+    std::uint64_t blocks = 0;
+    for (std::uint64_t word : Occupancy) {
+        blocks += static_cast<std::uint64_t>(CountBits(word));
+    }
+    return blocks;
+}
+
+std::uint64_t HeapSnapshot::Slab::GetPageCount(std::uint64_t pageSize) const {
+    return (Capacity * BlockSize + pageSize - 1) / pageSize;
+}
+
+void HeapSnapshot::Write(std::ostream& out) const {
+    out.write(MAGIC, sizeof(MAGIC));
+    Put(out, FORMAT_VERSION);
+    Put(out, BYTE_ORDER_MARK);
+    Put(out, PageSize);
+    Put(out, ProcessResidentBytes);
+
+    Put<std::uint64_t>(out, TagNames.size());
+    for (const auto& tag : TagNames) {
+        Put(out, tag.first);
+        Put<std::uint64_t>(out, tag.second.size());
+        out.write(tag.second.data(), static_cast<std::streamsize>(tag.second.size()));
+    }
+
+    Put<std::uint64_t>(out, Slabs.size());
+    for (const Slab& slab : Slabs) {
+        Put(out, slab.Address);
+        Put(out, slab.BlockSize);
+        Put(out, slab.Capacity);
+        Put(out, slab.Frontier);
+        Put(out, slab.PoolUsedBlocks);
+        Put(out, slab.LiveBytes);
+        PutWords(out, slab.Occupancy);
+        PutWords(out, slab.ResidentPages);
+        Put<std::uint64_t>(out, slab.TagBytes.size());
+        for (const auto& tagBytes : slab.TagBytes) {
+            Put(out, tagBytes.first);
+            Put(out, tagBytes.second);
+        }
+    }
+
+    Put<std::uint64_t>(out, Spans.size());
+    for (const Span& span : Spans) {
+        Put(out, static_cast<std::uint8_t>(span.Heap));
+        Put<std::uint8_t>(out, span.Free ? 1 : 0);
+        Put(out, span.Tag);
+        Put(out, span.Address);
+        Put(out, span.Size);
+        Put(out, span.LiveBytes);
+        Put(out, span.ResidentBytes);
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write heap snapshot");
+    }
+}
+
+HeapSnapshot HeapSnapshot::Read(std::istream& in) {
+    char magic[sizeof(MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a heap snapshot");
+    }
+    if (Get<std::uint32_t>(in) != FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported heap snapshot version");
+    }
+    if (Get<std::uint32_t>(in) != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Heap snapshot was written with a different byte order");
+    }
+
+    HeapSnapshot snapshot;
+    snapshot.PageSize = Get<std::uint64_t>(in);
+    snapshot.ProcessResidentBytes = Get<std::uint64_t>(in);
+    if (snapshot.PageSize == 0) {
+        throw std::runtime_error("Heap snapshot has no page size");
+    }
+
+    const std::uint64_t tagCount = Get<std::uint64_t>(in);
+    for (std::uint64_t i = 0; i < tagCount; ++i) {
+        const MemoryTag tag = Get<MemoryTag>(in);
+        std::string name;
+        const std::uint64_t length = Get<std::uint64_t>(in);
+        for (std::uint64_t c = 0; c < length; ++c) {
+            name.push_back(Get<char>(in));
+        }
+        snapshot.TagNames.emplace_back(tag, std::move(name));
+    }
+
+    const std::uint64_t slabCount = Get<std::uint64_t>(in);
+    for (std::uint64_t i = 0; i < slabCount; ++i) {
+        Slab slab;
+        slab.Address = Get<std::uint64_t>(in);
+        slab.BlockSize = Get<std::uint64_t>(in);
+        slab.Capacity = Get<std::uint64_t>(in);
+        slab.Frontier = Get<std::uint64_t>(in);
+        slab.PoolUsedBlocks = Get<std::uint64_t>(in);
+        slab.LiveBytes = Get<std::uint64_t>(in);
+        slab.Occupancy = GetWords(in);
+        slab.ResidentPages = GetWords(in);
+        if (slab.BlockSize == 0 || slab.Frontier > slab.Capacity || slab.Occupancy.size() != (slab.Frontier + 63) / 64) {
+            throw std::runtime_error("Heap snapshot slab geometry is corrupt");
+        }
+        const std::uint64_t tagBytesCount = Get<std::uint64_t>(in);
+        for (std::uint64_t t = 0; t < tagBytesCount; ++t) {
+            const MemoryTag tag = Get<MemoryTag>(in);
+            slab.TagBytes.emplace_back(tag, Get<std::uint64_t>(in));
+        }
+        snapshot.Slabs.push_back(std::move(slab));
+    }
+
+    const std::uint64_t spanCount = Get<std::uint64_t>(in);
+    for (std::uint64_t i = 0; i < spanCount; ++i) {
+        Span span;
+        const std::uint8_t heap = Get<std::uint8_t>(in);
+        if (heap > static_cast<std::uint8_t>(SpanHeap::System)) {
+            throw std::runtime_error("Heap snapshot span is corrupt");
+        }
+        span.Heap = static_cast<SpanHeap>(heap);
+        span.Free = Get<std::uint8_t>(in) != 0;
+        span.Tag = Get<MemoryTag>(in);
+        span.Address = Get<std::uint64_t>(in);
+        span.Size = Get<std::uint64_t>(in);
+        span.LiveBytes = Get<std::uint64_t>(in);
+        span.ResidentBytes = Get<std::uint64_t>(in);
+        snapshot.Spans.push_back(span);
+    }
+    return snapshot;
+}
+
+std::uint64_t HeapSnapshot::GetLiveBytes() const {
+    std::uint64_t bytes = 0;
+    for (const Slab& slab : Slabs) {
+        bytes += slab.LiveBytes;
+    }
+    for (const Span& span : Spans) {
+        bytes += span.LiveBytes;
+    }
+    return bytes;
+}
+
+std::string HeapSnapshot::GetTagName(MemoryTag tag) const {
+    for (const auto& entry : TagNames) {
+        if (entry.first == tag) {
+            return entry.second;
+        }
+    }
+    return "tag " + std::to_string(tag);
+}
+
+void HeapSnapshot::Report(std::ostream& out) const {
+    constexpr std::uint64_t KIB = 1024;
+    std::uint64_t heapResident = 0;
+    std::uint64_t purgeTotal = 0;
+    std::uint64_t compactTotal = 0;
+
+    out << "Size classes:" << std::setw(10) << "live" << std::setw(10) << "touched" << std::setw(11) << "live KiB"
+        << std::setw(11) << "internal" << std::setw(11) << "external" << std::setw(14) << "resident KiB"
+        << std::setw(11) << "purge KiB" << std::setw(13) << "compact KiB" << std::endl;
+    std::vector<std::array<std::uint64_t, OCCUPANCY_BUCKETS>> histograms;
+    for (const Slab& slab : Slabs) {
+        const std::uint64_t liveBlocks = slab.GetLiveBlocks();
+        const std::uint64_t pages = slab.GetPageCount(PageSize);
+        std::array<std::uint64_t, OCCUPANCY_BUCKETS> histogram{};
+        std::uint64_t residentPages = 0;
+        std::uint64_t emptyResidentPages = 0;
+        for (std::uint64_t page = 0; page < pages; ++page) {
+            const std::uint64_t first = page * PageSize / slab.BlockSize;
+            const std::uint64_t end = std::min(slab.Capacity, ((page + 1) * PageSize + slab.BlockSize - 1) / slab.BlockSize);
+            std::uint64_t live = 0;
+            for (std::uint64_t block = first; block < end && block < slab.Frontier; ++block) {
+                live += slab.IsLive(block) ? 1 : 0;
+            }
+            if (first < slab.Frontier) {
+                ++histogram[OccupancyBucket(live, end - first)];
+            }
+            if (slab.IsResident(page)) {
+                ++residentPages;
+                emptyResidentPages += live == 0 ? 1 : 0;
+            }
+        }
+        histograms.push_back(histogram);
+
+        const std::uint64_t neededPages = (liveBlocks * slab.BlockSize + PageSize - 1) / PageSize;
+        const std::uint64_t purge = emptyResidentPages * PageSize;
+        const std::uint64_t keptPages = emptyResidentPages + neededPages;
+        const std::uint64_t compact = residentPages > keptPages ? (residentPages - keptPages) * PageSize : 0;
+        heapResident += residentPages * PageSize;
+        purgeTotal += purge;
+        compactTotal += compact;
+
+        out << "  " << std::setw(5) << slab.BlockSize << " B" << std::setw(12) << liveBlocks << std::setw(10)
+            << slab.Frontier << std::setw(11) << slab.LiveBytes / KIB << std::fixed << std::setprecision(1)
+            << std::setw(10) << WastePercent(slab.LiveBytes, liveBlocks * slab.BlockSize) << '%' << std::setw(10)
+            << Percent(slab.Frontier - liveBlocks, slab.Frontier) << '%' << std::defaultfloat << std::setw(14)
+            << residentPages * PageSize / KIB << std::setw(11) << purge / KIB << std::setw(13) << compact / KIB
+            << std::endl;
+    }
+
+    out << "Page occupancy:";
+    for (const char* label : OCCUPANCY_LABELS) {
+        out << std::setw(8) << label;
+    }
+    out << std::endl;
+    for (std::size_t i = 0; i < Slabs.size(); ++i) {
+        out << "  " << std::setw(5) << Slabs[i].BlockSize << " B      ";
+        for (std::uint64_t pages : histograms[i]) {
+            out << std::setw(8) << pages;
+        }
+        out << std::endl;
+    }
+
+    out << "Span heaps:" << std::setw(9) << "spans" << std::setw(12) << "used KiB" << std::setw(11) << "live KiB"
+        << std::setw(11) << "internal" << std::setw(11) << "free KiB" << std::setw(11) << "external"
+        << std::setw(14) << "resident KiB" << std::setw(11) << "purge KiB" << std::setw(13) << "compact KiB"
+        << std::endl;
+    for (SpanHeap heap : {SpanHeap::Page, SpanHeap::Medium, SpanHeap::System}) {
+        std::uint64_t spans = 0;
+        std::uint64_t usedBytes = 0;
+        std::uint64_t liveBytes = 0;
+        std::uint64_t freeBytes = 0;
+        std::uint64_t resident = 0;
+        std::uint64_t purge = 0;
+        for (const Span& span : Spans) {
+            if (span.Heap != heap) {
+                continue;
+            }
+            ++spans;
+            resident += span.ResidentBytes;
+            if (span.Free) {
+                freeBytes += span.Size;
+                purge += span.ResidentBytes;
+            } else {
+                usedBytes += span.Size;
+                liveBytes += span.LiveBytes;
+            }
+        }
+        if (spans == 0) {
+            continue;
+        }
+        const std::uint64_t needed = RoundUpToPages(usedBytes, PageSize);
+        const std::uint64_t compact = resident > purge + needed ? resident - purge - needed : 0;
+        heapResident += resident;
+        purgeTotal += purge;
+        compactTotal += compact;
+
+        // As for slabs, external fragmentation counts free memory that has
+        // been touched; reserved address space that was never used is not
+        // held by the process.
+        const double external = Percent(purge, resident);
+        out << "  " << std::left << std::setw(8) << ToString(heap) << std::right << std::setw(9) << spans
+            << std::setw(12) << usedBytes / KIB << std::setw(11) << liveBytes / KIB << std::fixed
+            << std::setprecision(1) << std::setw(10) << WastePercent(liveBytes, usedBytes) << '%' << std::setw(11)
+            << freeBytes / KIB << std::setw(10) << external << '%' << std::defaultfloat
+            << std::setw(14) << resident / KIB << std::setw(11) << purge / KIB << std::setw(13) << compact / KIB
+            << std::endl;
+    }
+
+    std::map<MemoryTag, std::uint64_t> tagBytes;
+    for (const Slab& slab : Slabs) {
+        for (const auto& entry : slab.TagBytes) {
+            tagBytes[entry.first] += entry.second;
+        }
+    }
+    for (const Span& span : Spans) {
+        if (!span.Free) {
+            tagBytes[span.Tag] += span.LiveBytes;
+        }
+    }
+    const std::uint64_t liveTotal = GetLiveBytes();
+    std::size_t nameWidth = 0;
+    for (const auto& entry : tagBytes) {
+        nameWidth = std::max(nameWidth, GetTagName(entry.first).size());
+    }
+    out << "Live bytes by tag:" << std::endl;
+    for (const auto& entry : tagBytes) {
+        out << "  " << std::left << std::setw(static_cast<int>(nameWidth + 2)) << GetTagName(entry.first) << std::right << std::setw(14)
+            << entry.second << std::fixed << std::setprecision(1) << std::setw(8) << Percent(entry.second, liveTotal)
+            << '%' << std::defaultfloat << std::endl;
+    }
+
+    out << "Process resident " << ProcessResidentBytes / KIB << " KiB, live " << liveTotal / KIB
+        << " KiB, heap resident " << heapResident / KIB << " KiB, outside the heaps "
+        << (ProcessResidentBytes > heapResident ? ProcessResidentBytes - heapResident : 0) / KIB << " KiB" << std::endl;
+    out << "Reclaimable: " << purgeTotal / KIB << " KiB by purging free pages, " << compactTotal / KIB
+        << " KiB more by compacting live blocks" << std::endl;
+}
+
+}
@@ -0,0 +1,275 @@
+#include "../include/LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+namespace allocity {
+
+namespace {
+
+std::atomic<std::uint64_t> g_nextRecorderId{1};
+
+// Live recorders by id, so that exiting threads only hand shards back to
+// recorders that still exist.
+struct RecorderRegistry {
+    std::mutex mutex;
+    std::unordered_map<std::uint64_t, LatencyRecorder*> recorders;
+};
+
+RecorderRegistry& GetRecorderRegistry() {
+    static RecorderRegistry registry;
+    return registry;
+}
+
+}
+
+thread_local std::array<LatencyRecorder::ShardCacheEntry, LatencyRecorder::SHARD_CACHE_SIZE>
+    LatencyRecorder::t_shardCache{};
+thread_local LatencyRecorder::ThreadShards LatencyRecorder::t_threadShards;
+
+LatencyRecorder::ThreadShards::~ThreadShards() {
+    exited = true;
+    t_shardCache.fill({0, nullptr});
+    RecorderRegistry& registry = GetRecorderRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& entry : owned) {
+        auto it = registry.recorders.find(entry.first);
+        if (it != registry.recorders.end()) {
+            it->second->RetireThreadShard(entry.second);
+        }
+    }
+    owned.clear();
+}
+
+const char* ToString(AllocationPath path) {
+    switch (path) {
+        case AllocationPath::CpuCache: return "cpu cache";
+        case AllocationPath::Pool: return "pool";
+        case AllocationPath::Medium: return "medium";
+        case AllocationPath::Page: return "page";
+        case AllocationPath::Large: return "large";
+        case AllocationPath::Aligned: return "aligned";
+        default: return "unknown";
+    }
+}
+
+const char* ToString(LatencyOperation operation) {
+    switch (operation) {
+        case LatencyOperation::Allocate: return "alloc";
+        case LatencyOperation::Deallocate: return "free";
+        default: return "unknown";
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : m_max(0) {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) : m_max(other.GetMax()) {
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        m_buckets[i].store(other.m_buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other) {
+    if (this != &other) {
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+            m_buckets[i].store(other.m_buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        m_max.store(other.GetMax(), std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        const std::uint64_t count = other.m_buckets[i].load(std::memory_order_relaxed);
+        if (count != 0) {
+            m_buckets[i].fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+    std::uint64_t otherMax = other.GetMax();
+    std::uint64_t currentMax = m_max.load(std::memory_order_relaxed);
+    while (otherMax > currentMax && !m_max.compare_exchange_weak(currentMax, otherMax, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::GetCount() const {
+    std::uint64_t total = 0;
+    for (const auto& bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t LatencyHistogram::BucketUpperBound(std::size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const std::size_t shift = index / SUB_BUCKET_COUNT - 1;
+    const std::uint64_t subBucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    const std::uint64_t lower = subBucket << shift;
+    return lower + ((std::uint64_t(1) << shift) - 1);
+}
+
+std::uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const {
+    const std::uint64_t total = GetCount();
+    if (total == 0) {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    const std::uint64_t target = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total))));
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            return std::min(BucketUpperBound(i), GetMax());
+        }
+    }
+    return GetMax();
+}
+
+LatencyRecorder::LatencyRecorder()
+    : m_id(g_nextRecorderId.fetch_add(1, std::memory_order_relaxed)), m_enabled(false) {
+    RecorderRegistry& registry = GetRecorderRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.recorders.emplace(m_id, this);
+}
+
+LatencyRecorder::~LatencyRecorder() {
+    RecorderRegistry& registry = GetRecorderRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.recorders.erase(m_id);
+}
+
+double LatencyRecorder::TicksPerNanosecond() {
+    static const double ticksPerNanosecond = [] {
+        const auto startTime = std::chrono::steady_clock::now();
+        const std::uint64_t startTicks = ReadTimestamp();
+        auto now = startTime;
+        while (now - startTime < std::chrono::milliseconds(5)) {
+            now = std::chrono::steady_clock::now();
+        }
+        const std::uint64_t endTicks = ReadTimestamp();
+        const double elapsed = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - startTime).count());
+        const double ratio = static_cast<double>(endTicks - startTicks) / elapsed;
+        return ratio > 0.0 ? ratio : 1.0;
+    }();
+    return ticksPerNanosecond;
+}
+
+LatencyRecorder::ThreadShard& LatencyRecorder::RegisterThreadShard() {
+    std::lock_guard<std::mutex> lock(m_shardsMutex);
+    auto it = m_threadShards.find(std::this_thread::get_id());
+    if (it != m_threadShards.end()) {
+        return *it->second;
+    }
+    ThreadShard* shard;
+    if (!m_freeShards.empty()) {
+        shard = m_freeShards.back();
+        m_freeShards.pop_back();
+    } else {
+        m_shards.push_back(std::make_unique<ThreadShard>());
+        shard = m_shards.back().get();
+    }
+    // A thread recording from a thread_local destructor after its shards
+    // were handed back keeps this one until the recorder is destroyed.
+    if (!t_threadShards.exited) {
+        m_threadShards.emplace(std::this_thread::get_id(), shard);
+        t_threadShards.owned.emplace_back(m_id, shard);
+    }
+    return *shard;
+}
+
+void LatencyRecorder::RetireThreadShard(ThreadShard* shard) {
+    std::lock_guard<std::mutex> lock(m_shardsMutex);
+    for (std::size_t slot = 0; slot < NUM_SLOTS; ++slot) {
+        m_retired.histograms[slot].Merge(shard->histograms[slot]);
+        shard->histograms[slot].Reset();
+    }
+    m_threadShards.erase(std::this_thread::get_id());
+    m_freeShards.push_back(shard);
+}
+
+LatencyHistogram LatencyRecorder::GetHistogram(LatencyOperation operation, AllocationPath path) const {
+    std::lock_guard<std::mutex> lock(m_shardsMutex);
+    LatencyHistogram merged(m_retired.histograms[Slot(operation, path)]);
+    for (const auto& shard : m_shards) {
+        merged.Merge(shard->histograms[Slot(operation, path)]);
+    }
+    return merged;
+}
+
+std::uint64_t LatencyRecorder::GetCount(LatencyOperation operation, AllocationPath path) const {
+    return GetHistogram(operation, path).GetCount();
+}
+
+double LatencyRecorder::GetPercentile(LatencyOperation operation, AllocationPath path, double percentile) const {
+    return static_cast<double>(GetHistogram(operation, path).GetValueAtPercentile(percentile)) / TicksPerNanosecond();
+}
+
+double LatencyRecorder::GetMax(LatencyOperation operation, AllocationPath path) const {
+    return static_cast<double>(GetHistogram(operation, path).GetMax()) / TicksPerNanosecond();
+}
+
+void LatencyRecorder::Reset() {
+    std::lock_guard<std::mutex> lock(m_shardsMutex);
+    for (auto& histogram : m_retired.histograms) {
+        histogram.Reset();
+    }
+    for (auto& shard : m_shards) {
+        for (auto& histogram : shard->histograms) {
+            histogram.Reset();
+        }
+    }
+}
+
+void LatencyRecorder::Report(std::ostream& out) const {
+    const double ticksPerNanosecond = TicksPerNanosecond();
+    bool printedHeader = false;
+
+    for (std::size_t op = 0; op < static_cast<std::size_t>(LatencyOperation::Count); ++op) {
+        for (std::size_t path = 0; path < static_cast<std::size_t>(AllocationPath::Count); ++path) {
+            const auto operation = static_cast<LatencyOperation>(op);
+            const auto allocationPath = static_cast<AllocationPath>(path);
+            const LatencyHistogram histogram = GetHistogram(operation, allocationPath);
+            const std::uint64_t count = histogram.GetCount();
+            if (count == 0) {
+                continue;
+            }
+
+            if (!printedHeader) {
+                out << "Latency (ns):" << std::setw(14) << "count" << std::setw(10) << "p50"
+                    << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max" << std::endl;
+                printedHeader = true;
+            }
+
+            auto toNanoseconds = [ticksPerNanosecond](std::uint64_t ticks) {
+                return static_cast<std::uint64_t>(static_cast<double>(ticks) / ticksPerNanosecond);
+            };
+
+            std::string label = std::string("  ") + ToString(operation) + "/" + ToString(allocationPath);
+            out << std::left << std::setw(19) << label << std::right
+                << std::setw(8) << count
+                << std::setw(10) << toNanoseconds(histogram.GetValueAtPercentile(50.0))
+                << std::setw(10) << toNanoseconds(histogram.GetValueAtPercentile(99.0))
+                << std::setw(10) << toNanoseconds(histogram.GetValueAtPercentile(99.9))
+                << std::setw(12) << toNanoseconds(histogram.GetMax()) << std::endl;
+        }
+    }
+}
+
+}
@@ -0,0 +1,51 @@
+#include "../include/LockFreeMemoryPool.hpp"
+
+namespace allocity {
+
+LockFreeMemoryPool::LockFreeMemoryPool(std::size_t blockSize, std::size_t blockCount)
+    : m_blockSize(blockSize), m_capacity(blockCount), m_memory(nullptr), m_ownsMemory(true), m_allocated(blockCount),
+      m_freeHead(0), m_usedBlocks(0) {
+    if (blockSize == 0 || blockCount == 0) {
+        throw std::invalid_argument("Memory pool must hold at least one non-empty block");
+    }
+    if (blockCount >= EMPTY_INDEX) {
+        throw std::invalid_argument("Memory pool block count exceeds the index range");
+    }
+    m_next.reset(new std::atomic<std::uint32_t>[blockCount]);
+    m_memory = new char[m_blockSize * m_capacity];
+    InitializeFreeList();
+}
+
+LockFreeMemoryPool::LockFreeMemoryPool(std::size_t blockSize, std::size_t blockCount, void* memory)
+    : m_blockSize(blockSize), m_capacity(blockCount), m_memory(static_cast<char*>(memory)), m_ownsMemory(false),
+      m_allocated(blockCount), m_freeHead(0), m_usedBlocks(0) {
+    if (memory == nullptr || blockSize == 0 || blockCount == 0) {
+        throw std::invalid_argument("External pool memory must hold at least one non-empty block");
+    }
+    if (blockCount >= EMPTY_INDEX) {
+        throw std::invalid_argument("Memory pool block count exceeds the index range");
+    }
+    m_next.reset(new std::atomic<std::uint32_t>[blockCount]);
+    InitializeFreeList();
+}
+
+LockFreeMemoryPool::~LockFreeMemoryPool() {
+    if (m_ownsMemory) {
+        delete[] m_memory;
+    }
+}
+
+void LockFreeMemoryPool::InitializeFreeList() {
+    for (std::size_t i = 0; i < m_capacity; ++i) {
+        m_next[i].store(i + 1 < m_capacity ? static_cast<std::uint32_t>(i + 1) : EMPTY_INDEX, std::memory_order_relaxed);
+    }
+    m_freeHead.store(PackHead(m_freeHead.load(std::memory_order_relaxed), 0), std::memory_order_release);
+}
+
+void LockFreeMemoryPool::Clear() {
+    m_allocated.ClearAll();
+    m_usedBlocks.store(0, std::memory_order_relaxed);
+    InitializeFreeList();
+}
+
+}
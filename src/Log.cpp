@@ -0,0 +1,264 @@
+#include "../include/Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace allocity {
+
+namespace {
+
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(10);
+
+std::uint64_t NowNanoseconds() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Single-producer (the owning thread), single-consumer (whoever holds the
+// drain lock) ring of records.
+class LogRing {
+public:
+    explicit LogRing(std::uint32_t threadIndex)
+        : m_threadIndex(threadIndex), m_head(0), m_tail(0), m_dropped(0), m_abandoned(false) {}
+
+    bool Push(const Log::Record& record) {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Log::RING_CAPACITY) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_records[tail % Log::RING_CAPACITY] = record;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(Log::Record& record) {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        record = m_records[head % Log::RING_CAPACITY];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::uint32_t GetThreadIndex() const { return m_threadIndex; }
+    std::uint64_t TakeDropped() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+    void Abandon() { m_abandoned.store(true, std::memory_order_release); }
+    bool IsAbandoned() const { return m_abandoned.load(std::memory_order_acquire); }
+
+private:
+    Log::Record m_records[Log::RING_CAPACITY];
+    std::uint32_t m_threadIndex;
+    std::atomic<std::size_t> m_head;
+    std::atomic<std::size_t> m_tail;
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<bool> m_abandoned;
+};
+
+void DefaultSink(const LogMessage& message) {
+    std::cerr << "[allocity " << ToString(message.Level) << " t" << message.ThreadIndex << "] " << message.Text << '\n';
+}
+
+void AppendArgument(std::string& text, const Log::Argument& argument) {
+    char buffer[32];
+    switch (argument.kind) {
+        case Log::Argument::Kind::Signed:
+            std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(argument.i));
+            break;
+        case Log::Argument::Kind::Unsigned:
+            std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(argument.u));
+            break;
+        case Log::Argument::Kind::Pointer:
+            std::snprintf(buffer, sizeof(buffer), "%p", argument.p);
+            break;
+        case Log::Argument::Kind::Double:
+            std::snprintf(buffer, sizeof(buffer), "%g", argument.d);
+            break;
+        case Log::Argument::Kind::String:
+            text += argument.s != nullptr ? argument.s : "(null)";
+            return;
+    }
+    text += buffer;
+}
+
+std::string Format(const Log::Record& record) {
+    std::string text;
+    std::size_t next = 0;
+    for (const char* c = record.format; *c != '\0'; ++c) {
+        if (c[0] == '{' && c[1] == '}' && next < record.argumentCount) {
+            AppendArgument(text, record.arguments[next++]);
+            ++c;
+        } else {
+            text += *c;
+        }
+    }
+    return text;
+}
+
+class Logger {
+public:
+    Logger() : m_sink(DefaultSink), m_nextThreadIndex(0), m_dropped(0), m_stop(false) {}
+
+    // Stops the flusher and delivers whatever is still queued.
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(m_flusherMutex);
+            m_stop = true;
+        }
+        m_flusherWake.notify_all();
+        if (m_flusher.joinable()) {
+            m_flusher.join();
+        }
+        Drain();
+    }
+
+    std::shared_ptr<LogRing> RegisterThread() {
+        std::call_once(m_flusherStarted, [this] { m_flusher = std::thread(&Logger::FlusherLoop, this); });
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        auto ring = std::make_shared<LogRing>(m_nextThreadIndex++);
+        m_rings.push_back(ring);
+        return ring;
+    }
+
+    void SetSink(LogSink sink) {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        m_sink = sink ? std::move(sink) : LogSink(DefaultSink);
+    }
+
+    std::uint64_t GetDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    void Drain() {
+        std::lock_guard<std::mutex> drainLock(m_drainMutex);
+        std::vector<std::shared_ptr<LogRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            rings = m_rings;
+        }
+
+        std::vector<std::pair<std::uint32_t, Log::Record>> records;
+        std::uint64_t dropped = 0;
+        for (const auto& ring : rings) {
+            Log::Record record;
+            while (ring->Pop(record)) {
+                records.emplace_back(ring->GetThreadIndex(), record);
+            }
+            dropped += ring->TakeDropped();
+        }
+        std::stable_sort(records.begin(), records.end(), [](const auto& a, const auto& b) {
+            return a.second.timestamp < b.second.timestamp;
+        });
+
+        for (const auto& entry : records) {
+            m_sink(LogMessage{entry.second.level, entry.second.timestamp, entry.first, Format(entry.second)});
+        }
+        if (dropped != 0) {
+            m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+            m_sink(LogMessage{LogLevel::Warning, NowNanoseconds(), 0,
+                              "dropped " + std::to_string(dropped) + " log messages (ring full)"});
+        }
+
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(),
+                                     [](const std::shared_ptr<LogRing>& ring) {
+                                         Log::Record ignored;
+                                         return ring->IsAbandoned() && !ring->Pop(ignored);
+                                     }),
+                      m_rings.end());
+    }
+
+private:
+    void FlusherLoop() {
+        std::unique_lock<std::mutex> lock(m_flusherMutex);
+        while (!m_stop) {
+            m_flusherWake.wait_for(lock, FLUSH_INTERVAL, [this] { return m_stop; });
+            lock.unlock();
+            Drain();
+            lock.lock();
+        }
+    }
+
+    LogSink m_sink;
+    std::vector<std::shared_ptr<LogRing>> m_rings;
+    std::uint32_t m_nextThreadIndex;
+    std::atomic<std::uint64_t> m_dropped;
+    std::mutex m_ringsMutex;
+    std::mutex m_drainMutex;
+
+    std::thread m_flusher;
+    std::once_flag m_flusherStarted;
+    std::mutex m_flusherMutex;
+    std::condition_variable m_flusherWake;
+    bool m_stop;
+};
+
+Logger& GetLogger() {
+    static Logger logger;
+    return logger;
+}
+
+// Keeps the calling thread's ring registered until the thread exits; the
+// flusher then drains what is left and forgets the ring.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->Abandon();
+        }
+    }
+};
+
+thread_local ThreadRing t_ring;
+
+}
+
+std::atomic<int> Log::s_level{static_cast<int>(LogLevel::Info)};
+
+const char* ToString(LogLevel level) {
+    switch (level) {
+        case LogLevel::Trace: return "trace";
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error: return "error";
+        case LogLevel::Off: return "off";
+        default: return "unknown";
+    }
+}
+
+void Log::SetLevel(LogLevel level) {
+    s_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Log::GetLevel() {
+    return static_cast<LogLevel>(s_level.load(std::memory_order_relaxed));
+}
+
+void Log::SetSink(LogSink sink) {
+    GetLogger().SetSink(std::move(sink));
+}
+
+void Log::Flush() {
+    GetLogger().Drain();
+}
+
+std::uint64_t Log::GetDroppedCount() {
+    return GetLogger().GetDropped();
+}
+
+void Log::Submit(Record& record) {
+    if (!t_ring.ring) {
+        t_ring.ring = GetLogger().RegisterThread();
+    }
+    record.timestamp = NowNanoseconds();
+    t_ring.ring->Push(record);
+}
+
+}
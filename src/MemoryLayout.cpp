@@ -0,0 +1,135 @@
+#include "../include/MemoryLayout.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace allocity {
+
+ColumnRegion::ColumnRegion(Allocator& allocator, std::vector<ColumnDescriptor> columns, std::size_t capacity)
+    : m_Allocator(&allocator),
+      m_Columns(std::move(columns)),
+      m_Offsets(m_Columns.size(), 0),
+      m_Region(nullptr),
+      m_RegionSize(0),
+      m_Size(0),
+      m_Capacity(0) {
+    if (m_Columns.empty()) {
+        throw std::invalid_argument("A column region needs at least one column");
+    }
+    Reallocate(std::max<std::size_t>(capacity, 1));
+}
+
+ColumnRegion::~ColumnRegion() {
+    Release();
+}
+
+ColumnRegion::ColumnRegion(ColumnRegion&& other) noexcept
+    : m_Allocator(other.m_Allocator),
+      m_Columns(std::move(other.m_Columns)),
+      m_Offsets(std::move(other.m_Offsets)),
+      m_Region(other.m_Region),
+      m_RegionSize(other.m_RegionSize),
+      m_Size(other.m_Size),
+      m_Capacity(other.m_Capacity) {
+    other.m_Region = nullptr;
+    other.m_RegionSize = 0;
+    other.m_Size = 0;
+    other.m_Capacity = 0;
+}
+
+ColumnRegion& ColumnRegion::operator=(ColumnRegion&& other) noexcept {
+    if (this != &other) {
+        Release();
+        m_Allocator = other.m_Allocator;
+        m_Columns = std::move(other.m_Columns);
+        m_Offsets = std::move(other.m_Offsets);
+        m_Region = other.m_Region;
+        m_RegionSize = other.m_RegionSize;
+        m_Size = other.m_Size;
+        m_Capacity = other.m_Capacity;
+        other.m_Region = nullptr;
+        other.m_RegionSize = 0;
+        other.m_Size = 0;
+        other.m_Capacity = 0;
+    }
+    return *this;
+}
+
+std::size_t ColumnRegion::FindColumn(const std::string& name) const {
+    for (std::size_t i = 0; i < m_Columns.size(); ++i) {
+        if (m_Columns[i].Name == name) {
+            return i;
+        }
+    }
+    throw std::out_of_range("Unknown column: " + name);
+}
+
+void ColumnRegion::Reserve(std::size_t capacity) {
+    if (capacity > m_Capacity) {
+        Reallocate(capacity);
+    }
+}
+
+void ColumnRegion::Resize(std::size_t size) {
+    if (size > m_Capacity) {
+        Reallocate(std::max(size, m_Capacity * 2));
+    }
+    if (size > m_Size) {
+        for (std::size_t i = 0; i < m_Columns.size(); ++i) {
+            std::memset(m_Region + m_Offsets[i] + m_Columns[i].ElementSize * m_Size, 0,
+                        m_Columns[i].ElementSize * (size - m_Size));
+        }
+    }
+    m_Size = size;
+}
+
+std::size_t ColumnRegion::PushBack() {
+    Resize(m_Size + 1);
+    return m_Size - 1;
+}
+
+void ColumnRegion::Reallocate(std::size_t capacity) {
+    // A capacity whose byte size wraps size_t throws before anything is
+    // allocated, so the current columns stay valid, as on a refusal.
+    std::vector<std::size_t> offsets(m_Columns.size());
+    std::size_t regionSize = 0;
+    for (std::size_t i = 0; i < m_Columns.size(); ++i) {
+        offsets[i] = regionSize;
+        const std::size_t capacityBytes = detail::CheckedMultiply(m_Columns[i].ElementSize, capacity);
+        regionSize = detail::CheckedAdd(regionSize, detail::CheckedAlignUp(capacityBytes, CACHE_LINE_SIZE));
+    }
+
+    char* region = static_cast<char*>(m_Allocator->AlignedAllocate(regionSize, CACHE_LINE_SIZE));
+    if (region == nullptr) {
+        // Refused by a hard tag budget; the current columns stay valid.
+        throw std::bad_alloc();
+    }
+
+    for (std::size_t i = 0; i < m_Columns.size(); ++i) {
+        const std::size_t liveBytes = m_Columns[i].ElementSize * m_Size;
+        const std::size_t capacityBytes = m_Columns[i].ElementSize * capacity;
+        const std::size_t columnBytes = AlignUp(capacityBytes, CACHE_LINE_SIZE);
+        if (m_Region != nullptr && liveBytes != 0) {
+            std::memcpy(region + offsets[i], m_Region + m_Offsets[i], liveBytes);
+        }
+        std::memset(region + offsets[i] + capacityBytes, 0, columnBytes - capacityBytes);
+    }
+
+    Release();
+    m_Region = region;
+    m_RegionSize = regionSize;
+    m_Offsets = std::move(offsets);
+    m_Capacity = capacity;
+}
+
+void ColumnRegion::Release() {
+    if (m_Region != nullptr) {
+        m_Allocator->AlignedDeallocate(m_Region);
+        m_Region = nullptr;
+        m_RegionSize = 0;
+    }
+}
+
+}
@@ -0,0 +1,362 @@
+#include "../include/MemoryManager.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace allocity {
+
+MemoryManager::MemoryManager(std::size_t slabSize)
+    : m_slabSize(slabSize),
+      m_slabHeap(),
+      m_currentSlabs(MemoryTags::MAX_TAGS, NO_SLAB),
+      m_liveObjects(0),
+      m_liveBytes(0),
+      m_slabBytes(0),
+      m_movedBytes(0),
+      m_releasedSlabs(0),
+      m_stopCompactor(false),
+      m_lastActivity(0) {
+    if (slabSize < m_slabHeap.GetMinBlockSize() || slabSize > m_slabHeap.GetMaxBlockSize() ||
+        m_slabHeap.RoundUp(slabSize) != slabSize) {
+        throw std::invalid_argument("Slab size must be a power of two between the page size and the largest buddy block");
+    }
+    Touch();
+}
+
+MemoryManager::~MemoryManager() {
+    StopBackgroundCompaction();
+}
+
+MemoryManager::Entry& MemoryManager::Lookup(Handle handle) {
+    return const_cast<Entry&>(static_cast<const MemoryManager*>(this)->Lookup(handle));
+}
+
+const MemoryManager::Entry& MemoryManager::Lookup(Handle handle) const {
+    if (handle.IsNull() || handle.index >= m_entries.size() || m_entries[handle.index].generation != handle.generation) {
+        throw std::invalid_argument("Invalid or stale memory handle");
+    }
+    return m_entries[handle.index];
+}
+
+std::uint32_t MemoryManager::NewSlab(std::size_t capacity, MemoryTag tag) {
+    char* memory = static_cast<char*>(m_slabHeap.Allocate(capacity));
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    auto slab = std::make_unique<Slab>(Slab{memory, capacity, 0, 0, 0, tag, {}});
+    m_slabBytes += capacity;
+
+    if (!m_freeSlabs.empty()) {
+        const std::uint32_t index = m_freeSlabs.back();
+        m_freeSlabs.pop_back();
+        m_slabs[index] = std::move(slab);
+        return index;
+    }
+    m_slabs.push_back(std::move(slab));
+    return static_cast<std::uint32_t>(m_slabs.size() - 1);
+}
+
+std::uint32_t MemoryManager::AcquireSlab(std::size_t size, MemoryTag tag) {
+    if (size > m_slabSize) {
+        return NewSlab(m_slabHeap.RoundUp(size), tag);
+    }
+    std::uint32_t& currentSlab = m_currentSlabs[tag];
+    if (currentSlab != NO_SLAB) {
+        const Slab& current = *m_slabs[currentSlab];
+        if (current.capacity - current.used >= size) {
+            return currentSlab;
+        }
+    }
+    const std::uint32_t previous = currentSlab;
+    currentSlab = NewSlab(m_slabSize, tag);
+    if (previous != NO_SLAB && m_slabs[previous]->objects.empty()) {
+        ReleaseSlab(previous);
+    }
+    return currentSlab;
+}
+
+void MemoryManager::Place(std::uint32_t index, std::uint32_t slabIndex, std::size_t size) {
+    Slab& slab = *m_slabs[slabIndex];
+    Entry& entry = m_entries[index];
+    entry.address = slab.memory + slab.used;
+    entry.slab = slabIndex;
+    entry.slot = static_cast<std::uint32_t>(slab.objects.size());
+    slab.used += size;
+    slab.liveBytes += size;
+    slab.objects.push_back(index);
+}
+
+void MemoryManager::RemoveFromSlab(Entry& entry) {
+    const std::uint32_t slabIndex = entry.slab;
+    Slab& slab = *m_slabs[slabIndex];
+    slab.liveBytes -= AlignUp(entry.size, OBJECT_ALIGNMENT);
+
+    const std::uint32_t last = slab.objects.back();
+    slab.objects[entry.slot] = last;
+    m_entries[last].slot = entry.slot;
+    slab.objects.pop_back();
+    entry.slab = NO_SLAB;
+}
+
+void MemoryManager::ReleaseIfEmpty(std::uint32_t slabIndex) {
+    Slab& slab = *m_slabs[slabIndex];
+    if (!slab.objects.empty()) {
+        return;
+    }
+    if (slabIndex == m_currentSlabs[slab.tag]) {
+        slab.used = 0;
+    } else {
+        ReleaseSlab(slabIndex);
+    }
+}
+
+void MemoryManager::ReleaseSlab(std::uint32_t slabIndex) {
+    m_slabBytes -= m_slabs[slabIndex]->capacity;
+    m_slabHeap.Deallocate(m_slabs[slabIndex]->memory);
+    m_slabs[slabIndex].reset();
+    m_freeSlabs.push_back(slabIndex);
+    ++m_releasedSlabs;
+}
+
+MemoryManager::Handle MemoryManager::Allocate(std::size_t size) {
+    return Allocate(size, MemoryTags::GetCurrent());
+}
+
+MemoryManager::Handle MemoryManager::Allocate(std::size_t size, MemoryTag tag) {
+    if (size == 0) {
+        return Handle{};
+    }
+    if (size > m_slabHeap.GetMaxBlockSize()) {
+        throw std::invalid_argument("Object exceeds the largest relocatable slab");
+    }
+    if (!MemoryTags::Charge(tag, size)) {
+        return Handle{};
+    }
+    const std::size_t alignedSize = AlignUp(size, OBJECT_ALIGNMENT);
+    Touch();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::uint32_t slabIndex;
+    try {
+        slabIndex = AcquireSlab(alignedSize, tag);
+    } catch (...) {
+        MemoryTags::Release(tag, size);
+        throw;
+    }
+
+    std::uint32_t index;
+    if (!m_freeEntries.empty()) {
+        index = m_freeEntries.back();
+        m_freeEntries.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(m_entries.size());
+        m_entries.push_back(Entry{nullptr, 0, 1, NO_SLAB, 0, 0});
+    }
+    Entry& entry = m_entries[index];
+    entry.size = size;
+    entry.pins = 0;
+    Place(index, slabIndex, alignedSize);
+
+    ++m_liveObjects;
+    m_liveBytes += size;
+    return Handle{index, entry.generation};
+}
+
+void MemoryManager::Free(Handle handle) {
+    if (handle.IsNull()) return;
+    Touch();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = Lookup(handle);
+    if (entry.pins != 0) {
+        throw std::runtime_error("Cannot free a pinned memory handle");
+    }
+    const std::uint32_t slabIndex = entry.slab;
+    MemoryTags::Release(m_slabs[slabIndex]->tag, entry.size);
+    RemoveFromSlab(entry);
+    ReleaseIfEmpty(slabIndex);
+    RetireEntry(handle.index);
+}
+
+void MemoryManager::RetireEntry(std::uint32_t index) {
+    Entry& entry = m_entries[index];
+    --m_liveObjects;
+    m_liveBytes -= entry.size;
+    entry.address = nullptr;
+    entry.slab = NO_SLAB;
+    entry.generation = entry.generation == UINT32_MAX ? 1 : entry.generation + 1;
+    m_freeEntries.push_back(index);
+}
+
+std::size_t MemoryManager::ReleaseTag(MemoryTag tag) {
+    Touch();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& slab : m_slabs) {
+        if (slab && slab->tag == tag && slab->pinnedObjects != 0) {
+            throw std::runtime_error("Cannot release a memory tag with pinned objects");
+        }
+    }
+
+    std::size_t released = 0;
+    for (std::uint32_t i = 0; i < m_slabs.size(); ++i) {
+        if (!m_slabs[i] || m_slabs[i]->tag != tag) {
+            continue;
+        }
+        for (std::uint32_t index : m_slabs[i]->objects) {
+            released += m_entries[index].size;
+            RetireEntry(index);
+        }
+        ReleaseSlab(i);
+    }
+    m_currentSlabs[tag] = NO_SLAB;
+    MemoryTags::Release(tag, released);
+    return released;
+}
+
+void* MemoryManager::Pin(Handle handle) {
+    Touch();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = Lookup(handle);
+    if (entry.pins++ == 0) {
+        ++m_slabs[entry.slab]->pinnedObjects;
+    }
+    return entry.address;
+}
+
+void MemoryManager::Unpin(Handle handle) {
+    Touch();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = Lookup(handle);
+    if (entry.pins == 0) {
+        throw std::runtime_error("Unpin without matching Pin");
+    }
+    if (--entry.pins == 0) {
+        --m_slabs[entry.slab]->pinnedObjects;
+    }
+}
+
+bool MemoryManager::IsValid(Handle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !handle.IsNull() && handle.index < m_entries.size() &&
+           m_entries[handle.index].generation == handle.generation && m_entries[handle.index].address != nullptr;
+}
+
+std::size_t MemoryManager::GetSize(Handle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Lookup(handle).size;
+}
+
+std::size_t MemoryManager::Compact(double occupancyThreshold, std::size_t maxBytesToMove) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return CompactLocked(occupancyThreshold, maxBytesToMove);
+}
+
+// Evacuates the sparsest slabs first. A slab holding a pinned object is
+// skipped entirely: moving its other objects would not let it be released.
+std::size_t MemoryManager::CompactLocked(double occupancyThreshold, std::size_t maxBytesToMove) {
+    std::vector<std::pair<double, std::uint32_t>> candidates;
+    for (std::uint32_t i = 0; i < m_slabs.size(); ++i) {
+        const Slab* slab = m_slabs[i].get();
+        if (slab == nullptr || i == m_currentSlabs[slab->tag] || slab->capacity != m_slabSize ||
+            slab->pinnedObjects != 0) {
+            continue;
+        }
+        const double occupancy = static_cast<double>(slab->liveBytes) / static_cast<double>(slab->capacity);
+        if (occupancy < occupancyThreshold) {
+            candidates.emplace_back(occupancy, i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::size_t moved = 0;
+    for (const auto& candidate : candidates) {
+        const Slab& source = *m_slabs[candidate.second];
+        if (moved + source.liveBytes > maxBytesToMove) {
+            break;
+        }
+        const std::vector<std::uint32_t> objects = source.objects;
+        for (std::uint32_t index : objects) {
+            Entry& entry = m_entries[index];
+            const std::size_t alignedSize = AlignUp(entry.size, OBJECT_ALIGNMENT);
+            const char* from = entry.address;
+            const std::uint32_t sourceIndex = entry.slab;
+            const std::uint32_t destination = AcquireSlab(alignedSize, m_slabs[sourceIndex]->tag);
+            RemoveFromSlab(entry);
+            Place(index, destination, alignedSize);
+            std::memcpy(entry.address, from, entry.size);
+            ReleaseIfEmpty(sourceIndex);
+            moved += alignedSize;
+        }
+    }
+    m_movedBytes += moved;
+    return moved;
+}
+
+void MemoryManager::StartBackgroundCompaction(std::chrono::milliseconds idleInterval, double occupancyThreshold) {
+    StopBackgroundCompaction();
+    {
+        std::lock_guard<std::mutex> lock(m_compactorMutex);
+        m_stopCompactor = false;
+    }
+    m_compactor = std::thread(&MemoryManager::BackgroundWorker, this, idleInterval, occupancyThreshold);
+}
+
+void MemoryManager::StopBackgroundCompaction() {
+    {
+        std::lock_guard<std::mutex> lock(m_compactorMutex);
+        m_stopCompactor = true;
+    }
+    m_compactorCondition.notify_all();
+    if (m_compactor.joinable()) {
+        m_compactor.join();
+    }
+}
+
+void MemoryManager::BackgroundWorker(std::chrono::milliseconds idleInterval, double occupancyThreshold) {
+    const std::int64_t idleTicks = std::chrono::duration_cast<std::chrono::steady_clock::duration>(idleInterval).count();
+    std::unique_lock<std::mutex> lock(m_compactorMutex);
+    while (!m_compactorCondition.wait_for(lock, idleInterval, [this] { return m_stopCompactor; })) {
+        const std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        if (now - m_lastActivity.load(std::memory_order_relaxed) < idleTicks) {
+            continue;
+        }
+        // Bound each pass so a burst of activity never waits on a long compaction.
+        std::lock_guard<std::mutex> heapLock(m_mutex);
+        CompactLocked(occupancyThreshold, m_slabSize * 16);
+    }
+}
+
+std::size_t MemoryManager::GetLiveObjects() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_liveObjects;
+}
+
+std::size_t MemoryManager::GetLiveBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_liveBytes;
+}
+
+std::size_t MemoryManager::GetSlabCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slabs.size() - m_freeSlabs.size();
+}
+
+std::size_t MemoryManager::GetSlabBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slabBytes;
+}
+
+std::size_t MemoryManager::GetMovedBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_movedBytes;
+}
+
+std::size_t MemoryManager::GetReleasedSlabs() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_releasedSlabs;
+}
+
+}
@@ -0,0 +1,235 @@
+#include "../include/MemoryTag.hpp"
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+namespace allocity {
+
+namespace {
+
+struct TagState {
+    std::string name;
+    bool registered = false;
+    std::atomic<std::int64_t> live{0};
+    std::atomic<std::int64_t> peak{0};
+    std::atomic<std::size_t> softBudget{MemoryTags::NO_BUDGET};
+    std::atomic<std::size_t> hardBudget{MemoryTags::NO_BUDGET};
+    std::atomic<bool> softExceeded{false};
+    BudgetCallback callback;
+};
+
+struct Registry {
+    std::mutex mutex;
+    TagState tags[MemoryTags::MAX_TAGS];
+    std::size_t count = 0;
+
+    Registry() {
+        tags[MemoryTags::UNTAGGED].name = "untagged";
+        tags[MemoryTags::UNTAGGED].registered = true;
+        count = 1;
+    }
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+TagState& GetState(MemoryTag tag) {
+    if (tag >= MemoryTags::MAX_TAGS) {
+        throw std::out_of_range("Memory tag out of range");
+    }
+    return GetRegistry().tags[tag];
+}
+
+void Notify(MemoryTag tag, BudgetEvent event, std::int64_t live, std::size_t requested) {
+    Registry& registry = GetRegistry();
+    BudgetCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        callback = registry.tags[tag].callback;
+    }
+    if (callback) {
+        callback(tag, event, live > 0 ? static_cast<std::size_t>(live) : 0, requested);
+    }
+}
+
+}
+
+thread_local MemoryTag MemoryTags::t_currentTag = MemoryTags::UNTAGGED;
+thread_local MemoryTags::PendingDeltas MemoryTags::t_pending;
+std::atomic<bool> MemoryTags::s_budgeted[MemoryTags::MAX_TAGS] = {};
+
+MemoryTags::PendingDeltas::~PendingDeltas() {
+    for (std::size_t tag = 0; tag < MAX_TAGS; ++tag) {
+        if (deltas[tag] != 0) {
+            GetRegistry().tags[tag].live.fetch_add(deltas[tag], std::memory_order_relaxed);
+            deltas[tag] = 0;
+        }
+    }
+}
+
+MemoryTag MemoryTags::Register(const std::string& name) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (std::size_t tag = 0; tag < registry.count; ++tag) {
+        if (registry.tags[tag].name == name) {
+            return static_cast<MemoryTag>(tag);
+        }
+    }
+    if (registry.count == MAX_TAGS) {
+        throw std::length_error("Too many memory tags registered");
+    }
+    TagState& state = registry.tags[registry.count];
+    state.name = name;
+    state.registered = true;
+    return static_cast<MemoryTag>(registry.count++);
+}
+
+bool MemoryTags::Find(const std::string& name, MemoryTag& tag) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (std::size_t i = 0; i < registry.count; ++i) {
+        if (registry.tags[i].name == name) {
+            tag = static_cast<MemoryTag>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string MemoryTags::GetName(MemoryTag tag) {
+    TagState& state = GetState(tag);
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    return state.registered ? state.name : "tag" + std::to_string(tag);
+}
+
+void MemoryTags::SetBudget(MemoryTag tag, std::size_t softBudget, std::size_t hardBudget) {
+    TagState& state = GetState(tag);
+    state.softBudget.store(softBudget, std::memory_order_relaxed);
+    state.hardBudget.store(hardBudget, std::memory_order_relaxed);
+    state.softExceeded.store(false, std::memory_order_relaxed);
+    s_budgeted[tag].store(softBudget != NO_BUDGET || hardBudget != NO_BUDGET, std::memory_order_relaxed);
+}
+
+void MemoryTags::SetBudgetCallback(MemoryTag tag, BudgetCallback callback) {
+    TagState& state = GetState(tag);
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    state.callback = std::move(callback);
+}
+
+bool MemoryTags::ChargeSlow(MemoryTag tag, std::size_t size) {
+    TagState& state = GetRegistry().tags[tag];
+    std::int64_t& pending = t_pending.deltas[tag];
+
+    const std::size_t hardBudget = state.hardBudget.load(std::memory_order_relaxed);
+    if (hardBudget != NO_BUDGET) {
+        const std::int64_t projected = state.live.load(std::memory_order_relaxed) + pending;
+        if (projected > static_cast<std::int64_t>(hardBudget)) {
+            pending -= static_cast<std::int64_t>(size);
+            Notify(tag, BudgetEvent::HardLimitRejected, projected - static_cast<std::int64_t>(size), size);
+            return false;
+        }
+    }
+    if (pending >= FLUSH_THRESHOLD) {
+        Flush(tag);
+    }
+    return true;
+}
+
+void MemoryTags::Flush(MemoryTag tag) {
+    TagState& state = GetRegistry().tags[tag];
+    std::int64_t& pending = t_pending.deltas[tag];
+    const std::int64_t delta = pending;
+    pending = 0;
+
+    const std::int64_t live = state.live.fetch_add(delta, std::memory_order_relaxed) + delta;
+    std::int64_t peak = state.peak.load(std::memory_order_relaxed);
+    while (live > peak && !state.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+
+    const std::size_t softBudget = state.softBudget.load(std::memory_order_relaxed);
+    if (softBudget == NO_BUDGET || delta <= 0) {
+        if (softBudget != NO_BUDGET && live <= static_cast<std::int64_t>(softBudget)) {
+            state.softExceeded.store(false, std::memory_order_relaxed);
+        }
+        return;
+    }
+    if (live > static_cast<std::int64_t>(softBudget)) {
+        if (!state.softExceeded.exchange(true, std::memory_order_relaxed)) {
+            Notify(tag, BudgetEvent::SoftLimitExceeded, live, delta > 0 ? static_cast<std::size_t>(delta) : 0);
+        }
+    } else {
+        state.softExceeded.store(false, std::memory_order_relaxed);
+    }
+}
+
+void MemoryTags::Flush() {
+    for (std::size_t tag = 0; tag < MAX_TAGS; ++tag) {
+        if (t_pending.deltas[tag] != 0) {
+            Flush(static_cast<MemoryTag>(tag));
+        }
+    }
+}
+
+std::size_t MemoryTags::GetLiveBytes(MemoryTag tag) {
+    const std::int64_t live = GetState(tag).live.load(std::memory_order_relaxed);
+    return live > 0 ? static_cast<std::size_t>(live) : 0;
+}
+
+std::size_t MemoryTags::GetPeakBytes(MemoryTag tag) {
+    const std::int64_t peak = GetState(tag).peak.load(std::memory_order_relaxed);
+    return peak > 0 ? static_cast<std::size_t>(peak) : 0;
+}
+
+MemoryTagStats MemoryTags::GetStats(MemoryTag tag) {
+    TagState& state = GetState(tag);
+    return MemoryTagStats{tag,
+                          GetName(tag),
+                          GetLiveBytes(tag),
+                          GetPeakBytes(tag),
+                          state.softBudget.load(std::memory_order_relaxed),
+                          state.hardBudget.load(std::memory_order_relaxed)};
+}
+
+std::vector<MemoryTagStats> MemoryTags::GetAllStats() {
+    std::size_t count;
+    {
+        std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+        count = GetRegistry().count;
+    }
+    std::vector<MemoryTagStats> stats;
+    stats.reserve(count);
+    for (std::size_t tag = 0; tag < count; ++tag) {
+        stats.push_back(GetStats(static_cast<MemoryTag>(tag)));
+    }
+    return stats;
+}
+
+void MemoryTags::ResetPeak(MemoryTag tag) {
+    TagState& state = GetState(tag);
+    state.peak.store(state.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemoryTags::Report(std::ostream& out) {
+    auto formatBudget = [](std::size_t budget) {
+        return budget == NO_BUDGET ? std::string("-") : std::to_string(budget);
+    };
+
+    bool printedHeader = false;
+    for (const MemoryTagStats& stats : GetAllStats()) {
+        if (stats.PeakBytes == 0 && stats.LiveBytes == 0) {
+            continue;
+        }
+        if (!printedHeader) {
+            out << "Memory tags:" << std::setw(16) << "live" << std::setw(14) << "peak" << std::setw(14) << "soft"
+                << std::setw(14) << "hard" << std::endl;
+            printedHeader = true;
+        }
+        out << "  " << std::left << std::setw(14) << stats.Name << std::right << std::setw(14) << stats.LiveBytes
+            << std::setw(14) << stats.PeakBytes << std::setw(14) << formatBudget(stats.SoftBudget)
+            << std::setw(14) << formatBudget(stats.HardBudget) << std::endl;
+    }
+}
+
+}
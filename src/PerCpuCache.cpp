@@ -0,0 +1,250 @@
+#include "../include/PerCpuCache.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define ALLOCITY_HAS_RSEQ 1
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #if defined(__has_include)
+        #if __has_include(<sys/rseq.h>)
+            #include <sys/rseq.h>
+            #define ALLOCITY_HAS_LIBC_RSEQ 1
+        #endif
+    #endif
+#endif
+
+namespace allocity {
+
+namespace {
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+#if defined(ALLOCITY_HAS_RSEQ)
+
+// The fields of the kernel's struct rseq that the sequences use.
+struct alignas(32) RseqArea {
+    std::uint32_t cpuIdStart;
+    std::uint32_t cpuId;
+    std::uint64_t criticalSection;
+    std::uint32_t flags;
+};
+
+// Must match the signature the thread registered with; glibc uses the
+// same value on x86-64.
+constexpr std::uint32_t RSEQ_SIGNATURE = 0x53053053;
+constexpr std::uint32_t CPU_ID_UNINITIALIZED = static_cast<std::uint32_t>(-1);
+
+thread_local RseqArea t_ownRseqArea;
+// nullptr until the thread's first lookup; UnavailableRseq() afterwards
+// if the thread cannot use rseq.
+thread_local RseqArea* t_rseqArea = nullptr;
+
+RseqArea* UnavailableRseq() {
+    static RseqArea unavailable;
+    return &unavailable;
+}
+
+RseqArea* RegisterThreadRseq() {
+#if defined(ALLOCITY_HAS_LIBC_RSEQ)
+    // glibc 2.35 and later register every thread, after which the kernel
+    // refuses a second registration.
+    if (__rseq_size > 0) {
+        return reinterpret_cast<RseqArea*>(static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+    }
+#endif
+    t_ownRseqArea.cpuId = CPU_ID_UNINITIALIZED;
+    if (syscall(__NR_rseq, &t_ownRseqArea, sizeof(RseqArea), 0, RSEQ_SIGNATURE) == 0) {
+        return &t_ownRseqArea;
+    }
+    return UnavailableRseq();
+}
+
+RseqArea* CurrentRseq() {
+    RseqArea* area = t_rseqArea;
+    if (area == nullptr) {
+        area = t_rseqArea = RegisterThreadRseq();
+    }
+    return area != UnavailableRseq() ? area : nullptr;
+}
+
+#endif
+
+}
+
+PerCpuCache::PerCpuCache(std::size_t classCount, std::size_t capacity)
+    : m_classCount(classCount),
+      m_capacity(capacity),
+      m_cpuCount(0),
+      m_stackStride((capacity + 1) * sizeof(void*)),
+      m_cpuStride(0),
+      m_reservedBytes(0),
+      m_stacks(nullptr) {
+    if (classCount == 0 || capacity == 0) {
+        throw std::invalid_argument("Per-CPU cache must hold at least one block of one size class");
+    }
+#if defined(ALLOCITY_HAS_RSEQ)
+    const long configured = sysconf(_SC_NPROCESSORS_CONF);
+    m_cpuCount = configured > 0 ? static_cast<std::size_t>(configured) : 1;
+#else
+    m_cpuCount = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+#endif
+    // CPUs start on their own cache lines; stacks of CPUs that never run
+    // one of our threads are never touched and stay unbacked.
+    m_cpuStride = (m_classCount * m_stackStride + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    m_reservedBytes = m_cpuCount * m_cpuStride;
+    m_stacks = static_cast<char*>(VirtualMemory::Reserve(m_reservedBytes));
+    VirtualMemory::Commit(m_stacks, m_reservedBytes);
+}
+
+PerCpuCache::~PerCpuCache() {
+    VirtualMemory::Release(m_stacks, m_reservedBytes);
+}
+
+bool PerCpuCache::IsAvailable() {
+#if defined(ALLOCITY_HAS_RSEQ)
+    return CurrentRseq() != nullptr;
+#else
+    return false;
+#endif
+}
+
+#if defined(ALLOCITY_HAS_RSEQ)
+
+// Both sequences register a descriptor covering the instructions from 1:
+// to the committing store, then read the CPU number, find that CPU's stack
+// and update it. The count is stored last, so a sequence the kernel aborts
+// before that store leaves the stack unchanged; the abort handler, which
+// must be preceded by the signature, starts over from the registration.
+
+void* PerCpuCache::Pop(std::size_t sizeClass) {
+    RseqArea* area = CurrentRseq();
+    if (area == nullptr) {
+        return nullptr;
+    }
+    char* classStacks = m_stacks + sizeClass * m_stackStride;
+    void* block;
+    __asm__ __volatile__(
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"
+        ".quad 1f, 2f - 1f, 4f\n\t"
+        ".popsection\n\t"
+        "0:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %[criticalSection]\n\t"
+        "1:\n\t"
+        "movl %[cpuId], %%eax\n\t"
+        "cmpq %[cpuCount], %%rax\n\t"
+        "jae 5f\n\t"
+        "imulq %[cpuStride], %%rax\n\t"
+        "addq %[classStacks], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"
+        "testq %%rcx, %%rcx\n\t"
+        "jz 5f\n\t"
+        "movq (%%rax, %%rcx, 8), %[block]\n\t"
+        "decq %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"
+        "2:\n\t"
+        "jmp 6f\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"
+        ".long %c[signature]\n\t"
+        "4:\n\t"
+        "jmp 0b\n\t"
+        ".popsection\n\t"
+        "5:\n\t"
+        "xorl %k[block], %k[block]\n\t"
+        "6:\n\t"
+        : [block] "=&r"(block), [criticalSection] "=m"(area->criticalSection)
+        : [cpuId] "m"(area->cpuId), [cpuCount] "r"(m_cpuCount), [cpuStride] "r"(m_cpuStride),
+          [classStacks] "r"(classStacks), [signature] "i"(RSEQ_SIGNATURE)
+        : "rax", "rcx", "memory", "cc");
+    return block;
+}
+
+bool PerCpuCache::Push(std::size_t sizeClass, void* block) {
+    RseqArea* area = CurrentRseq();
+    if (area == nullptr) {
+        return false;
+    }
+    char* classStacks = m_stacks + sizeClass * m_stackStride;
+    std::uint32_t pushed;
+    __asm__ __volatile__(
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"
+        ".quad 1f, 2f - 1f, 4f\n\t"
+        ".popsection\n\t"
+        "0:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %[criticalSection]\n\t"
+        "1:\n\t"
+        "movl %[cpuId], %%eax\n\t"
+        "cmpq %[cpuCount], %%rax\n\t"
+        "jae 5f\n\t"
+        "imulq %[cpuStride], %%rax\n\t"
+        "addq %[classStacks], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"
+        "cmpq %[capacity], %%rcx\n\t"
+        "jae 5f\n\t"
+        "movq %[block], 8(%%rax, %%rcx, 8)\n\t"
+        "incq %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"
+        "2:\n\t"
+        "movl $1, %[pushed]\n\t"
+        "jmp 6f\n\t"
+        ".pushsection __rseq_failure, \"ax\"\n\t"
+        ".byte 0x0f, 0xb9, 0x3d\n\t"
+        ".long %c[signature]\n\t"
+        "4:\n\t"
+        "jmp 0b\n\t"
+        ".popsection\n\t"
+        "5:\n\t"
+        "movl $0, %[pushed]\n\t"
+        "6:\n\t"
+        : [pushed] "=&r"(pushed), [criticalSection] "=m"(area->criticalSection)
+        : [cpuId] "m"(area->cpuId), [cpuCount] "r"(m_cpuCount), [cpuStride] "r"(m_cpuStride),
+          [classStacks] "r"(classStacks), [capacity] "r"(m_capacity), [block] "r"(block),
+          [signature] "i"(RSEQ_SIGNATURE)
+        : "rax", "rcx", "memory", "cc");
+    return pushed != 0;
+}
+
+#else
+
+void* PerCpuCache::Pop(std::size_t) {
+    return nullptr;
+}
+
+bool PerCpuCache::Push(std::size_t, void*) {
+    return false;
+}
+
+#endif
+
+void PerCpuCache::Clear() {
+    for (std::size_t cpu = 0; cpu < m_cpuCount; ++cpu) {
+        for (std::size_t sizeClass = 0; sizeClass < m_classCount; ++sizeClass) {
+            // Only written if non-zero, so idle CPUs stay unbacked.
+            std::size_t* count = StackAt(cpu, sizeClass);
+            if (*count != 0) {
+                *count = 0;
+            }
+        }
+    }
+}
+
+std::size_t PerCpuCache::GetCachedBlocks(std::size_t sizeClass) const {
+    std::size_t blocks = 0;
+    for (std::size_t cpu = 0; cpu < m_cpuCount; ++cpu) {
+        blocks += *StackAt(cpu, sizeClass);
+    }
+    return blocks;
+}
+
+}
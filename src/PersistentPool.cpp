@@ -0,0 +1,343 @@
+#include "../include/PersistentPool.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <atomic>
+#include <stdexcept>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace allocity {
+
+namespace {
+
+constexpr std::uint64_t POOL_MAGIC = 0x4C4F4F5059434C41ull;
+constexpr std::uint32_t POOL_VERSION = 1;
+constexpr std::uint32_t STATE_CLEAN = 0;
+constexpr std::uint32_t STATE_OPEN = 1;
+
+}
+
+struct PersistentPool::Header {
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t state;
+    std::uint64_t blockSize;
+    std::uint64_t capacity;
+    std::uint64_t usedBlocks;
+    std::uint64_t highWater;
+    std::uint64_t freeHead;
+    std::uint64_t root;
+    std::uint64_t bitmapOffset;
+    std::uint64_t blocksOffset;
+    std::uint64_t lastBase;
+};
+
+PersistentPool::PersistentPool(const std::string& path, std::size_t blockSize, std::size_t blockCount, void* baseAddress)
+    : m_path(path),
+      m_base(nullptr),
+      m_mappedSize(0),
+      m_header(nullptr),
+      m_bitmap(nullptr),
+      m_blocks(nullptr),
+      m_created(false),
+      m_recovered(false),
+      m_relocated(false)
+#if defined(_WIN32)
+      , m_file(nullptr),
+      m_mapping(nullptr)
+#endif
+{
+    if (blockSize < sizeof(std::uint64_t)) {
+        throw std::invalid_argument("Block size must be at least the size of an offset");
+    }
+    if (blockCount == 0) {
+        throw std::invalid_argument("Persistent pool must hold at least one block");
+    }
+    blockSize = AlignUp(blockSize, BLOCK_ALIGNMENT);
+
+    const std::size_t bitmapOffset = AlignUp(sizeof(Header), alignof(std::uint64_t));
+    const std::size_t bitmapWords = (blockCount + 63) / 64;
+    const std::size_t blocksOffset = AlignUp(bitmapOffset + bitmapWords * sizeof(std::uint64_t), VirtualMemory::PageSize());
+    const std::size_t totalSize = blocksOffset + blockSize * blockCount;
+
+    Map(totalSize, baseAddress);
+    m_header = reinterpret_cast<Header*>(m_base);
+    m_bitmap = reinterpret_cast<std::uint64_t*>(m_base + bitmapOffset);
+    m_blocks = m_base + blocksOffset;
+
+    // A zero magic means a previous run crashed before formatting the file.
+    if (m_created || m_header->magic == 0) {
+        m_created = true;
+        Format(blockSize, blockCount, bitmapOffset, blocksOffset);
+    } else {
+        if (m_header->magic != POOL_MAGIC || m_header->version != POOL_VERSION) {
+            Unmap();
+            throw std::runtime_error("Not a persistent pool file: " + path);
+        }
+        if (m_header->blockSize != blockSize || m_header->capacity != blockCount ||
+            m_header->bitmapOffset != bitmapOffset || m_header->blocksOffset != blocksOffset) {
+            Unmap();
+            throw std::runtime_error("Persistent pool geometry does not match file: " + path);
+        }
+        m_relocated = m_header->lastBase != reinterpret_cast<std::uintptr_t>(m_base);
+        if (m_header->state != STATE_CLEAN) {
+            Recover();
+            m_recovered = true;
+        }
+    }
+
+    m_header->lastBase = reinterpret_cast<std::uintptr_t>(m_base);
+    m_header->state = STATE_OPEN;
+}
+
+PersistentPool::~PersistentPool() {
+    if (m_base == nullptr) return;
+    Sync();
+    m_header->state = STATE_CLEAN;
+#if defined(_WIN32)
+    FlushViewOfFile(m_base, VirtualMemory::PageSize());
+#else
+    msync(m_base, VirtualMemory::PageSize(), MS_SYNC);
+#endif
+    Unmap();
+}
+
+void PersistentPool::Map(std::size_t size, void* baseAddress) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open persistent pool file: " + m_path);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to query persistent pool file: " + m_path);
+    }
+    if (fileSize.QuadPart == 0) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to size persistent pool file: " + m_path);
+        }
+        m_created = true;
+    } else if (static_cast<std::size_t>(fileSize.QuadPart) != size) {
+        CloseHandle(file);
+        throw std::runtime_error("Persistent pool geometry does not match file: " + m_path);
+    }
+    const ULONGLONG mappingSize = static_cast<ULONGLONG>(size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(mappingSize >> 32),
+                                        static_cast<DWORD>(mappingSize & 0xFFFFFFFFull), nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map persistent pool file: " + m_path);
+    }
+    void* view = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, baseAddress);
+    if (view == nullptr && baseAddress != nullptr) {
+        view = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, nullptr);
+    }
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map persistent pool file: " + m_path);
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_base = static_cast<char*>(view);
+#else
+    const int fd = open(m_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open persistent pool file: " + m_path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to query persistent pool file: " + m_path);
+    }
+    if (info.st_size == 0) {
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to size persistent pool file: " + m_path);
+        }
+        m_created = true;
+    } else if (static_cast<std::size_t>(info.st_size) != size) {
+        close(fd);
+        throw std::runtime_error("Persistent pool geometry does not match file: " + m_path);
+    }
+    // Without MAP_FIXED the base address is only a hint; the kernel honours
+    // it when the range is free and picks another address otherwise.
+    void* address = mmap(baseAddress, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Failed to map persistent pool file: " + m_path);
+    }
+    m_base = static_cast<char*>(address);
+#endif
+    m_mappedSize = size;
+}
+
+void PersistentPool::Unmap() {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_base);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    CloseHandle(static_cast<HANDLE>(m_file));
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap(m_base, m_mappedSize);
+#endif
+    m_base = nullptr;
+    m_header = nullptr;
+}
+
+void PersistentPool::Format(std::size_t blockSize, std::size_t blockCount, std::size_t bitmapOffset,
+                            std::size_t blocksOffset) {
+    // The file was just extended with zeros, so the bitmap is already clear
+    // and blocks are handed out from the high-water mark without a pass
+    // over the file.
+    m_header->version = POOL_VERSION;
+    m_header->state = STATE_OPEN;
+    m_header->blockSize = blockSize;
+    m_header->capacity = blockCount;
+    m_header->usedBlocks = 0;
+    m_header->highWater = 0;
+    m_header->freeHead = NULL_OFFSET;
+    m_header->root = NULL_OFFSET;
+    m_header->bitmapOffset = bitmapOffset;
+    m_header->blocksOffset = blocksOffset;
+    // The magic is published last: a crash before this store leaves it
+    // zero, and the next open formats the file again.
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = POOL_MAGIC;
+}
+
+void PersistentPool::Recover() {
+    // Allocate sets the bitmap bit after unlinking a block and Deallocate
+    // clears it before relinking, so a crash between the two steps leaves
+    // the block free in the bitmap and it is simply relinked here.
+    const std::size_t highWater = static_cast<std::size_t>(m_header->highWater);
+    std::uint64_t freeHead = NULL_OFFSET;
+    std::size_t used = 0;
+    for (std::size_t i = highWater; i-- > 0;) {
+        if (m_bitmap[i / 64] & (std::uint64_t(1) << (i % 64))) {
+            ++used;
+            continue;
+        }
+        char* block = m_blocks + i * m_header->blockSize;
+        *reinterpret_cast<std::uint64_t*>(block) = freeHead;
+        freeHead = static_cast<std::uint64_t>(block - m_base);
+    }
+    m_header->freeHead = freeHead;
+    m_header->usedBlocks = used;
+    if (m_header->root != NULL_OFFSET && !Owns(m_base + m_header->root)) {
+        m_header->root = NULL_OFFSET;
+    }
+}
+
+void* PersistentPool::Allocate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    char* block = nullptr;
+    if (m_header->freeHead != NULL_OFFSET) {
+        block = m_base + m_header->freeHead;
+        m_header->freeHead = *reinterpret_cast<std::uint64_t*>(block);
+    } else if (m_header->highWater < m_header->capacity) {
+        block = m_blocks + m_header->highWater * m_header->blockSize;
+        ++m_header->highWater;
+    } else {
+        return nullptr;
+    }
+    const std::size_t index = BlockIndex(block);
+    m_bitmap[index / 64] |= std::uint64_t(1) << (index % 64);
+    ++m_header->usedBlocks;
+    return block;
+}
+
+void PersistentPool::Deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+    if (!Owns(ptr)) {
+        throw std::invalid_argument("Pointer does not belong to this persistent pool");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::size_t index = BlockIndex(ptr);
+    const std::uint64_t bit = std::uint64_t(1) << (index % 64);
+    if ((m_bitmap[index / 64] & bit) == 0) {
+        throw std::invalid_argument("Double free detected in persistent pool");
+    }
+    m_bitmap[index / 64] &= ~bit;
+    *static_cast<std::uint64_t*>(ptr) = m_header->freeHead;
+    m_header->freeHead = static_cast<std::uint64_t>(static_cast<char*>(ptr) - m_base);
+    --m_header->usedBlocks;
+}
+
+bool PersistentPool::Owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    if (p < m_blocks || p >= m_base + m_mappedSize) {
+        return false;
+    }
+    return static_cast<std::size_t>(p - m_blocks) % m_header->blockSize == 0;
+}
+
+std::size_t PersistentPool::BlockIndex(const void* ptr) const {
+    return static_cast<std::size_t>(static_cast<const char*>(ptr) - m_blocks) / m_header->blockSize;
+}
+
+std::uint64_t PersistentPool::ToOffset(const void* ptr) const {
+    if (ptr == nullptr) return NULL_OFFSET;
+    const char* p = static_cast<const char*>(ptr);
+    if (p < m_blocks || p >= m_base + m_mappedSize) {
+        throw std::invalid_argument("Pointer does not belong to this persistent pool");
+    }
+    return static_cast<std::uint64_t>(p - m_base);
+}
+
+void* PersistentPool::FromOffset(std::uint64_t offset) const {
+    if (offset == NULL_OFFSET) return nullptr;
+    if (offset < m_header->blocksOffset || offset >= m_mappedSize) {
+        throw std::out_of_range("Offset lies outside the persistent pool");
+    }
+    return m_base + offset;
+}
+
+void PersistentPool::SetRoot(const void* ptr) {
+    const std::uint64_t offset = ToOffset(ptr);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_header->root = offset;
+}
+
+void* PersistentPool::GetRoot() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return FromOffset(m_header->root);
+}
+
+void PersistentPool::Sync() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+#if defined(_WIN32)
+    FlushViewOfFile(m_base, 0);
+    FlushFileBuffers(static_cast<HANDLE>(m_file));
+#else
+    msync(m_base, m_mappedSize, MS_SYNC);
+#endif
+}
+
+std::size_t PersistentPool::GetBlockSize() const {
+    return static_cast<std::size_t>(m_header->blockSize);
+}
+
+std::size_t PersistentPool::GetCapacity() const {
+    return static_cast<std::size_t>(m_header->capacity);
+}
+
+std::size_t PersistentPool::GetUsedBlocks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<std::size_t>(m_header->usedBlocks);
+}
+
+}
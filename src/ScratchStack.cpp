@@ -0,0 +1,136 @@
+#include "../include/ScratchStack.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace allocity {
+
+ScratchStack::ScratchStack(std::size_t chunkSize)
+    : m_chunkSize(AlignUp(std::max(chunkSize, sizeof(Chunk)), VirtualMemory::PageSize())),
+      m_retainLimit(UNLIMITED),
+      m_head(nullptr),
+      m_tail(nullptr),
+      m_current(nullptr),
+      m_offset(0),
+      m_capacity(0),
+      m_reservedBytes(0),
+      m_chunkCount(0),
+      m_highWaterBytes(0) {}
+
+ScratchStack::~ScratchStack() {
+    while (m_head != nullptr) {
+        Chunk* next = m_head->next;
+        VirtualMemory::Release(m_head, m_head->size);
+        m_head = next;
+    }
+}
+
+ScratchStack& ScratchStack::ForThread() {
+    thread_local ScratchStack stack;
+    return stack;
+}
+
+void* ScratchStack::AllocateSlow(std::size_t size, std::size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > VirtualMemory::PageSize()) {
+        throw std::invalid_argument("Scratch alignment must be a power of two no larger than a page");
+    }
+    const std::size_t header = AlignUp(sizeof(Chunk), alignment);
+    if (size > SIZE_MAX - header - VirtualMemory::PageSize()) {
+        throw std::bad_alloc();
+    }
+    const std::size_t needed = header + size;
+
+    // Spares left by an earlier rewind are reused in order; one that is
+    // too small for this request is unmapped rather than skipped.
+    Chunk* next = m_current != nullptr ? m_current->next : m_head;
+    while (next != nullptr && next->size < needed) {
+        Chunk* after = next->next;
+        ReleaseChunk(next);
+        next = after;
+    }
+    if (next == nullptr) {
+        next = CreateChunk(needed);
+    }
+
+    next->base = GetUsedBytes();
+    m_current = next;
+    m_capacity = next->size;
+    m_offset = header + size;
+    return reinterpret_cast<char*>(next) + header;
+}
+
+ScratchStack::Chunk* ScratchStack::CreateChunk(std::size_t minimumSize) {
+    const std::size_t size = std::max(m_chunkSize, AlignUp(minimumSize, VirtualMemory::PageSize()));
+    void* memory = VirtualMemory::Reserve(size);
+    VirtualMemory::Commit(memory, size);
+
+    Chunk* chunk = static_cast<Chunk*>(memory);
+    chunk->previous = m_current;
+    chunk->next = m_current != nullptr ? m_current->next : m_head;
+    chunk->size = size;
+    chunk->base = 0;
+    if (chunk->previous != nullptr) {
+        chunk->previous->next = chunk;
+    } else {
+        m_head = chunk;
+    }
+    if (chunk->next != nullptr) {
+        chunk->next->previous = chunk;
+    } else {
+        m_tail = chunk;
+    }
+    m_reservedBytes += size;
+    ++m_chunkCount;
+    return chunk;
+}
+
+void ScratchStack::ReleaseChunk(Chunk* chunk) {
+    if (chunk->previous != nullptr) {
+        chunk->previous->next = chunk->next;
+    } else {
+        m_head = chunk->next;
+    }
+    if (chunk->next != nullptr) {
+        chunk->next->previous = chunk->previous;
+    } else {
+        m_tail = chunk->previous;
+    }
+    m_reservedBytes -= chunk->size;
+    --m_chunkCount;
+    VirtualMemory::Release(chunk, chunk->size);
+}
+
+void ScratchStack::Rewind(const Position& position) {
+    m_highWaterBytes = std::max(m_highWaterBytes, GetUsedBytes());
+    m_current = position.chunk;
+    m_offset = position.offset;
+    m_capacity = m_current != nullptr ? m_current->size : 0;
+    if (m_reservedBytes > m_retainLimit) {
+        ReleaseSpares(m_retainLimit);
+    }
+}
+
+void ScratchStack::ReleaseSpares(std::size_t keepBytes) {
+    while (m_tail != nullptr && m_tail != m_current && m_reservedBytes > keepBytes) {
+        ReleaseChunk(m_tail);
+    }
+}
+
+void ScratchStack::SetRetainLimit(std::size_t bytes) {
+    m_retainLimit = bytes;
+    ReleaseSpares(m_retainLimit);
+}
+
+void ScratchStack::Trim() {
+    ReleaseSpares(0);
+}
+
+std::size_t ScratchStack::GetUsedBytes() const {
+    return m_current != nullptr ? m_current->base + m_offset : 0;
+}
+
+std::size_t ScratchStack::GetHighWaterBytes() const {
+    return std::max(m_highWaterBytes, GetUsedBytes());
+}
+
+}
@@ -0,0 +1,368 @@
+#include "../include/SharedMemoryPool.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#if !defined(_WIN32)
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace allocity {
+
+namespace {
+
+constexpr std::uint64_t SHARED_POOL_MAGIC = 0x4C4F4F5052485341ull;
+constexpr std::uint32_t EMPTY_INDEX = 0xFFFFFFFFu;
+
+std::uint64_t PackHead(std::uint64_t previous, std::uint32_t index) {
+    return (((previous >> 32) + 1) << 32) | index;
+}
+
+#if !defined(_WIN32)
+std::atomic<int> g_processId{0};
+
+void RefreshProcessId() {
+    g_processId.store(static_cast<int>(getpid()), std::memory_order_relaxed);
+}
+
+// getpid() is a system call; cache it and refresh the cache in the child
+// after fork() so owner stamps stay correct.
+int CurrentProcessId() {
+    static const bool registered = [] {
+        RefreshProcessId();
+        pthread_atfork(nullptr, nullptr, RefreshProcessId);
+        return true;
+    }();
+    (void)registered;
+    return g_processId.load(std::memory_order_relaxed);
+}
+
+bool IsProcessAlive(int processId) {
+    return kill(static_cast<pid_t>(processId), 0) == 0 || errno == EPERM;
+}
+#endif
+
+}
+
+struct SharedMemoryPool::Header {
+    std::uint64_t magic;
+    std::uint64_t blockSize;
+    std::uint64_t capacity;
+    std::uint64_t metaOffset;
+    std::uint64_t blocksOffset;
+    std::atomic<std::uint32_t> ready;
+    std::atomic<std::uint64_t> freeHead;
+    std::atomic<std::uint64_t> usedBlocks;
+};
+
+struct SharedMemoryPool::BlockMeta {
+    std::atomic<std::uint32_t> next;
+    std::atomic<std::int32_t> owner;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "SharedMemoryPool requires address-free 64-bit atomics");
+static_assert(std::atomic<std::int32_t>::is_always_lock_free,
+              "SharedMemoryPool requires address-free 32-bit atomics");
+
+std::size_t SharedMemoryPool::MappedSizeFor(std::size_t blockSize, std::size_t blockCount,
+                                            std::size_t& metaOffset, std::size_t& blocksOffset) {
+    if (blockSize == 0 || blockCount == 0) {
+        throw std::invalid_argument("Shared memory pool must hold at least one non-empty block");
+    }
+    if (blockCount >= EMPTY_INDEX) {
+        throw std::invalid_argument("Shared memory pool block count exceeds the index range");
+    }
+    // blockSize is already a multiple of BLOCK_ALIGNMENT, so every block
+    // starts aligned.
+    metaOffset = AlignUp(sizeof(Header), alignof(BlockMeta));
+    blocksOffset = AlignUp(metaOffset + blockCount * sizeof(BlockMeta), VirtualMemory::PageSize());
+    return blocksOffset + blockSize * blockCount;
+}
+
+#if defined(_WIN32)
+
+SharedMemoryPool::SharedMemoryPool(std::size_t, std::size_t)
+    : m_fd(-1), m_base(nullptr), m_mappedSize(0), m_header(nullptr), m_meta(nullptr), m_blocks(nullptr) {
+    throw std::runtime_error("Shared memory pools are not supported on this platform");
+}
+
+SharedMemoryPool::SharedMemoryPool(const std::string&, std::size_t, std::size_t)
+    : m_fd(-1), m_base(nullptr), m_mappedSize(0), m_header(nullptr), m_meta(nullptr), m_blocks(nullptr) {
+    throw std::runtime_error("Shared memory pools are not supported on this platform");
+}
+
+SharedMemoryPool::~SharedMemoryPool() = default;
+
+void SharedMemoryPool::Unlink(const std::string&) {}
+
+#else
+
+SharedMemoryPool::SharedMemoryPool(std::size_t blockSize, std::size_t blockCount)
+    : m_fd(-1), m_base(nullptr), m_mappedSize(0), m_header(nullptr), m_meta(nullptr), m_blocks(nullptr) {
+    blockSize = AlignUp(blockSize, BLOCK_ALIGNMENT);
+    std::size_t metaOffset = 0;
+    std::size_t blocksOffset = 0;
+    const std::size_t size = MappedSizeFor(blockSize, blockCount, metaOffset, blocksOffset);
+
+#if defined(__linux__)
+    m_fd = memfd_create("allocity-shared-pool", MFD_CLOEXEC);
+#else
+    const std::string name = "/allocity-" + std::to_string(getpid()) + "-" +
+                             std::to_string(reinterpret_cast<std::uintptr_t>(this));
+    m_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (m_fd >= 0) {
+        shm_unlink(name.c_str());
+    }
+#endif
+    if (m_fd < 0) {
+        throw std::runtime_error("Failed to create shared memory object");
+    }
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        close(m_fd);
+        throw std::runtime_error("Failed to size shared memory object");
+    }
+    MapDescriptor(size);
+    Format(blockSize, blockCount, metaOffset, blocksOffset);
+}
+
+SharedMemoryPool::SharedMemoryPool(const std::string& name, std::size_t blockSize, std::size_t blockCount)
+    : m_fd(-1), m_base(nullptr), m_mappedSize(0), m_header(nullptr), m_meta(nullptr), m_blocks(nullptr) {
+    blockSize = AlignUp(blockSize, BLOCK_ALIGNMENT);
+    std::size_t metaOffset = 0;
+    std::size_t blocksOffset = 0;
+    const std::size_t size = MappedSizeFor(blockSize, blockCount, metaOffset, blocksOffset);
+
+    m_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (m_fd >= 0) {
+        if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+            close(m_fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error("Failed to size shared memory object: " + name);
+        }
+        MapDescriptor(size);
+        Format(blockSize, blockCount, metaOffset, blocksOffset);
+        return;
+    }
+    if (errno != EEXIST || (m_fd = shm_open(name.c_str(), O_RDWR, 0600)) < 0) {
+        throw std::runtime_error("Failed to open shared memory object: " + name);
+    }
+
+    // The creator may not have sized the object yet.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    struct stat info;
+    int status;
+    while ((status = fstat(m_fd, &info)) == 0 && static_cast<std::size_t>(info.st_size) < size &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    if (status != 0) {
+        close(m_fd);
+        throw std::runtime_error("Failed to query shared memory object: " + name);
+    }
+    if (static_cast<std::size_t>(info.st_size) != size) {
+        close(m_fd);
+        throw std::runtime_error("Shared memory pool geometry does not match: " + name);
+    }
+    MapDescriptor(size);
+    Attach(blockSize, blockCount);
+}
+
+SharedMemoryPool::~SharedMemoryPool() {
+    munmap(m_base, m_mappedSize);
+    close(m_fd);
+}
+
+void SharedMemoryPool::Unlink(const std::string& name) {
+    shm_unlink(name.c_str());
+}
+
+void SharedMemoryPool::MapDescriptor(std::size_t size) {
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (address == MAP_FAILED) {
+        close(m_fd);
+        throw std::runtime_error("Failed to map shared memory object");
+    }
+    m_base = static_cast<char*>(address);
+    m_mappedSize = size;
+    m_header = reinterpret_cast<Header*>(m_base);
+}
+
+void SharedMemoryPool::Attach(std::size_t blockSize, std::size_t blockCount) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (m_header->ready.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    if (m_header->ready.load(std::memory_order_acquire) == 0 || m_header->magic != SHARED_POOL_MAGIC ||
+        m_header->blockSize != blockSize || m_header->capacity != blockCount) {
+        munmap(m_base, m_mappedSize);
+        close(m_fd);
+        throw std::runtime_error("Shared memory pool geometry does not match");
+    }
+    m_meta = reinterpret_cast<BlockMeta*>(m_base + m_header->metaOffset);
+    m_blocks = m_base + m_header->blocksOffset;
+}
+
+#endif
+
+void SharedMemoryPool::Format(std::size_t blockSize, std::size_t blockCount, std::size_t metaOffset, std::size_t blocksOffset) {
+    m_header = ::new (m_base) Header();
+    m_header->magic = SHARED_POOL_MAGIC;
+    m_header->blockSize = blockSize;
+    m_header->capacity = blockCount;
+    m_header->metaOffset = metaOffset;
+    m_header->blocksOffset = blocksOffset;
+    m_header->freeHead.store(0, std::memory_order_relaxed);
+    m_header->usedBlocks.store(0, std::memory_order_relaxed);
+
+    m_meta = reinterpret_cast<BlockMeta*>(m_base + metaOffset);
+    m_blocks = m_base + blocksOffset;
+    for (std::size_t i = 0; i < blockCount; ++i) {
+        BlockMeta* meta = ::new (&m_meta[i]) BlockMeta();
+        meta->next.store(i + 1 < blockCount ? static_cast<std::uint32_t>(i + 1) : EMPTY_INDEX, std::memory_order_relaxed);
+        meta->owner.store(0, std::memory_order_relaxed);
+    }
+    m_header->ready.store(1, std::memory_order_release);
+}
+
+void* SharedMemoryPool::Allocate() {
+#if defined(_WIN32)
+    return nullptr;
+#else
+    std::uint64_t head = m_header->freeHead.load(std::memory_order_acquire);
+    std::uint32_t index;
+    for (;;) {
+        index = static_cast<std::uint32_t>(head);
+        if (index == EMPTY_INDEX) {
+            return nullptr;
+        }
+        const std::uint32_t next = m_meta[index].next.load(std::memory_order_relaxed);
+        if (m_header->freeHead.compare_exchange_weak(head, PackHead(head, next),
+                                                     std::memory_order_acquire, std::memory_order_acquire)) {
+            break;
+        }
+    }
+    m_meta[index].owner.store(CurrentProcessId(), std::memory_order_release);
+    m_header->usedBlocks.fetch_add(1, std::memory_order_relaxed);
+    return m_blocks + static_cast<std::size_t>(index) * m_header->blockSize;
+#endif
+}
+
+void SharedMemoryPool::Push(std::uint32_t index) {
+    std::uint64_t head = m_header->freeHead.load(std::memory_order_relaxed);
+    do {
+        m_meta[index].next.store(static_cast<std::uint32_t>(head), std::memory_order_relaxed);
+    } while (!m_header->freeHead.compare_exchange_weak(head, PackHead(head, index),
+                                                       std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SharedMemoryPool::Deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+    if (!Owns(ptr)) {
+        throw std::invalid_argument("Pointer does not belong to this shared memory pool");
+    }
+    const std::size_t index = BlockIndex(ptr);
+    std::int32_t owner = m_meta[index].owner.load(std::memory_order_relaxed);
+    do {
+        if (owner == 0) {
+            throw std::invalid_argument("Double free detected in shared memory pool");
+        }
+    } while (!m_meta[index].owner.compare_exchange_weak(owner, 0, std::memory_order_acq_rel, std::memory_order_relaxed));
+    m_header->usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+    Push(static_cast<std::uint32_t>(index));
+}
+
+void SharedMemoryPool::Transfer(const void* ptr, int processId) {
+    if (!Owns(ptr) || processId <= 0) {
+        throw std::invalid_argument("Invalid shared memory block transfer");
+    }
+    std::atomic<std::int32_t>& owner = m_meta[BlockIndex(ptr)].owner;
+    std::int32_t current = owner.load(std::memory_order_relaxed);
+    do {
+        if (current == 0) {
+            throw std::invalid_argument("Cannot transfer a free shared memory block");
+        }
+    } while (!owner.compare_exchange_weak(current, processId, std::memory_order_acq_rel, std::memory_order_relaxed));
+}
+
+int SharedMemoryPool::GetOwner(const void* ptr) const {
+    if (!Owns(ptr)) {
+        throw std::invalid_argument("Pointer does not belong to this shared memory pool");
+    }
+    return m_meta[BlockIndex(ptr)].owner.load(std::memory_order_acquire);
+}
+
+std::size_t SharedMemoryPool::RecoverDeadOwners() {
+#if defined(_WIN32)
+    return 0;
+#else
+    // A process id can be reused after its owner exits; recovery only
+    // looks at whether some process with that id is alive.
+    std::size_t recovered = 0;
+    const std::size_t capacity = static_cast<std::size_t>(m_header->capacity);
+    for (std::size_t i = 0; i < capacity; ++i) {
+        std::int32_t owner = m_meta[i].owner.load(std::memory_order_acquire);
+        if (owner == 0 || IsProcessAlive(owner)) {
+            continue;
+        }
+        if (m_meta[i].owner.compare_exchange_strong(owner, 0, std::memory_order_acq_rel)) {
+            m_header->usedBlocks.fetch_sub(1, std::memory_order_relaxed);
+            Push(static_cast<std::uint32_t>(i));
+            ++recovered;
+        }
+    }
+    return recovered;
+#endif
+}
+
+bool SharedMemoryPool::Owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    if (p < m_blocks || p >= m_base + m_mappedSize) {
+        return false;
+    }
+    return static_cast<std::size_t>(p - m_blocks) % m_header->blockSize == 0;
+}
+
+std::size_t SharedMemoryPool::BlockIndex(const void* ptr) const {
+    return static_cast<std::size_t>(static_cast<const char*>(ptr) - m_blocks) / m_header->blockSize;
+}
+
+std::uint64_t SharedMemoryPool::ToOffset(const void* ptr) const {
+    if (ptr == nullptr) return NULL_OFFSET;
+    const char* p = static_cast<const char*>(ptr);
+    if (p < m_blocks || p >= m_base + m_mappedSize) {
+        throw std::invalid_argument("Pointer does not belong to this shared memory pool");
+    }
+    return static_cast<std::uint64_t>(p - m_base);
+}
+
+void* SharedMemoryPool::FromOffset(std::uint64_t offset) const {
+    if (offset == NULL_OFFSET) return nullptr;
+    if (offset < m_header->blocksOffset || offset >= m_mappedSize) {
+        throw std::out_of_range("Offset lies outside the shared memory pool");
+    }
+    return m_base + offset;
+}
+
+std::size_t SharedMemoryPool::GetBlockSize() const {
+    return static_cast<std::size_t>(m_header->blockSize);
+}
+
+std::size_t SharedMemoryPool::GetCapacity() const {
+    return static_cast<std::size_t>(m_header->capacity);
+}
+
+std::size_t SharedMemoryPool::GetUsedBlocks() const {
+    return static_cast<std::size_t>(m_header->usedBlocks.load(std::memory_order_relaxed));
+}
+
+}
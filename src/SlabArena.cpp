@@ -0,0 +1,68 @@
+#include "../include/SlabArena.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+namespace allocity {
+
+SlabArena::SlabArena(bool hugePages, std::size_t regionSize)
+    : m_hugePages(hugePages),
+      m_regionSize(AlignUp(std::max(regionSize, VirtualMemory::HUGE_PAGE_SIZE), VirtualMemory::HUGE_PAGE_SIZE)),
+      m_offset(0),
+      m_usedBytes(0),
+      m_hugePageBytes(0) {}
+
+SlabArena::~SlabArena() {
+    for (const Region& region : m_regions) {
+        VirtualMemory::Release(region.base, region.size);
+    }
+}
+
+void* SlabArena::Allocate(std::size_t size) {
+    if (size == 0) {
+        throw std::invalid_argument("Slab size must be non-zero");
+    }
+    if (size > SIZE_MAX - VirtualMemory::HUGE_PAGE_SIZE) {
+        throw std::bad_alloc();
+    }
+    size = AlignUp(size, VirtualMemory::PageSize());
+    if (m_regions.empty() || size > m_regions.back().size - m_offset) {
+        AddRegion(size);
+    }
+    char* slab = m_regions.back().base + m_offset;
+    VirtualMemory::Commit(slab, size);
+    m_offset += size;
+    m_usedBytes += size;
+    return slab;
+}
+
+void SlabArena::AddRegion(std::size_t minimumSize) {
+    // The tail of the previous region is abandoned; slabs are at most a
+    // few huge pages while regions are tens of them.
+    const std::size_t size = std::max(m_regionSize, AlignUp(minimumSize, VirtualMemory::HUGE_PAGE_SIZE));
+    m_regions.reserve(m_regions.size() + 1);
+    char* base = static_cast<char*>(VirtualMemory::ReserveAligned(size, VirtualMemory::HUGE_PAGE_SIZE));
+    m_regions.push_back({base, size});
+    m_offset = 0;
+    if (m_hugePages && VirtualMemory::AdviseHugePages(base, size)) {
+        m_hugePageBytes += size;
+    }
+}
+
+bool SlabArena::Owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return std::any_of(m_regions.begin(), m_regions.end(),
+                       [p](const Region& region) { return p >= region.base && p < region.base + region.size; });
+}
+
+std::size_t SlabArena::GetReservedBytes() const {
+    std::size_t bytes = 0;
+    for (const Region& region : m_regions) {
+        bytes += region.size;
+    }
+    return bytes;
+}
+
+}
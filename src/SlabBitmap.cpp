@@ -0,0 +1,108 @@
+#include "../include/SlabBitmap.hpp"
+
+namespace allocity {
+
+namespace {
+
+std::size_t PopCount(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_popcountll(value));
+#else
+    std::size_t count = 0;
+    while (value != 0) {
+        value &= value - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+std::size_t CountTrailingZeros(std::uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctzll(value));
+#else
+    std::size_t bit = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+}
+
+SlabBitmap::SlabBitmap(std::size_t capacity)
+    : m_capacity(capacity),
+      m_wordCount((capacity + BITS_PER_WORD - 1) / BITS_PER_WORD),
+      m_words(new std::atomic<std::uint64_t>[m_wordCount]) {
+    ClearAll();
+}
+
+std::uint64_t SlabBitmap::LoadForClearSearch(std::size_t word) const {
+    std::uint64_t value = m_words[word].load(std::memory_order_acquire);
+    const std::size_t validBits = m_capacity - word * BITS_PER_WORD;
+    if (validBits < BITS_PER_WORD) {
+        value |= ~std::uint64_t(0) << validBits;
+    }
+    return value;
+}
+
+std::size_t SlabBitmap::CountSet() const {
+    std::size_t count = 0;
+    for (std::size_t word = 0; word < m_wordCount; ++word) {
+        count += PopCount(m_words[word].load(std::memory_order_relaxed));
+    }
+    return count;
+}
+
+std::size_t SlabBitmap::FindFirstSet(std::size_t start) const {
+    if (start >= m_capacity) {
+        return NOT_FOUND;
+    }
+    std::size_t word = start / BITS_PER_WORD;
+    std::uint64_t bits = m_words[word].load(std::memory_order_acquire) & (~std::uint64_t(0) << (start % BITS_PER_WORD));
+    while (bits == 0) {
+        if (++word == m_wordCount) {
+            return NOT_FOUND;
+        }
+        bits = m_words[word].load(std::memory_order_acquire);
+    }
+    return word * BITS_PER_WORD + CountTrailingZeros(bits);
+}
+
+std::size_t SlabBitmap::FindFirstClear(std::size_t start) const {
+    std::size_t index = NOT_FOUND;
+    FindClear(&index, 1, start);
+    return index;
+}
+
+std::size_t SlabBitmap::FindClear(std::size_t* indices, std::size_t maxCount, std::size_t start) const {
+    if (start >= m_capacity || maxCount == 0) {
+        return 0;
+    }
+    std::size_t found = 0;
+    std::size_t word = start / BITS_PER_WORD;
+    std::uint64_t clear = ~LoadForClearSearch(word) & (~std::uint64_t(0) << (start % BITS_PER_WORD));
+    for (;;) {
+        while (clear != 0) {
+            indices[found++] = word * BITS_PER_WORD + CountTrailingZeros(clear);
+            if (found == maxCount) {
+                return found;
+            }
+            clear &= clear - 1;
+        }
+        if (++word == m_wordCount) {
+            return found;
+        }
+        clear = ~LoadForClearSearch(word);
+    }
+}
+
+void SlabBitmap::ClearAll() {
+    for (std::size_t word = 0; word < m_wordCount; ++word) {
+        m_words[word].store(0, std::memory_order_relaxed);
+    }
+}
+
+}
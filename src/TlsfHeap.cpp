@@ -0,0 +1,343 @@
+#include "../include/TlsfHeap.hpp"
+#include "../include/VirtualMemory.hpp"
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+namespace allocity {
+
+struct TlsfHeap::BlockHeader {
+    BlockHeader* prevPhysical;
+    std::size_t sizeAndFlags;
+    BlockHeader* nextFree;
+    BlockHeader* prevFree;
+
+    static constexpr std::size_t FREE_BIT = 1;
+    static constexpr std::size_t OVERHEAD = sizeof(BlockHeader*) + sizeof(std::size_t);
+    static constexpr std::size_t MIN_SIZE = OVERHEAD + 2 * sizeof(BlockHeader*);
+
+    std::size_t Size() const { return sizeAndFlags & ~FREE_BIT; }
+    bool IsFree() const { return (sizeAndFlags & FREE_BIT) != 0; }
+    void SetSize(std::size_t size) { sizeAndFlags = size | (sizeAndFlags & FREE_BIT); }
+    void SetFree(bool isFree) { sizeAndFlags = isFree ? (sizeAndFlags | FREE_BIT) : (sizeAndFlags & ~FREE_BIT); }
+
+    BlockHeader* NextPhysical() {
+        return reinterpret_cast<BlockHeader*>(reinterpret_cast<char*>(this) + Size());
+    }
+
+    void* Payload() { return reinterpret_cast<char*>(this) + OVERHEAD; }
+
+    static BlockHeader* FromPayload(const void* ptr) {
+        return reinterpret_cast<BlockHeader*>(const_cast<char*>(static_cast<const char*>(ptr)) - OVERHEAD);
+    }
+};
+
+namespace {
+
+int FindLastSet(std::size_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return value == 0 ? -1 : 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+#else
+    int bit = -1;
+    while (value != 0) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+int FindFirstSet(std::uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return value == 0 ? -1 : __builtin_ctz(value);
+#else
+    for (int bit = 0; bit < 32; ++bit) {
+        if (value & (std::uint32_t(1) << bit)) return bit;
+    }
+    return -1;
+#endif
+}
+
+StandardBlock DescribeArenaBlock(std::size_t arenaIndex, std::size_t size, bool isFree) {
+    std::variant<int, double, std::string> define = static_cast<int>(arenaIndex);
+    return StandardBlock(std::move(define), "tlsf", 1, size, isFree, nullptr, nullptr);
+}
+
+}
+
+TlsfHeap::TlsfHeap(std::size_t arenaSize)
+    : m_arenaSize(AlignUp(arenaSize, ALIGNMENT)), m_flBitmap(0), m_arenaBytes(0), m_usedBytes(0) {
+    if (m_arenaSize < SMALL_BLOCK_SIZE || m_arenaSize >= (std::size_t(1) << FL_INDEX_MAX)) {
+        throw std::invalid_argument("TLSF arena size out of range");
+    }
+    for (std::size_t fl = 0; fl < FL_INDEX_COUNT; ++fl) {
+        m_slBitmap[fl] = 0;
+        for (std::size_t sl = 0; sl < SL_INDEX_COUNT; ++sl) {
+            m_freeLists[fl][sl] = nullptr;
+        }
+    }
+}
+
+TlsfHeap::~TlsfHeap() {
+    for (const Arena& arena : m_arenas) {
+        std::free(arena.memory);
+    }
+}
+
+std::size_t TlsfHeap::BlockSizeFor(std::size_t size) {
+    const std::size_t blockSize = AlignUp(size + BlockHeader::OVERHEAD, ALIGNMENT);
+    return blockSize < BlockHeader::MIN_SIZE ? BlockHeader::MIN_SIZE : blockSize;
+}
+
+void TlsfHeap::MappingInsert(std::size_t size, std::size_t& fl, std::size_t& sl) {
+    if (size < SMALL_BLOCK_SIZE) {
+        fl = 0;
+        sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+    } else {
+        const std::size_t msb = static_cast<std::size_t>(FindLastSet(size));
+        sl = (size >> (msb - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        fl = msb - (FL_INDEX_SHIFT - 1);
+    }
+}
+
+void TlsfHeap::MappingSearch(std::size_t size, std::size_t& fl, std::size_t& sl) {
+    if (size >= SMALL_BLOCK_SIZE) {
+        const std::size_t round = (std::size_t(1) << (FindLastSet(size) - SL_INDEX_COUNT_LOG2)) - 1;
+        size += round;
+    }
+    MappingInsert(size, fl, sl);
+}
+
+TlsfHeap::BlockHeader* TlsfHeap::FindSuitableBlock(std::size_t& fl, std::size_t& sl) const {
+    if (fl >= FL_INDEX_COUNT) {
+        return nullptr;
+    }
+    std::uint32_t slMap = m_slBitmap[fl] & (~std::uint32_t(0) << sl);
+    if (slMap == 0) {
+        const std::uint32_t flMap = fl + 1 < 32 ? m_flBitmap & (~std::uint32_t(0) << (fl + 1)) : 0;
+        if (flMap == 0) {
+            return nullptr;
+        }
+        fl = static_cast<std::size_t>(FindFirstSet(flMap));
+        slMap = m_slBitmap[fl];
+    }
+    sl = static_cast<std::size_t>(FindFirstSet(slMap));
+    return m_freeLists[fl][sl];
+}
+
+void TlsfHeap::InsertFreeBlock(BlockHeader* block) {
+    std::size_t fl, sl;
+    MappingInsert(block->Size(), fl, sl);
+    BlockHeader* head = m_freeLists[fl][sl];
+    block->nextFree = head;
+    block->prevFree = nullptr;
+    if (head) {
+        head->prevFree = block;
+    }
+    m_freeLists[fl][sl] = block;
+    m_flBitmap |= std::uint32_t(1) << fl;
+    m_slBitmap[fl] |= std::uint32_t(1) << sl;
+}
+
+void TlsfHeap::RemoveFreeBlock(BlockHeader* block) {
+    std::size_t fl, sl;
+    MappingInsert(block->Size(), fl, sl);
+    RemoveFreeBlock(block, fl, sl);
+}
+
+void TlsfHeap::RemoveFreeBlock(BlockHeader* block, std::size_t fl, std::size_t sl) {
+    if (block->prevFree) {
+        block->prevFree->nextFree = block->nextFree;
+    } else {
+        m_freeLists[fl][sl] = block->nextFree;
+        if (block->nextFree == nullptr) {
+            m_slBitmap[fl] &= ~(std::uint32_t(1) << sl);
+            if (m_slBitmap[fl] == 0) {
+                m_flBitmap &= ~(std::uint32_t(1) << fl);
+            }
+        }
+    }
+    if (block->nextFree) {
+        block->nextFree->prevFree = block->prevFree;
+    }
+}
+
+TlsfHeap::BlockHeader* TlsfHeap::AddArena(std::size_t minimumBlockSize) {
+    std::size_t arenaSize = m_arenaSize;
+    if (minimumBlockSize + BlockHeader::OVERHEAD > arenaSize) {
+        arenaSize = AlignUp(minimumBlockSize + BlockHeader::OVERHEAD, ALIGNMENT);
+    }
+    if (arenaSize >= (std::size_t(1) << FL_INDEX_MAX)) {
+        return nullptr;
+    }
+
+    char* memory = static_cast<char*>(std::malloc(arenaSize));
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    m_arenas.push_back({memory, arenaSize});
+    m_arenaRanges.emplace(memory, arenaSize);
+    m_arenaBytes += arenaSize;
+
+    auto* block = reinterpret_cast<BlockHeader*>(memory);
+    block->prevPhysical = nullptr;
+    block->sizeAndFlags = arenaSize - BlockHeader::OVERHEAD;
+    block->SetFree(true);
+
+    BlockHeader* sentinel = block->NextPhysical();
+    sentinel->prevPhysical = block;
+    sentinel->sizeAndFlags = 0;
+
+    InsertFreeBlock(block);
+    return block;
+}
+
+void* TlsfHeap::Allocate(std::size_t size) {
+    if (size == 0 || size >= (std::size_t(1) << FL_INDEX_MAX)) {
+        return nullptr;
+    }
+    const std::size_t blockSize = BlockSizeFor(size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::size_t fl, sl;
+    MappingSearch(blockSize, fl, sl);
+    BlockHeader* block = FindSuitableBlock(fl, sl);
+    if (block != nullptr) {
+        RemoveFreeBlock(block, fl, sl);
+    } else {
+        block = AddArena(blockSize);
+        if (block == nullptr) {
+            return nullptr;
+        }
+        RemoveFreeBlock(block);
+    }
+
+    const std::size_t remaining = block->Size() - blockSize;
+    if (remaining >= BlockHeader::MIN_SIZE) {
+        BlockHeader* next = block->NextPhysical();
+        block->SetSize(blockSize);
+
+        BlockHeader* rest = block->NextPhysical();
+        rest->prevPhysical = block;
+        rest->sizeAndFlags = remaining;
+        rest->SetFree(true);
+        next->prevPhysical = rest;
+        InsertFreeBlock(rest);
+    }
+
+    block->SetFree(false);
+    m_usedBytes += block->Size();
+    return block->Payload();
+}
+
+void TlsfHeap::Deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!OwnsUnlocked(static_cast<const char*>(ptr))) {
+        throw std::invalid_argument("Pointer does not belong to this TLSF heap");
+    }
+    BlockHeader* block = BlockHeader::FromPayload(ptr);
+    if (block->IsFree()) {
+        throw std::runtime_error("Double free detected in TLSF heap");
+    }
+    m_usedBytes -= block->Size();
+    block->SetFree(true);
+
+    BlockHeader* prev = block->prevPhysical;
+    if (prev && prev->IsFree()) {
+        RemoveFreeBlock(prev);
+        prev->SetSize(prev->Size() + block->Size());
+        block = prev;
+        block->NextPhysical()->prevPhysical = block;
+    }
+
+    BlockHeader* next = block->NextPhysical();
+    if (next->IsFree()) {
+        RemoveFreeBlock(next);
+        block->SetSize(block->Size() + next->Size());
+        block->NextPhysical()->prevPhysical = block;
+    }
+
+    InsertFreeBlock(block);
+}
+
+void TlsfHeap::Reserve(std::size_t bytes, const ArenaCallback& onArenaAdded) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (m_arenaBytes - m_usedBytes < bytes) {
+        if (AddArena(0) == nullptr) {
+            throw std::bad_alloc();
+        }
+        if (onArenaAdded) {
+            onArenaAdded(m_arenas.back().memory, m_arenas.back().size);
+        }
+    }
+}
+
+std::size_t TlsfHeap::GetBlockFootprint(std::size_t size) {
+    return BlockSizeFor(size);
+}
+
+bool TlsfHeap::Owns(const void* ptr) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return OwnsUnlocked(static_cast<const char*>(ptr));
+}
+
+bool TlsfHeap::OwnsUnlocked(const char* ptr) const {
+    auto it = m_arenaRanges.upper_bound(ptr);
+    if (it == m_arenaRanges.begin()) {
+        return false;
+    }
+    --it;
+    return ptr < it->first + it->second;
+}
+
+std::size_t TlsfHeap::GetUsableSize(const void* ptr) const {
+    return BlockHeader::FromPayload(ptr)->Size() - BlockHeader::OVERHEAD;
+}
+
+std::size_t TlsfHeap::GetArenaCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_arenas.size();
+}
+
+std::size_t TlsfHeap::GetArenaBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_arenaBytes;
+}
+
+std::size_t TlsfHeap::GetUsedBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usedBytes;
+}
+
+std::size_t TlsfHeap::GetFreeBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_arenaBytes - m_usedBytes;
+}
+
+std::vector<StandardBlock> TlsfHeap::DescribeBlocks() const {
+    std::vector<StandardBlock> blocks;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::size_t i = 0; i < m_arenas.size(); ++i) {
+        auto* block = reinterpret_cast<BlockHeader*>(m_arenas[i].memory);
+        while (block->Size() != 0) {
+            blocks.push_back(DescribeArenaBlock(i, block->Size(), block->IsFree()));
+            block = block->NextPhysical();
+        }
+    }
+    return blocks;
+}
+
+void TlsfHeap::ForEachBlock(const BlockVisitor& visit) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Arena& arena : m_arenas) {
+        auto* block = reinterpret_cast<BlockHeader*>(arena.memory);
+        while (block->Size() != 0) {
+            visit(block->Payload(), block->Size(), block->IsFree());
+            block = block->NextPhysical();
+        }
+    }
+}
+
+}
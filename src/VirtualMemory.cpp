@@ -0,0 +1,202 @@
+#include "../include/VirtualMemory.hpp"
+#include <cstdint>
+#include <fstream>
+#include <new>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace allocity {
+
+std::size_t VirtualMemory::PageSize() {
+    static const std::size_t pageSize = [] {
+    #if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return static_cast<std::size_t>(info.dwPageSize);
+    #else
+        const long size = sysconf(_SC_PAGESIZE);
+        return size > 0 ? static_cast<std::size_t>(size) : std::size_t(4096);
+    #endif
+    }();
+    return pageSize;
+}
+
+void* VirtualMemory::Reserve(std::size_t size) {
+#if defined(_WIN32)
+    void* address = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (address == nullptr) {
+        throw std::bad_alloc();
+    }
+    return address;
+#else
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (address == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    return address;
+#endif
+}
+
+void* VirtualMemory::ReserveAligned(std::size_t size, std::size_t alignment) {
+    if (alignment <= PageSize()) {
+        return Reserve(size);
+    }
+#if defined(_WIN32)
+    for (;;) {
+        char* probe = static_cast<char*>(Reserve(size + alignment));
+        const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(probe) + alignment - 1) & ~(alignment - 1);
+        Release(probe, size + alignment);
+        void* address = VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE, PAGE_NOACCESS);
+        if (address != nullptr) {
+            return address;
+        }
+    }
+#else
+    char* raw = static_cast<char*>(Reserve(size + alignment));
+    const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(raw) + alignment - 1) & ~(alignment - 1);
+    char* address = reinterpret_cast<char*>(aligned);
+    const std::size_t head = static_cast<std::size_t>(address - raw);
+    if (head != 0) {
+        munmap(raw, head);
+    }
+    const std::size_t tail = alignment - head;
+    if (tail != 0) {
+        munmap(address + size, tail);
+    }
+    return address;
+#endif
+}
+
+void VirtualMemory::Release(void* address, std::size_t size) {
+    if (address == nullptr) return;
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(address, 0, MEM_RELEASE);
+#else
+    munmap(address, size);
+#endif
+}
+
+void VirtualMemory::Commit(void* address, std::size_t size) {
+#if defined(_WIN32)
+    if (VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+        throw std::bad_alloc();
+    }
+#else
+    (void)address;
+    (void)size;
+#endif
+}
+
+void VirtualMemory::Decommit(void* address, std::size_t size) {
+#if defined(_WIN32)
+    VirtualFree(address, size, MEM_DECOMMIT);
+#else
+    madvise(address, size, MADV_DONTNEED);
+#endif
+}
+
+bool VirtualMemory::AdviseHugePages(void* address, std::size_t size) {
+    if (address == nullptr || size == 0) return false;
+#if defined(MADV_HUGEPAGE)
+    return madvise(address, size, MADV_HUGEPAGE) == 0;
+#else
+    (void)address;
+    (void)size;
+    return false;
+#endif
+}
+
+void VirtualMemory::Prefault(void* address, std::size_t size) {
+    if (address == nullptr || size == 0) return;
+    char* begin = static_cast<char*>(address);
+    char* end = begin + size;
+    const std::size_t pageSize = PageSize();
+#if defined(MADV_POPULATE_WRITE)
+    char* pageBegin = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(begin) & ~(pageSize - 1));
+    if (madvise(pageBegin, static_cast<std::size_t>(end - pageBegin), MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    char* page = begin;
+    while (page < end) {
+        volatile char* byte = page;
+        *byte = *byte;
+        page = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(page) & ~(pageSize - 1)) + pageSize);
+    }
+}
+
+bool VirtualMemory::Lock(void* address, std::size_t size) {
+    if (address == nullptr || size == 0) return true;
+#if defined(_WIN32)
+    return VirtualLock(address, size) != 0;
+#else
+    return mlock(address, size) == 0;
+#endif
+}
+
+void VirtualMemory::Unlock(void* address, std::size_t size) {
+    if (address == nullptr || size == 0) return;
+#if defined(_WIN32)
+    VirtualUnlock(address, size);
+#else
+    munlock(address, size);
+#endif
+}
+
+std::vector<bool> VirtualMemory::GetResidentPages(const void* address, std::size_t size) {
+    const std::size_t pageSize = PageSize();
+    const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(address) & ~(pageSize - 1);
+    const std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(address) + size + pageSize - 1) & ~(pageSize - 1);
+    const std::size_t pages = size == 0 ? 0 : static_cast<std::size_t>(end - begin) / pageSize;
+    std::vector<bool> resident(pages, false);
+    if (pages == 0) {
+        return resident;
+    }
+#if defined(_WIN32)
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> info(pages);
+    for (std::size_t i = 0; i < pages; ++i) {
+        info[i].VirtualAddress = reinterpret_cast<void*>(begin + i * pageSize);
+    }
+    if (QueryWorkingSetEx(GetCurrentProcess(), info.data(), static_cast<DWORD>(pages * sizeof(info[0])))) {
+        for (std::size_t i = 0; i < pages; ++i) {
+            resident[i] = info[i].VirtualAttributes.Valid != 0;
+        }
+    }
+#else
+    std::vector<unsigned char> status(pages);
+    if (mincore(reinterpret_cast<void*>(begin), pages * pageSize, status.data()) == 0) {
+        for (std::size_t i = 0; i < pages; ++i) {
+            resident[i] = (status[i] & 1) != 0;
+        }
+    }
+#endif
+    return resident;
+}
+
+std::size_t VirtualMemory::GetResidentBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<std::size_t>(counters.WorkingSetSize);
+    }
+    return 0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    std::size_t totalPages = 0;
+    std::size_t residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        return residentPages * PageSize();
+    }
+    return 0;
+#endif
+}
+
+}
@@ -1,4 +1,22 @@
 #include "../include/Allocator.hpp"
+#include "../include/ObjectPool.hpp"
+#include "../include/MemoryLayout.hpp"
+#include "../include/VariadicLayout.hpp"
+#include "../include/TlsfHeap.hpp"
+#include "../include/BuddyAllocator.hpp"
+#include "../include/VirtualMemory.hpp"
+#include "../include/MemoryManager.hpp"
+#include "../include/MemoryTag.hpp"
+#include "../include/PersistentPool.hpp"
+#include "../include/SharedMemoryPool.hpp"
+#include "../include/Log.hpp"
+#include "../include/SlabBitmap.hpp"
+#include "../include/BulkMemory.hpp"
+#include "../include/EpochDomain.hpp"
+#include "../include/ScratchStack.hpp"
+#include "../include/LockFreeMemoryPool.hpp"
+#include "../include/PerCpuCache.hpp"
+#include "../include/HeapSnapshot.hpp"
 #include <iostream>
 #include <vector>
 #include <chrono>
@@ -7,7 +25,32 @@
 #include <limits>
 #include <iomanip>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
 #include <string>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+#include <future>
+#include <atomic>
+
+#if !defined(_WIN32)
+    #include <sys/resource.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+#endif
 
 void printMemoryUsage(const allocity::Allocator& allocator) {
     std::cout << "Attempting to print memory usage...\n";
@@ -152,6 +195,2129 @@ void largeAllocationTest(allocity::Allocator& allocator) {
         std::cout << std::setw(10) << gb << std::setw(20) << alloc_time << std::setw(20) << dealloc_time << std::endl;
     }
 }
+void latencyHistogramTest(allocity::Allocator& allocator) {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|       Latency Histogram Test       |";
+    std::cout << "\n+------------------------------------+\n";
+
+    allocator.ResetLatencyHistograms();
+    allocator.SetLatencyTracking(true);
+
+    std::vector<void*> pointers;
+    pointers.reserve(512);
+    for (size_t i = 0; i < 512; ++i) {
+        pointers.push_back(allocator.Allocate(i % 2 == 0 ? 64 : 4096));
+    }
+    for (void* ptr : pointers) {
+        allocator.Deallocate(ptr);
+    }
+    void* aligned = allocator.AlignedAllocate(1024, 64);
+    allocator.AlignedDeallocate(aligned);
+
+    std::cout << "p99 pool alloc: "
+              << allocator.GetLatencyPercentile(allocity::LatencyOperation::Allocate, allocity::AllocationPath::Pool, 99.0)
+              << " ns\n";
+    allocator.ReportMemoryUsage();
+
+    // A thread alternating between two timed allocators must find its
+    // shard in each without going back to the recorder.
+    allocity::Allocator other;
+    other.SetLatencyTracking(true);
+    constexpr size_t rounds = 200000;
+    auto timeRounds = [&](allocity::Allocator& second) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < rounds; ++i) {
+            allocity::Allocator& target = i % 2 == 0 ? allocator : second;
+            target.Deallocate(target.Allocate(64));
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() /
+               rounds;
+    };
+    const double oneRecorderNs = timeRounds(allocator);
+    const double twoRecordersNs = timeRounds(other);
+    const std::uint64_t recorded =
+        other.GetLatencyHistogram(allocity::LatencyOperation::Allocate, allocity::AllocationPath::Pool).GetCount() +
+        other.GetLatencyHistogram(allocity::LatencyOperation::Allocate, allocity::AllocationPath::CpuCache).GetCount();
+    std::cout << std::fixed << std::setprecision(1) << "Timed alloc+free, one allocator: " << oneRecorderNs
+              << " ns, alternating two: " << twoRecordersNs << " ns" << std::defaultfloat << "\n";
+    if (recorded != rounds / 2) {
+        std::cout << "Second allocator recorded " << recorded << " of " << rounds / 2 << " allocations\n";
+    }
+    other.SetLatencyTracking(false);
+
+    allocator.SetLatencyTracking(false);
+    allocator.ResetLatencyHistograms();
+}
+
+struct BenchmarkObject {
+    std::uint64_t id;
+    double values[4];
+    BenchmarkObject* next;
+
+    explicit BenchmarkObject(std::uint64_t objectId) : id(objectId), values{0.0, 1.0, 2.0, 3.0}, next(nullptr) {}
+};
+
+void objectPoolBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|       ObjectPool<T> Benchmark      |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t objectCount = 100000;
+    constexpr size_t rounds = 10;
+
+    auto measure = [](auto&& body) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            body();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) /
+               static_cast<double>(objectCount * rounds);
+    };
+
+    std::vector<BenchmarkObject*> raw(objectCount);
+    std::vector<std::unique_ptr<BenchmarkObject>> owned(objectCount);
+
+    allocity::ObjectPool<BenchmarkObject> pool(objectCount);
+    std::vector<allocity::ObjectPool<BenchmarkObject>::UniquePtr> pooled;
+    pooled.reserve(objectCount);
+
+    double newDelete = measure([&] {
+        for (size_t i = 0; i < objectCount; ++i) raw[i] = new BenchmarkObject(i);
+        for (size_t i = 0; i < objectCount; ++i) delete raw[i];
+    });
+
+    double makeUnique = measure([&] {
+        for (size_t i = 0; i < objectCount; ++i) owned[i] = std::make_unique<BenchmarkObject>(i);
+        for (size_t i = 0; i < objectCount; ++i) owned[i].reset();
+    });
+
+    double poolCreate = measure([&] {
+        for (size_t i = 0; i < objectCount; ++i) raw[i] = pool.Create(i);
+        for (size_t i = 0; i < objectCount; ++i) pool.Destroy(raw[i]);
+    });
+
+    double poolUnique = measure([&] {
+        for (size_t i = 0; i < objectCount; ++i) pooled.push_back(pool.MakeUnique(i));
+        pooled.clear();
+    });
+
+    std::cout << "Object size: " << sizeof(BenchmarkObject) << " B, pool block size: "
+              << allocity::ObjectPool<BenchmarkObject>::BLOCK_SIZE << " B\n";
+    std::cout << std::setw(30) << "Method" << std::setw(25) << "Create+Destroy (ns/obj)" << std::endl;
+    std::cout << std::string(55, '-') << std::endl;
+    std::cout << std::setw(30) << "new/delete" << std::setw(25) << newDelete << std::endl;
+    std::cout << std::setw(30) << "std::make_unique" << std::setw(25) << makeUnique << std::endl;
+    std::cout << std::setw(30) << "ObjectPool Create/Destroy" << std::setw(25) << poolCreate << std::endl;
+    std::cout << std::setw(30) << "ObjectPool MakeUnique" << std::setw(25) << poolUnique << std::endl;
+}
+
+struct ParticleRow {
+    float x;
+    float y;
+    float z;
+    std::int32_t id;
+};
+
+void soaColumnBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|    AoS vs SoA Column Benchmark     |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t rowCount = 4 * 1024 * 1024;
+    constexpr size_t scans = 10;
+
+    allocity::Allocator allocator;
+    allocity::MemoryLayout layout;
+    layout.AddColumn<float>("x").AddColumn<float>("y").AddColumn<float>("z").AddColumn<std::int32_t>("id");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto* rows = static_cast<ParticleRow*>(allocator.Allocate(rowCount * sizeof(ParticleRow)));
+    auto end = std::chrono::high_resolution_clock::now();
+    auto aosAllocTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    allocity::ColumnRegion columns = layout.AllocateColumns(allocator, rowCount);
+    end = std::chrono::high_resolution_clock::now();
+    auto soaAllocTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    columns.Resize(rowCount);
+
+    allocity::ColumnSpan<float> xs = columns.GetColumn<float>("x");
+    for (size_t i = 0; i < rowCount; ++i) {
+        rows[i] = {static_cast<float>(i), 1.0f, 2.0f, static_cast<std::int32_t>(i)};
+        xs[i] = static_cast<float>(i);
+    }
+
+    volatile float sink = 0.0f;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t scan = 0; scan < scans; ++scan) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < rowCount; ++i) {
+            sum += rows[i].x;
+        }
+        sink = sink + sum;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    auto aosScanTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t scan = 0; scan < scans; ++scan) {
+        const float* data = xs.Data();
+        float sum = 0.0f;
+        for (size_t i = 0; i < rowCount; ++i) {
+            sum += data[i];
+        }
+        sink = sink + sum;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    auto soaScanTime = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    auto rowsPerMicrosecond = [](long long micros) {
+        return micros > 0 ? static_cast<double>(rowCount * scans) / static_cast<double>(micros) : 0.0;
+    };
+
+    std::cout << "Rows: " << rowCount << ", columns: " << columns.GetColumnCount()
+              << ", region: " << columns.GetRegionSize() / 1024 << " KB\n";
+    std::cout << std::setw(10) << "Layout" << std::setw(20) << "Alloc (us)" << std::setw(20) << "Scan (us)"
+              << std::setw(25) << "Scan (Mrows/s)" << std::endl;
+    std::cout << std::string(75, '-') << std::endl;
+    std::cout << std::setw(10) << "AoS" << std::setw(20) << aosAllocTime << std::setw(20) << aosScanTime
+              << std::setw(25) << rowsPerMicrosecond(aosScanTime) << std::endl;
+    std::cout << std::setw(10) << "SoA" << std::setw(20) << soaAllocTime << std::setw(20) << soaScanTime
+              << std::setw(25) << rowsPerMicrosecond(soaScanTime) << std::endl;
+
+    allocator.Deallocate(rows);
+
+    // Growth past a hard tag budget throws and keeps the old columns.
+    const allocity::MemoryTag budgetTag = allocity::MemoryTags::Register("soa.budget");
+    allocity::MemoryTags::SetBudget(budgetTag, allocity::MemoryTags::NO_BUDGET, 64 * 1024);
+    {
+        allocity::MemoryTagScope scope(budgetTag);
+        allocity::ColumnRegion bounded = layout.AllocateColumns(allocator, 1024);
+        bounded.Resize(1024);
+        allocity::ColumnSpan<float> boundedXs = bounded.GetColumn<float>("x");
+        for (size_t i = 0; i < 1024; ++i) boundedXs[i] = static_cast<float>(i);
+        bool refused = false;
+        try {
+            bounded.Resize(64 * 1024);
+        } catch (const std::bad_alloc&) {
+            refused = true;
+        }
+        bool kept = bounded.GetSize() == 1024 && bounded.GetCapacity() == 1024;
+        const float* data = bounded.GetColumn<float>("x").Data();
+        for (size_t i = 0; i < 1024 && kept; ++i) kept = data[i] == static_cast<float>(i);
+        std::cout << "Growth over a hard budget " << (refused ? "throws bad_alloc" : "DID NOT THROW") << ", columns "
+                  << (kept ? "kept" : "LOST") << "\n";
+    }
+    allocity::MemoryTags::SetBudget(budgetTag, allocity::MemoryTags::NO_BUDGET, allocity::MemoryTags::NO_BUDGET);
+
+    // A capacity whose byte size wraps size_t throws before allocating.
+    {
+        allocity::ColumnRegion small = layout.AllocateColumns(allocator, 16);
+        small.Resize(16);
+        small.GetColumn<float>("x")[15] = 42.0f;
+        bool refused = false;
+        try {
+            small.Reserve(std::numeric_limits<size_t>::max() / 2);
+        } catch (const std::bad_alloc&) {
+            refused = true;
+        }
+        const bool kept = small.GetCapacity() == 16 && small.GetColumn<float>("x")[15] == 42.0f;
+        std::cout << "Overflowing capacity " << (refused ? "throws bad_alloc" : "DID NOT THROW") << ", columns "
+                  << (kept ? "kept" : "LOST") << "\n";
+    }
+}
+
+void tlsfLatencyTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   TLSF Fragmentation Latency Test  |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t liveSlots = 4096;
+    constexpr size_t operations = 200000;
+    constexpr size_t minSize = 257;
+    constexpr size_t maxSize = 64 * 1024;
+
+    struct Workload {
+        std::vector<size_t> sizes;
+        std::vector<size_t> slots;
+    };
+
+    // Random sizes freed in random order keep the free lists fragmented, so
+    // every allocation has to search and every free has to coalesce.
+    Workload workload;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> sizeDist(minSize, maxSize);
+    std::uniform_int_distribution<size_t> slotDist(0, liveSlots - 1);
+    for (size_t i = 0; i < operations; ++i) {
+        workload.sizes.push_back(sizeDist(rng));
+        workload.slots.push_back(slotDist(rng));
+    }
+
+    auto run = [&](auto&& allocate, auto&& deallocate, allocity::LatencyHistogram& allocs,
+                   allocity::LatencyHistogram& frees) {
+        std::vector<void*> live(liveSlots, nullptr);
+        for (size_t i = 0; i < operations; ++i) {
+            void*& slot = live[workload.slots[i]];
+            if (slot != nullptr) {
+                const std::uint64_t start = allocity::LatencyRecorder::ReadTimestamp();
+                deallocate(slot);
+                frees.Record(allocity::LatencyRecorder::ReadTimestamp() - start);
+            }
+            const std::uint64_t start = allocity::LatencyRecorder::ReadTimestamp();
+            slot = allocate(workload.sizes[i]);
+            allocs.Record(allocity::LatencyRecorder::ReadTimestamp() - start);
+            static_cast<char*>(slot)[0] = 1;
+        }
+        for (void* ptr : live) {
+            if (ptr != nullptr) deallocate(ptr);
+        }
+    };
+
+    allocity::TlsfHeap heap;
+    heap.Reserve(liveSlots * maxSize);
+    allocity::LatencyHistogram tlsfAllocs, tlsfFrees, mallocAllocs, mallocFrees;
+    auto tlsfAllocate = [&](size_t size) { return heap.Allocate(size); };
+    auto tlsfDeallocate = [&](void* ptr) { heap.Deallocate(ptr); };
+    auto mallocAllocate = [](size_t size) { return std::malloc(size); };
+    auto mallocDeallocate = [](void* ptr) { std::free(ptr); };
+
+    // The first pass faults the pages in; only the warmed-up pass is reported.
+    run(tlsfAllocate, tlsfDeallocate, tlsfAllocs, tlsfFrees);
+    run(mallocAllocate, mallocDeallocate, mallocAllocs, mallocFrees);
+    for (auto* histogram : {&tlsfAllocs, &tlsfFrees, &mallocAllocs, &mallocFrees}) {
+        histogram->Reset();
+    }
+    run(tlsfAllocate, tlsfDeallocate, tlsfAllocs, tlsfFrees);
+    run(mallocAllocate, mallocDeallocate, mallocAllocs, mallocFrees);
+
+    const double ticksPerNs = allocity::LatencyRecorder::TicksPerNanosecond();
+    auto print = [ticksPerNs](const char* name, const allocity::LatencyHistogram& histogram) {
+        std::cout << std::setw(20) << name
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetValueAtPercentile(50.0) / ticksPerNs)
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetValueAtPercentile(99.9) / ticksPerNs)
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetMax() / ticksPerNs) << std::endl;
+    };
+
+    std::cout << operations << " ops, " << minSize << ".." << maxSize << " B, " << liveSlots << " live slots, "
+              << heap.GetArenaCount() << " TLSF arena(s)\n";
+    std::cout << std::setw(20) << "Latency (ns)" << std::setw(12) << "p50" << std::setw(12) << "p99.9"
+              << std::setw(12) << "max" << std::endl;
+    std::cout << std::string(56, '-') << std::endl;
+    print("TLSF alloc", tlsfAllocs);
+    print("malloc", mallocAllocs);
+    print("TLSF free", tlsfFrees);
+    print("free", mallocFrees);
+}
+
+void buddyChurnBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Buddy vs malloc RSS Churn Test   |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t pageSize = 4096;
+    constexpr size_t maxPages = 512;
+    constexpr size_t liveSlots = 256;
+    constexpr size_t epochs = 8;
+    constexpr size_t operationsPerEpoch = 5000;
+    constexpr double mebibyte = 1024.0 * 1024.0;
+
+    // Page counts are log-uniform over 1..512 (4 KiB..2 MiB), so most
+    // buffers are small while a few large ones keep punching holes.
+    std::vector<size_t> sizes;
+    std::vector<size_t> slots;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> logPages(0.0, std::log2(static_cast<double>(maxPages)));
+    std::uniform_int_distribution<size_t> slotDist(0, liveSlots - 1);
+    for (size_t i = 0; i < epochs * operationsPerEpoch; ++i) {
+        sizes.push_back(static_cast<size_t>(std::exp2(logPages(rng))) * pageSize);
+        slots.push_back(slotDist(rng));
+    }
+
+    auto run = [&](const char* name, auto&& allocate, auto&& deallocate, auto&& report) {
+        std::vector<void*> live(liveSlots, nullptr);
+        std::vector<size_t> liveSizes(liveSlots, 0);
+        size_t liveBytes = 0;
+        const double baseline = static_cast<double>(allocity::VirtualMemory::GetResidentBytes());
+        std::vector<double> rss;
+
+        for (size_t epoch = 0; epoch < epochs; ++epoch) {
+            for (size_t op = epoch * operationsPerEpoch; op < (epoch + 1) * operationsPerEpoch; ++op) {
+                const size_t slot = slots[op];
+                if (live[slot] != nullptr) {
+                    deallocate(live[slot]);
+                    liveBytes -= liveSizes[slot];
+                }
+                live[slot] = allocate(sizes[op]);
+                liveSizes[slot] = sizes[op];
+                liveBytes += sizes[op];
+                for (size_t offset = 0; offset < sizes[op]; offset += pageSize) {
+                    static_cast<char*>(live[slot])[offset] = 1;
+                }
+            }
+            rss.push_back((static_cast<double>(allocity::VirtualMemory::GetResidentBytes()) - baseline) / mebibyte);
+        }
+
+        std::cout << std::setw(8) << name << "  live " << std::fixed << std::setprecision(1)
+                  << static_cast<double>(liveBytes) / mebibyte << " MiB, RSS per epoch (MiB):";
+        for (double value : rss) {
+            std::cout << ' ' << value;
+        }
+        std::cout << "\n          drift after first epoch: " << rss.back() - rss.front() << " MiB, overhead vs live: "
+                  << rss.back() - static_cast<double>(liveBytes) / mebibyte << " MiB" << std::defaultfloat << "\n";
+        report();
+
+        for (void* ptr : live) {
+            if (ptr != nullptr) deallocate(ptr);
+        }
+    };
+
+    {
+        allocity::BuddyAllocator buddy;
+        run("buddy",
+            [&](size_t size) { return buddy.Allocate(size); },
+            [&](void* ptr) { buddy.Deallocate(ptr); },
+            [&] { buddy.ReportFragmentation(std::cout); });
+    }
+    run("malloc",
+        [](size_t size) { return std::malloc(size); },
+        [](void* ptr) { std::free(ptr); },
+        [] {});
+}
+
+void memoryManagerCompactionTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   MemoryManager Compaction Test    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    using Handle = allocity::MemoryManager::Handle;
+    constexpr size_t objectCount = 50000;
+    constexpr double mebibyte = 1024.0 * 1024.0;
+
+    allocity::MemoryManager manager;
+    std::vector<Handle> handles;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<size_t> sizeDist(16, 512);
+
+    for (size_t i = 0; i < objectCount; ++i) {
+        Handle handle = manager.Allocate(sizeDist(rng));
+        auto guard = manager.Acquire(handle);
+        std::memset(guard.Get(), static_cast<int>(i & 0xFF), manager.GetSize(handle));
+        handles.push_back(handle);
+    }
+
+    // A long-lived cache evicting most of its entries leaves every slab sparse.
+    std::vector<std::pair<Handle, size_t>> survivors;
+    for (size_t i = 0; i < handles.size(); ++i) {
+        if (rng() % 10 < 8) {
+            manager.Free(handles[i]);
+        } else {
+            survivors.emplace_back(handles[i], i);
+        }
+    }
+
+    auto report = [&](const char* label) {
+        std::cout << std::setw(18) << label << ": live " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(manager.GetLiveBytes()) / mebibyte << " MiB in "
+                  << manager.GetSlabCount() << " slabs (" << static_cast<double>(manager.GetSlabBytes()) / mebibyte
+                  << " MiB, " << static_cast<double>(manager.GetSlabBytes()) / static_cast<double>(manager.GetLiveBytes())
+                  << "x live)" << std::defaultfloat << "\n";
+    };
+    report("after eviction");
+
+    const Handle pinned = survivors.front().first;
+    void* pinnedAddress = manager.Pin(pinned);
+    const size_t moved = manager.Compact();
+    const bool pinStable = manager.Pin(pinned) == pinnedAddress;
+    manager.Unpin(pinned);
+    manager.Unpin(pinned);
+    report("after Compact()");
+
+    bool intact = true;
+    for (const auto& survivor : survivors) {
+        auto guard = manager.Acquire(survivor.first);
+        const auto* bytes = guard.As<unsigned char>();
+        for (size_t i = 0; i < manager.GetSize(survivor.first); ++i) {
+            if (bytes[i] != static_cast<unsigned char>(survivor.second & 0xFF)) {
+                intact = false;
+                break;
+            }
+        }
+    }
+    std::cout << "Moved " << moved << " bytes, released " << manager.GetReleasedSlabs() << " slabs, pinned object "
+              << (pinStable ? "stayed put" : "MOVED") << ", contents " << (intact ? "intact" : "CORRUPTED") << "\n";
+
+    for (size_t i = 0; i < survivors.size(); i += 2) {
+        manager.Free(survivors[i].first);
+    }
+    report("after more frees");
+    manager.StartBackgroundCompaction(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    manager.StopBackgroundCompaction();
+    report("after idle compact");
+}
+
+void memoryTagBudgetTest(allocity::Allocator& allocator) {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|     Memory Tag and Budget Test     |";
+    std::cout << "\n+------------------------------------+\n";
+
+    const allocity::MemoryTag renderTag = allocity::MemoryTags::Register("render");
+    const allocity::MemoryTag networkTag = allocity::MemoryTags::Register("network");
+    allocity::MemoryTags::SetBudget(networkTag, 256 * 1024, 512 * 1024);
+    allocity::MemoryTags::SetBudgetCallback(networkTag, [](allocity::MemoryTag tag, allocity::BudgetEvent event,
+                                                           size_t liveBytes, size_t requested) {
+        std::cout << "  budget callback: " << allocity::MemoryTags::GetName(tag)
+                  << (event == allocity::BudgetEvent::SoftLimitExceeded ? " crossed soft limit" : " rejected")
+                  << " at " << liveBytes << " live bytes (request " << requested << ")\n";
+    });
+
+    std::vector<void*> renderBuffers;
+    {
+        allocity::MemoryTagScope scope(renderTag);
+        for (size_t i = 0; i < 4096; ++i) {
+            renderBuffers.push_back(allocator.Allocate(64));
+        }
+    }
+
+    std::vector<void*> networkBuffers;
+    size_t rejected = 0;
+    for (size_t i = 0; i < 40; ++i) {
+        void* ptr = allocator.Allocate(32 * 1024 - 64, networkTag);
+        if (ptr == nullptr) {
+            ++rejected;
+        } else {
+            networkBuffers.push_back(ptr);
+        }
+    }
+    allocity::MemoryTags::Flush();
+    std::cout << "network: " << networkBuffers.size() << " buffers granted, " << rejected
+              << " rejected by the hard budget\n";
+
+    const auto invalidTag = static_cast<allocity::MemoryTag>(allocity::MemoryTags::MAX_TAGS);
+    size_t invalidTagRejections = 0;
+    try {
+        allocator.Allocate(64, invalidTag);
+    } catch (const std::out_of_range&) {
+        ++invalidTagRejections;
+    }
+    try {
+        allocator.AlignedAllocate(64, 64, invalidTag);
+    } catch (const std::out_of_range&) {
+        ++invalidTagRejections;
+    }
+    std::cout << "Tag " << invalidTag << " (past MAX_TAGS) " << (invalidTagRejections == 2 ? "rejected" : "ACCEPTED")
+              << " by Allocate and AlignedAllocate\n";
+
+    allocity::MemoryManager manager;
+    std::vector<allocity::MemoryManager::Handle> cacheEntries;
+    for (size_t i = 0; i < 10000; ++i) {
+        cacheEntries.push_back(manager.Allocate(96, renderTag));
+        manager.Allocate(48, allocity::MemoryTags::UNTAGGED);
+    }
+    allocity::MemoryTags::Flush();
+    const size_t slabsBefore = manager.GetSlabCount();
+    const size_t released = manager.ReleaseTag(renderTag);
+    std::cout << "MemoryManager::ReleaseTag(render) dropped " << released << " bytes and "
+              << slabsBefore - manager.GetSlabCount() << " whole slabs; stale handle valid: "
+              << std::boolalpha << manager.IsValid(cacheEntries.front()) << std::noboolalpha << "\n";
+
+    allocity::MemoryTags::Flush();
+    allocity::MemoryTags::Report(std::cout);
+
+    for (void* ptr : renderBuffers) allocator.Deallocate(ptr);
+    for (void* ptr : networkBuffers) allocator.Deallocate(ptr);
+    allocity::MemoryTags::SetBudget(networkTag, allocity::MemoryTags::NO_BUDGET, allocity::MemoryTags::NO_BUDGET);
+}
+
+struct PersistentIndexNode {
+    uint64_t key;
+    uint64_t value;
+    allocity::RelativePtr<PersistentIndexNode> left;
+    allocity::RelativePtr<PersistentIndexNode> right;
+};
+
+void persistentPoolRestartBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|  Persistent Pool Restart Benchmark |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t keyCount = 200000;
+    const std::string path = (std::filesystem::temp_directory_path() / "allocity_persistent_index.pool").string();
+    std::remove(path.c_str());
+
+    std::vector<uint64_t> keys(keyCount);
+    std::mt19937_64 rng(35);
+    for (auto& key : keys) key = rng();
+
+    auto find = [](PersistentIndexNode* node, uint64_t key) {
+        while (node != nullptr && node->key != key) {
+            node = key < node->key ? node->left.Get() : node->right.Get();
+        }
+        return node;
+    };
+
+    void* previousBase = nullptr;
+    double rebuildMs = 0.0;
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        allocity::PersistentPool pool(path, sizeof(PersistentIndexNode), keyCount);
+        PersistentIndexNode* root = nullptr;
+        for (size_t i = 0; i < keyCount; ++i) {
+            auto* node = new (pool.Allocate()) PersistentIndexNode{keys[i], i, nullptr, nullptr};
+            if (root == nullptr) {
+                root = node;
+                continue;
+            }
+            PersistentIndexNode* parent = root;
+            for (;;) {
+                auto& child = keys[i] < parent->key ? parent->left : parent->right;
+                if (!child) {
+                    child = node;
+                    break;
+                }
+                parent = child.Get();
+            }
+        }
+        pool.SetRoot(root);
+        rebuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        previousBase = pool.GetBaseAddress();
+    }
+
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        allocity::PersistentPool pool(path, sizeof(PersistentIndexNode), keyCount, previousBase);
+        auto* root = static_cast<PersistentIndexNode*>(pool.GetRoot());
+        const double reopenMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        size_t found = 0;
+        for (size_t i = 0; i < keyCount; i += 97) {
+            PersistentIndexNode* node = find(root, keys[i]);
+            if (node != nullptr && node->value == i) ++found;
+        }
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "Rebuild index (" << keyCount << " keys): " << rebuildMs << " ms\n"
+                  << "Remap pool file:                " << reopenMs << " ms (" << rebuildMs / reopenMs << "x faster)\n"
+                  << std::defaultfloat
+                  << "Lookups after restart: " << found << "/" << (keyCount + 96) / 97 << " found, "
+                  << pool.GetUsedBlocks() << " blocks in use, relocated: " << std::boolalpha << pool.IsRelocated()
+                  << ", recovered: " << pool.WasRecovered() << std::noboolalpha << "\n";
+    }
+    std::remove(path.c_str());
+}
+
+#if !defined(_WIN32)
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = write(fd, bytes, size);
+        if (written <= 0) return false;
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t received = read(fd, bytes, size);
+        if (received <= 0) return false;
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+#endif
+
+void sharedMemoryHandoffBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|  Shared Memory Handoff Benchmark   |";
+    std::cout << "\n+------------------------------------+\n";
+
+#if defined(_WIN32)
+    std::cout << "Skipped: shared memory pools need fork() and memfd_create/shm_open.\n";
+#else
+    constexpr size_t messageSize = 64 * 1024;
+    constexpr size_t messageCount = 20000;
+    constexpr size_t workerCount = 2;
+
+    allocity::SharedMemoryPool pool(messageSize, 256);
+
+    // Each worker checks that it received every message routed to it, in
+    // order, and reports failure through its exit status.
+    auto runWorkers = [&](bool zeroCopy) {
+        int pipes[workerCount][2];
+        pid_t workers[workerCount];
+        for (size_t w = 0; w < workerCount; ++w) {
+            if (pipe(pipes[w]) != 0) throw std::runtime_error("pipe() failed");
+            workers[w] = fork();
+            if (workers[w] == 0) {
+                for (size_t other = 0; other <= w; ++other) {
+                    close(pipes[other][1]);
+                }
+                std::vector<char> buffer(messageSize);
+                size_t intact = 0;
+                size_t expected = 0;
+                for (;;) {
+                    uint64_t sequence = 0;
+                    if (zeroCopy) {
+                        uint64_t offset = 0;
+                        if (!readAll(pipes[w][0], &offset, sizeof(offset))) break;
+                        auto* message = pool.Get<uint64_t>(offset);
+                        sequence = message[0];
+                        pool.Deallocate(message);
+                    } else {
+                        if (!readAll(pipes[w][0], buffer.data(), messageSize)) break;
+                        std::memcpy(&sequence, buffer.data(), sizeof(sequence));
+                    }
+                    intact += sequence % workerCount == w && sequence >= expected;
+                    expected = sequence;
+                }
+                _exit(intact == messageCount / workerCount ? 0 : 1);
+            }
+            close(pipes[w][0]);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<char> payload(messageSize, 'x');
+        for (uint64_t sequence = 0; sequence < messageCount; ++sequence) {
+            const int fd = pipes[sequence % workerCount][1];
+            if (zeroCopy) {
+                void* message;
+                while ((message = pool.Allocate()) == nullptr) {
+                    std::this_thread::yield();
+                }
+                std::memcpy(message, &sequence, sizeof(sequence));
+                const uint64_t offset = pool.ToOffset(message);
+                writeAll(fd, &offset, sizeof(offset));
+            } else {
+                std::memcpy(payload.data(), &sequence, sizeof(sequence));
+                writeAll(fd, payload.data(), messageSize);
+            }
+        }
+        bool ok = true;
+        for (size_t w = 0; w < workerCount; ++w) {
+            close(pipes[w][1]);
+            int status = 0;
+            waitpid(workers[w], &status, 0);
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << std::setw(24) << (zeroCopy ? "offset over pipe" : "payload over pipe") << ": "
+                  << std::fixed << std::setprecision(2) << ms << " ms for " << messageCount << " x "
+                  << messageSize << " B messages" << std::defaultfloat << (ok ? "" : " (WORKER CHECK FAILED)") << "\n";
+    };
+
+    runWorkers(false);
+    runWorkers(true);
+
+    // A worker that dies while holding blocks: its blocks are reclaimed.
+    pid_t crashing = fork();
+    if (crashing == 0) {
+        for (size_t i = 0; i < 100; ++i) {
+            pool.Allocate();
+        }
+        _exit(0);
+    }
+    waitpid(crashing, nullptr, 0);
+    const size_t leaked = pool.GetUsedBlocks();
+    const size_t recovered = pool.RecoverDeadOwners();
+    std::cout << "Crashed worker held " << leaked << " blocks, RecoverDeadOwners() reclaimed " << recovered
+              << ", " << pool.GetUsedBlocks() << " still in use\n";
+
+    // Odd block sizes are rounded up so every block stays 8-byte aligned.
+    allocity::SharedMemoryPool oddPool(13, 16);
+    bool aligned = true;
+    for (size_t i = 0; i < 16; ++i) {
+        aligned = aligned && reinterpret_cast<std::uintptr_t>(oddPool.Allocate()) % alignof(uint64_t) == 0;
+    }
+    std::cout << "13-byte blocks rounded to " << oddPool.GetBlockSize() << " B, "
+              << (aligned ? "all aligned" : "MISALIGNED") << "\n";
+#endif
+}
+
+void allocatorStartupBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|     Allocator Startup Benchmark    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t constructions = 20;
+
+    allocity::AllocatorConfig eager;
+    eager.LazyInitialization = false;
+
+    allocity::AllocatorConfig lazy;
+
+    allocity::AllocatorConfig minimal;
+    minimal.WorkerThreads = 0;
+    minimal.Tracking = allocity::TrackingLevel::Minimal;
+
+    auto measure = [&](const char* label, const allocity::AllocatorConfig& config) {
+        double constructUs = 0.0;
+        double firstAllocationUs = 0.0;
+        for (size_t i = 0; i < constructions; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto allocator = std::make_unique<allocity::Allocator>(config);
+            auto constructed = std::chrono::high_resolution_clock::now();
+            void* ptr = allocator->Allocate(64);
+            auto allocated = std::chrono::high_resolution_clock::now();
+            allocator->Deallocate(ptr);
+            allocator.reset();
+            constructUs += std::chrono::duration<double, std::micro>(constructed - start).count();
+            firstAllocationUs += std::chrono::duration<double, std::micro>(allocated - constructed).count();
+        }
+        std::cout << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(1)
+                  << "construct " << std::setw(8) << constructUs / constructions << " us, first alloc "
+                  << std::setw(6) << firstAllocationUs / constructions << " us" << std::defaultfloat
+                  << "  [" << config.ToString() << "]\n";
+    };
+
+    std::cout << "hardware_concurrency: " << std::thread::hardware_concurrency() << "\n";
+    measure("eager pools + workers", eager);
+    measure("lazy (default)", lazy);
+    measure("lazy, no workers, minimal tracking", minimal);
+}
+
+long minorPageFaults() {
+#if defined(_WIN32)
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+#endif
+}
+
+void firstRequestLatencyBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   First-Request Latency Benchmark  |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t requests = 2000;
+    constexpr size_t requestSizes[] = {48, 200, 3000, 24 * 1024, 64 * 1024};
+    constexpr size_t liveRequests = 64;
+
+    // Each request builds a small response (one buffer per size above),
+    // writes it and keeps the last liveRequests responses alive.
+    auto run = [&](const char* label, bool reserve, bool lockMemory) {
+        allocity::AllocatorConfig config;
+        config.Tracking = allocity::TrackingLevel::Minimal;
+        allocity::Allocator allocator(config);
+
+        allocity::ReserveResult reserved;
+        auto reserveStart = std::chrono::high_resolution_clock::now();
+        if (reserve) {
+            for (size_t size : requestSizes) {
+                const allocity::ReserveResult result = allocator.Reserve(size, liveRequests + 1, lockMemory);
+                reserved.PrefaultedBytes += result.PrefaultedBytes;
+                reserved.LockedBytes += result.LockedBytes;
+            }
+        }
+        const double reserveMs = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - reserveStart).count();
+
+        std::vector<std::vector<void*>> live(liveRequests);
+        std::vector<double> latencies;
+        latencies.reserve(requests);
+        const long faultsBefore = minorPageFaults();
+        for (size_t i = 0; i < requests; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto& slot = live[i % liveRequests];
+            for (void* ptr : slot) {
+                allocator.Deallocate(ptr);
+            }
+            slot.clear();
+            for (size_t size : requestSizes) {
+                void* ptr = allocator.Allocate(size);
+                std::memset(ptr, static_cast<int>(i), size);
+                slot.push_back(ptr);
+            }
+            latencies.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::high_resolution_clock::now() - start).count());
+        }
+        const long faults = minorPageFaults() - faultsBefore;
+        for (auto& slot : live) {
+            for (void* ptr : slot) {
+                allocator.Deallocate(ptr);
+            }
+        }
+
+        const double firstRequestsUs = std::accumulate(latencies.begin(), latencies.begin() + liveRequests, 0.0);
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::left << std::setw(22) << label << std::right << std::fixed << std::setprecision(1)
+                  << "first " << liveRequests << " requests " << std::setw(8) << firstRequestsUs << " us, p99 "
+                  << std::setw(6) << latencies[requests * 99 / 100] << " us, max " << std::setw(7) << latencies.back()
+                  << " us, page faults " << std::setw(5) << faults;
+        if (reserve) {
+            std::cout << " (reserve " << reserveMs << " ms, " << reserved.PrefaultedBytes / 1024 << " KiB prefaulted, "
+                      << reserved.LockedBytes / 1024 << " KiB locked)";
+        }
+        std::cout << std::defaultfloat << "\n";
+    };
+
+    run("cold", false, false);
+    run("Reserve()", true, false);
+    run("Reserve() + mlock", true, true);
+}
+
+void asyncLoggingBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|      Async Logging Benchmark       |";
+    std::cout << "\n+------------------------------------+\n";
+
+    // Bursts that fit in the calling thread's ring; the flush between bursts
+    // is not timed, as it runs on the background thread in real use.
+    constexpr size_t bursts = 200;
+    constexpr size_t messagesPerBurst = allocity::Log::RING_CAPACITY;
+
+    std::atomic<size_t> delivered{0};
+    std::string lastMessage;
+    allocity::Log::SetSink([&](const allocity::LogMessage& message) {
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        lastMessage = message.Text;
+    });
+    const uint64_t droppedBefore = allocity::Log::GetDroppedCount();
+
+    auto runBursts = [&](const auto& body) {
+        double totalNs = 0.0;
+        for (size_t burst = 0; burst < bursts; ++burst) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < messagesPerBurst; ++i) {
+                body(burst, i);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            totalNs += std::chrono::duration<double, std::nano>(end - start).count();
+            allocity::Log::Flush();
+        }
+        return totalNs / (bursts * messagesPerBurst);
+    };
+
+    std::mutex streamMutex;
+    std::ostringstream stream;
+    double streamNs = runBursts([&](size_t burst, size_t i) {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        stream << "[allocity info] burst " << burst << " allocated block " << i << " at " << &stream << '\n';
+    });
+
+    double asyncNs = runBursts([&](size_t burst, size_t i) {
+        ALLOCITY_LOG_INFO("burst {} allocated block {} at {}", burst, i, &stream);
+    });
+
+    double disabledNs = runBursts([&](size_t burst, size_t i) {
+        ALLOCITY_LOG_TRACE("burst {} allocated block {} at {}", burst, i, &stream);
+    });
+
+    allocity::Log::Flush();
+    const uint64_t dropped = allocity::Log::GetDroppedCount() - droppedBefore;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "mutex + ostringstream: " << std::setw(7) << streamNs << " ns/message\n";
+    std::cout << "ALLOCITY_LOG_INFO:     " << std::setw(7) << asyncNs << " ns/message\n";
+    std::cout << "ALLOCITY_LOG_TRACE:    " << std::setw(7) << disabledNs << " ns/message (compiled out)\n";
+    std::cout << std::defaultfloat;
+    std::cout << "Delivered " << delivered.load() << " messages, dropped " << dropped << " on full rings\n";
+    std::cout << "Last message: " << lastMessage << "\n";
+
+    allocity::Log::SetSink(nullptr);
+}
+
+void slabBitmapFreeCheckTest(allocity::Allocator& allocator) {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|     Slab Bitmap Free Check Test    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    auto expectFailure = [](const char* label, const auto& action) {
+        try {
+            action();
+            std::cout << label << ": not detected\n";
+        } catch (const std::exception& e) {
+            std::cout << label << ": detected - " << e.what() << "\n";
+        }
+    };
+
+    char* block = static_cast<char*>(allocator.Allocate(48));
+    allocator.Deallocate(block);
+    expectFailure("Double free", [&] { allocator.Deallocate(block); });
+
+    block = static_cast<char*>(allocator.Allocate(48));
+    expectFailure("Interior pointer free", [&] { allocator.Deallocate(block + 16); });
+    allocator.Deallocate(block);
+
+    // The bitmap's footprint is fixed by the slab size, where a set of freed
+    // pointers grows with every free.
+    constexpr size_t blockSize = 64;
+    constexpr size_t blockCount = 64 * 1024;
+    constexpr size_t rounds = 16;
+    allocity::MemoryPool pool(blockSize, blockCount);
+    std::vector<void*> blocks(blockCount);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (auto& ptr : blocks) {
+            ptr = pool.Allocate();
+        }
+        for (void* ptr : blocks) {
+            pool.Deallocate(ptr);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double bitmapNs = std::chrono::duration<double, std::nano>(end - start).count() / (rounds * blockCount);
+
+    std::mutex setMutex;
+    std::unordered_set<void*> allocatedSet;
+    std::unordered_set<void*> freedSet;
+    allocity::MemoryPool plainPool(blockSize, blockCount);
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (auto& ptr : blocks) {
+            ptr = plainPool.Allocate();
+            std::lock_guard<std::mutex> lock(setMutex);
+            allocatedSet.insert(ptr);
+            freedSet.erase(ptr);
+        }
+        for (void* ptr : blocks) {
+            {
+                std::lock_guard<std::mutex> lock(setMutex);
+                allocatedSet.erase(ptr);
+                freedSet.insert(ptr);
+            }
+            plainPool.Deallocate(ptr);
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double setNs = std::chrono::duration<double, std::nano>(end - start).count() / (rounds * blockCount);
+
+    for (size_t i = 0; i < blockCount; i += 3) {
+        blocks[i] = pool.Allocate();
+    }
+    const allocity::SlabBitmap& bitmap = pool.GetAllocationBitmap();
+    size_t firstFree[4];
+    const size_t found = bitmap.FindClear(firstFree, 4);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Bitmap check:           " << std::setw(6) << bitmapNs << " ns per alloc/free pair, "
+              << blockCount / 8 << " bytes of state\n";
+    std::cout << "unordered_set + mutex:  " << std::setw(6) << setNs << " ns per alloc/free pair\n";
+    std::cout << std::defaultfloat;
+    std::cout << "Pool free blocks: " << pool.GetFreeBlocks() << " of " << pool.GetCapacity() << "\n";
+    std::cout << "First free blocks:";
+    for (size_t i = 0; i < found; ++i) {
+        std::cout << " " << firstFree[i];
+    }
+    std::cout << "\n";
+}
+
+void allocateAsyncBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|     AllocateAsync Benchmark        |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t size = 1024ULL * 1024 * 1024;
+    constexpr size_t pageSize = 4096;
+    allocity::Allocator allocator;
+
+    // Stand-in for the rest of the caller's start-up work.
+    auto setupWork = [] {
+        std::vector<uint64_t> table(1024 * 1024);
+        std::mt19937_64 rng(42);
+        for (auto& value : table) {
+            value = rng();
+        }
+        std::sort(table.begin(), table.end());
+        return table[table.size() / 2];
+    };
+    auto elapsedMs = [](std::chrono::high_resolution_clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+    };
+    auto touch = [](void* ptr) {
+        for (size_t offset = 0; offset < size; offset += pageSize) {
+            static_cast<volatile char*>(ptr)[offset] = 1;
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    volatile uint64_t sink = setupWork();
+    const double setupMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    void* ptr = allocator.Allocate(size);
+    touch(ptr);
+    const double syncReadyMs = elapsedMs(start);
+    allocator.Deallocate(ptr);
+
+    start = std::chrono::high_resolution_clock::now();
+    ptr = allocator.Allocate(size);
+    touch(ptr);
+    sink = setupWork();
+    const double syncTotalMs = elapsedMs(start);
+    allocator.Deallocate(ptr);
+
+    auto runAsync = [&](const char* label, allocity::AllocationFlags flags) {
+        auto asyncStart = std::chrono::high_resolution_clock::now();
+        std::future<void*> ready = allocator.AllocateAsync(size, flags);
+        const double returnMs = elapsedMs(asyncStart);
+        void* region = ready.get();
+        const double readyMs = elapsedMs(asyncStart);
+        allocator.Deallocate(region);
+
+        asyncStart = std::chrono::high_resolution_clock::now();
+        ready = allocator.AllocateAsync(size, flags);
+        sink = setupWork();
+        region = ready.get();
+        const double totalMs = elapsedMs(asyncStart);
+        allocator.Deallocate(region);
+
+        std::cout << std::left << std::setw(26) << label << std::right << std::fixed << std::setprecision(1)
+                  << "returns " << std::setw(6) << returnMs << " ms, ready " << std::setw(7) << readyMs
+                  << " ms, with setup " << std::setw(7) << totalMs << " ms" << std::defaultfloat << "\n";
+    };
+    (void)sink;
+
+    std::cout << "Region: " << size / (1024 * 1024) << " MiB, worker threads: "
+              << allocator.GetConfig().ResolveWorkerThreads() << ", setup work alone: " << std::fixed
+              << std::setprecision(1) << setupMs << " ms\n";
+    std::cout << std::left << std::setw(26) << "Allocate + touch" << std::right << "returns " << std::setw(6)
+              << syncReadyMs << " ms, ready " << std::setw(7) << syncReadyMs << " ms, with setup " << std::setw(7)
+              << syncTotalMs << " ms" << std::defaultfloat << "\n";
+    runAsync("AllocateAsync(Prefault)", allocity::AllocationFlags::Prefault);
+    runAsync("AllocateAsync(Zero)", allocity::AllocationFlags::Zero);
+
+    // Work still queued when the allocator is destroyed must run, and a
+    // callback that throws must not take the worker down with it.
+    constexpr int requests = 16;
+    std::atomic<int> callbacks{0};
+    {
+        allocity::Allocator shortLived(allocity::AllocatorConfig::FromString("workers=2"));
+        for (int i = 0; i < requests; ++i) {
+            shortLived.AllocateAsync(4 * 1024 * 1024, allocity::AllocationFlags::Zero, [&callbacks, i](void* region) {
+                callbacks.fetch_add(1, std::memory_order_relaxed);
+                if (region == nullptr || i % 4 == 0) {
+                    throw std::runtime_error("onReady failed");
+                }
+            });
+        }
+    }
+    std::cout << "Callbacks run after shutdown: " << callbacks.load() << " of " << requests << "\n";
+    if (callbacks.load() != requests) {
+        std::cout << "AllocateAsync work was dropped on shutdown\n";
+    }
+}
+
+void parallelFillCopyBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Parallel Fill/Copy Benchmark     |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t size = 1024ULL * 1024 * 1024;
+    constexpr int repetitions = 3;
+    allocity::Allocator allocator;
+
+    // Both buffers are faulted in first so that only the stores are timed.
+    std::unique_ptr<char[]> source(new char[size]);
+    std::unique_ptr<char[]> destination(new char[size]);
+    std::memset(source.get(), 1, size);
+    std::memset(destination.get(), 2, size);
+
+    auto measure = [&](const char* label, const auto& operation) {
+        double bestMs = std::numeric_limits<double>::max();
+        for (int i = 0; i < repetitions; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            operation();
+            auto end = std::chrono::high_resolution_clock::now();
+            bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::cout << std::left << std::setw(30) << label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(8) << bestMs << " ms  " << std::setw(6) << size / (bestMs * 1e6) << " GB/s"
+                  << std::defaultfloat << "\n";
+    };
+
+    std::cout << "Buffer: " << size / (1024 * 1024) << " MiB, worker threads: "
+              << allocator.GetConfig().ResolveWorkerThreads() << ", streaming stores: "
+              << (allocity::BulkMemory::HasNonTemporalStores() ? "yes" : "no") << "\n";
+    measure("memset", [&] { std::memset(destination.get(), 0xFE, size); });
+    measure("BulkMemory::Fill", [&] { allocity::BulkMemory::Fill(destination.get(), 0xFE, size); });
+    measure("Allocator::ParallelFill", [&] { allocator.ParallelFill(destination.get(), 0xFE, size); });
+    measure("memcpy", [&] { std::memcpy(destination.get(), source.get(), size); });
+    measure("BulkMemory::Copy", [&] { allocity::BulkMemory::Copy(destination.get(), source.get(), size); });
+    measure("Allocator::ParallelCopy", [&] { allocator.ParallelCopy(destination.get(), source.get(), size); });
+
+    const bool intact = std::memcmp(destination.get(), source.get(), size) == 0;
+    std::cout << "Copy result " << (intact ? "matches" : "DOES NOT MATCH") << " the source\n";
+
+    char* block = static_cast<char*>(allocator.Allocate(size / 2));
+    std::memset(block, 7, size / 2);
+    auto start = std::chrono::high_resolution_clock::now();
+    block = static_cast<char*>(allocator.Reallocate(block, size));
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Reallocate " << size / (2 * 1024 * 1024) << " -> " << size / (1024 * 1024) << " MiB: " << std::fixed
+              << std::setprecision(1) << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms, contents " << (block[0] == 7 && block[size / 2 - 1] == 7 ? "preserved" : "LOST")
+              << std::defaultfloat << "\n";
+
+    // Debug-mode Deallocate poisons the whole block before releasing it.
+    allocator.SetDebugMode(true);
+    start = std::chrono::high_resolution_clock::now();
+    allocator.Deallocate(block);
+    end = std::chrono::high_resolution_clock::now();
+    allocator.SetDebugMode(false);
+    std::cout << "Debug-mode Deallocate (poison " << size / (1024 * 1024) << " MiB): " << std::fixed
+              << std::setprecision(1) << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::defaultfloat << "\n";
+}
+
+// Treiber stack whose nodes come from an Allocator. Popped nodes are
+// retired to the epoch domain, which also rules out ABA on the head.
+class EpochStack {
+public:
+    EpochStack(allocity::Allocator& allocator, allocity::EpochDomain& domain)
+        : m_allocator(allocator), m_domain(domain), m_head(nullptr) {}
+
+    ~EpochStack() {
+        Node* node = m_head.load(std::memory_order_relaxed);
+        while (node != nullptr) {
+            Node* next = node->next;
+            m_allocator.Deallocate(node);
+            node = next;
+        }
+    }
+
+    void Push(uint64_t value) {
+        Node* node = new (m_allocator.Allocate(sizeof(Node))) Node{value, m_head.load(std::memory_order_relaxed)};
+        while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    bool Pop(uint64_t& value) {
+        allocity::EpochDomain::Guard guard(m_domain);
+        Node* node = m_head.load(std::memory_order_acquire);
+        while (node != nullptr &&
+               !m_head.compare_exchange_weak(node, node->next, std::memory_order_acquire, std::memory_order_acquire)) {
+        }
+        if (node == nullptr) {
+            return false;
+        }
+        value = node->value;
+        m_domain.Retire(node);
+        return true;
+    }
+
+private:
+    struct Node {
+        uint64_t value;
+        Node* next;
+    };
+
+    allocity::Allocator& m_allocator;
+    allocity::EpochDomain& m_domain;
+    std::atomic<Node*> m_head;
+};
+
+class LockedStack {
+public:
+    explicit LockedStack(allocity::Allocator& allocator) : m_allocator(allocator), m_head(nullptr) {}
+
+    ~LockedStack() {
+        while (m_head != nullptr) {
+            Node* next = m_head->next;
+            m_allocator.Deallocate(m_head);
+            m_head = next;
+        }
+    }
+
+    void Push(uint64_t value) {
+        Node* node = new (m_allocator.Allocate(sizeof(Node))) Node{value, nullptr};
+        std::lock_guard<std::mutex> lock(m_mutex);
+        node->next = m_head;
+        m_head = node;
+    }
+
+    bool Pop(uint64_t& value) {
+        Node* node;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            node = m_head;
+            if (node == nullptr) {
+                return false;
+            }
+            m_head = node->next;
+        }
+        value = node->value;
+        m_allocator.Deallocate(node);
+        return true;
+    }
+
+private:
+    struct Node {
+        uint64_t value;
+        Node* next;
+    };
+
+    allocity::Allocator& m_allocator;
+    std::mutex m_mutex;
+    Node* m_head;
+};
+
+void epochReclamationBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Epoch Reclamation Stack Bench    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t threadCount = 4;
+    constexpr size_t operationsPerThread = 200000;
+
+    allocity::AllocatorConfig config;
+    config.Tracking = allocity::TrackingLevel::Minimal;
+
+    auto run = [&](const char* label, auto& stack) {
+        std::atomic<uint64_t> popped{0};
+        std::atomic<uint64_t> poppedSum{0};
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t] {
+                uint64_t count = 0;
+                uint64_t sum = 0;
+                uint64_t value;
+                for (size_t i = 0; i < operationsPerThread; ++i) {
+                    stack.Push(t * operationsPerThread + i);
+                    if (stack.Pop(value)) {
+                        ++count;
+                        sum += value;
+                    }
+                }
+                popped += count;
+                poppedSum += sum;
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        uint64_t value;
+        while (stack.Pop(value)) {
+            ++popped;
+            poppedSum += value;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        const uint64_t total = threadCount * operationsPerThread;
+        const bool intact = popped == total && poppedSum == total * (total - 1) / 2;
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * total);
+        std::cout << std::left << std::setw(26) << label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(7) << ns << " ns/op, " << (intact ? "all values popped once" : "VALUES LOST OR DUPLICATED")
+                  << std::defaultfloat << "\n";
+    };
+
+    {
+        allocity::Allocator allocator(config);
+        LockedStack stack(allocator);
+        run("mutex stack + Deallocate", stack);
+    }
+    {
+        allocity::Allocator allocator(config);
+        allocity::EpochDomain domain(allocator);
+        {
+            EpochStack stack(allocator, domain);
+            run("lock-free stack + Retire", stack);
+        }
+        domain.Drain();
+        // Lists of the exited worker threads are freed with the domain.
+        std::cout << "Epoch " << domain.GetEpoch() << ", reclaimed while running: " << domain.GetReclaimedCount()
+                  << ", left for domain teardown: " << domain.GetPendingCount() << "\n";
+    }
+    {
+        // A pointer listed twice is rejected before anything is released.
+        allocity::Allocator allocator(config);
+        void* batch[3] = {allocator.Allocate(32), allocator.Allocate(32), nullptr};
+        batch[2] = batch[0];
+        bool rejected = false;
+        try {
+            allocator.DeallocateBatch(batch, 3);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        allocator.DeallocateBatch(batch, 2);
+        std::cout << "Batch with a repeated pointer " << (rejected ? "rejected" : "ACCEPTED") << ", blocks "
+                  << (allocator.IsEmpty() ? "freed afterwards" : "LEAKED") << "\n";
+    }
+}
+
+// Stands in for a function that needs a temporary buffer whose size is
+// only known at run time; the buffer is filled, summed and dropped.
+template <typename Acquire, typename Release>
+uint64_t useTemporaryBuffer(size_t size, Acquire acquire, Release release) {
+    unsigned char* buffer = static_cast<unsigned char*>(acquire(size));
+    std::memset(buffer, static_cast<int>(size), size);
+    const uint64_t sum = buffer[0] + buffer[size / 2] + buffer[size - 1];
+    release(buffer);
+    return sum;
+}
+
+void scratchStackBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|     Scratch Stack Benchmark        |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t iterations = 200000;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<size_t> sizeDistribution(64, 16 * 1024);
+    std::vector<size_t> sizes(iterations);
+    for (auto& size : sizes) {
+        size = sizeDistribution(rng);
+    }
+
+    auto measure = [&](const char* label, const auto& operation) {
+        uint64_t checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            checksum += operation(sizes[i]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << std::left << std::setw(30) << label << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(8) << std::chrono::duration<double, std::nano>(end - start).count() / iterations
+                  << " ns/scope (checksum " << checksum << ")" << std::defaultfloat << "\n";
+    };
+
+    {
+        allocity::Allocator allocator;
+        measure("Allocate/Deallocate", [&](size_t size) {
+            return useTemporaryBuffer(
+                size, [&](size_t bytes) { return allocator.Allocate(bytes); },
+                [&](void* ptr) { allocator.Deallocate(ptr); });
+        });
+    }
+    measure("ScratchMarker", [](size_t size) {
+        allocity::ScratchMarker scratch;
+        return useTemporaryBuffer(
+            size, [&](size_t bytes) { return scratch.Allocate(bytes); }, [](void*) {});
+    });
+
+    allocity::ScratchStack& stack = allocity::ScratchStack::ForThread();
+    bool rolledBack = true;
+    {
+        allocity::ScratchMarker outer;
+        int* values = outer.AllocateArray<int>(1000);
+        values[999] = 42;
+        const size_t outerUsed = stack.GetUsedBytes();
+        {
+            // Larger than a chunk, so it overflows into a dedicated one.
+            constexpr size_t largeSize = 4 * allocity::ScratchStack::DEFAULT_CHUNK_SIZE;
+            allocity::ScratchMarker inner;
+            std::memset(inner.Allocate(largeSize), 0, largeSize);
+        }
+        rolledBack = stack.GetUsedBytes() == outerUsed && values[999] == 42;
+    }
+    rolledBack = rolledBack && stack.GetUsedBytes() == 0;
+    std::cout << "Nested markers " << (rolledBack ? "rolled back" : "DID NOT ROLL BACK") << ", high water "
+              << stack.GetHighWaterBytes() / 1024 << " KiB, reserved " << stack.GetReservedBytes() / 1024 << " KiB in "
+              << stack.GetChunkCount() << " chunks\n";
+    stack.SetRetainLimit(allocity::ScratchStack::DEFAULT_CHUNK_SIZE);
+    std::cout << "After a " << allocity::ScratchStack::DEFAULT_CHUNK_SIZE / 1024 << " KiB retain limit: reserved "
+              << stack.GetReservedBytes() / 1024 << " KiB in " << stack.GetChunkCount() << " chunks\n";
+    stack.SetRetainLimit(allocity::ScratchStack::UNLIMITED);
+}
+
+// Every thread repeatedly takes a handful of blocks and gives them back,
+// so the free-list head is contended from both ends.
+template <typename Pool>
+double sharedPoolChurn(Pool& pool, size_t threadCount, size_t operationsPerThread, bool& intact) {
+    constexpr size_t blocksHeld = 8;
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            void* blocks[blocksHeld];
+            for (size_t round = 0; round < operationsPerThread / blocksHeld; ++round) {
+                for (auto& block : blocks) {
+                    block = pool.Allocate();
+                    *static_cast<uint64_t*>(block) = t;
+                }
+                for (auto& block : blocks) {
+                    if (*static_cast<uint64_t*>(block) != t) {
+                        failed = true;
+                    }
+                    pool.Deallocate(block);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    intact = intact && !failed && pool.GetUsedBlocks() == 0 && pool.GetFreeBlocks() == pool.GetCapacity();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * threadCount * operationsPerThread);
+}
+
+void lockFreePoolBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Lock-Free MemoryPool Benchmark   |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t blockSize = 64;
+    constexpr size_t blockCount = 1024;
+    constexpr size_t totalOperations = 1 << 20;
+
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << std::setw(8) << "Threads" << std::setw(22) << "mutex (ns/op)" << std::setw(22) << "lock-free (ns/op)"
+              << "\n";
+    bool intact = true;
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        allocity::MemoryPool lockedPool(blockSize, blockCount);
+        allocity::LockFreeMemoryPool lockFreePool(blockSize, blockCount);
+        const double locked = sharedPoolChurn(lockedPool, threads, totalOperations / threads, intact);
+        const double lockFree = sharedPoolChurn(lockFreePool, threads, totalOperations / threads, intact);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1) << std::setw(22) << locked
+                  << std::setw(22) << lockFree << std::defaultfloat << "\n";
+    }
+    std::cout << "Blocks " << (intact ? "never shared, all returned" : "SHARED OR LEAKED") << "\n";
+}
+
+void hashtableRehashLatencyTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|  Hashtable Rehash Latency Test     |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t keyCount = 4 * 1024 * 1024;
+    // Distinct 16-byte aligned addresses in scattered order, like live
+    // allocations drawn from many pools and arenas.
+    auto keyAt = [](size_t i) {
+        return reinterpret_cast<void*>((((i + 1) * 0x9E3779B97F4A7C15ULL) & ((1ULL << 44) - 1)) << 4);
+    };
+
+    allocity::AllocityHashtable table;
+    std::unordered_map<void*, size_t> reference;
+    allocity::LatencyHistogram tableInserts, referenceInserts;
+    size_t resizes = 0;
+    for (size_t i = 0; i < keyCount; ++i) {
+        const size_t capacity = table.capacity();
+        std::uint64_t start = allocity::LatencyRecorder::ReadTimestamp();
+        table.insert(keyAt(i), i);
+        tableInserts.Record(allocity::LatencyRecorder::ReadTimestamp() - start);
+        resizes += table.capacity() != capacity;
+
+        start = allocity::LatencyRecorder::ReadTimestamp();
+        reference.emplace(keyAt(i), i);
+        referenceInserts.Record(allocity::LatencyRecorder::ReadTimestamp() - start);
+    }
+
+    const double ticksPerNs = allocity::LatencyRecorder::TicksPerNanosecond();
+    auto print = [ticksPerNs](const char* name, const allocity::LatencyHistogram& histogram) {
+        std::cout << std::setw(20) << name
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetValueAtPercentile(50.0) / ticksPerNs)
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetValueAtPercentile(99.9) / ticksPerNs)
+                  << std::setw(12) << static_cast<uint64_t>(histogram.GetMax() / ticksPerNs) << std::endl;
+    };
+    std::cout << keyCount << " inserts, " << resizes << " resizes, final capacity " << table.capacity() << "\n";
+    std::cout << std::setw(20) << "Insert (ns)" << std::setw(12) << "p50" << std::setw(12) << "p99.9"
+              << std::setw(12) << "max" << std::endl;
+    std::cout << std::string(56, '-') << std::endl;
+    print("AllocityHashtable", tableInserts);
+    print("unordered_map", referenceInserts);
+
+    // The allocator tracks its blocks in the same table, so its Allocate
+    // calls never wait for a whole rehash either.
+    constexpr size_t allocationCount = 1024 * 1024;
+    allocity::Allocator allocator(allocity::AllocatorConfig::FromString("workers=0,tracking=minimal"));
+    std::vector<void*> blocks(allocationCount);
+    allocity::LatencyHistogram allocatorInserts;
+    for (auto& block : blocks) {
+        const std::uint64_t start = allocity::LatencyRecorder::ReadTimestamp();
+        block = allocator.Allocate(24);
+        allocatorInserts.Record(allocity::LatencyRecorder::ReadTimestamp() - start);
+    }
+    print("Allocator::Allocate", allocatorInserts);
+    bool tracked = allocator.GetAllocationCount() == allocationCount;
+    for (void* block : blocks) {
+        tracked = tracked && allocator.FindAllocation(block) != nullptr && *allocator.FindAllocation(block) == 24;
+        allocator.Deallocate(block);
+    }
+    tracked = tracked && allocator.IsEmpty();
+    std::cout << "Allocator tracker " << (tracked ? "found and released every block" : "LOST BLOCKS") << "\n";
+
+    // Remove every other key, including ones still in the old table of a
+    // migration started by reserve(), and check that the rest survive.
+    table.reserve(2 * keyCount);
+    bool intact = table.rehashing();
+    for (size_t i = 0; i < keyCount; i += 2) {
+        intact = table.remove(keyAt(i)) && intact;
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        size_t* value = table.find(keyAt(i));
+        intact = intact && (i % 2 == 0 ? value == nullptr : value != nullptr && *value == i);
+    }
+    intact = intact && table.size() == keyCount / 2;
+    std::cout << "Lookups after reserve and removals " << (intact ? "correct" : "INCORRECT") << "\n";
+}
+
+void lazyPoolInitializationTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Lazy Pool Initialization Test    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t blockSize = 64;
+    constexpr size_t blockCount = 1024 * 1024;
+    constexpr size_t usedBlocks = 4096;
+    const size_t slabBytes = blockSize * blockCount;
+    void* slab = allocity::VirtualMemory::Reserve(slabBytes);
+    allocity::VirtualMemory::Commit(slab, slabBytes);
+
+    const size_t residentBefore = allocity::VirtualMemory::GetResidentBytes();
+    auto start = std::chrono::high_resolution_clock::now();
+    auto pool = std::make_unique<allocity::MemoryPool>(blockSize, blockCount, slab);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double constructUs = std::chrono::duration<double, std::micro>(end - start).count();
+
+    std::vector<void*> blocks(usedBlocks);
+    for (auto& block : blocks) {
+        block = pool->Allocate();
+        std::memset(block, 1, blockSize);
+    }
+    const size_t residentAfter = allocity::VirtualMemory::GetResidentBytes();
+
+    start = std::chrono::high_resolution_clock::now();
+    pool->Clear();
+    end = std::chrono::high_resolution_clock::now();
+    const double clearUs = std::chrono::duration<double, std::micro>(end - start).count();
+
+    // A pointer from before Clear() is free again, and the frontier hands
+    // the slab out from the start.
+    bool staleRejected = false;
+    try {
+        pool->Deallocate(blocks[usedBlocks / 2]);
+    } catch (const std::runtime_error&) {
+        staleRejected = true;
+    }
+    const bool restarted = pool->Allocate() == slab && pool->GetUsedBlocks() == 1 && !pool->IsAllocated(blocks[1]);
+
+    std::cout << "Slab: " << slabBytes / (1024 * 1024) << " MiB, " << blockCount << " blocks, " << usedBlocks
+              << " used\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Construct: " << constructUs << " us, Clear: " << clearUs << " us\n";
+    std::cout << std::defaultfloat;
+    std::cout << "Resident growth: " << (residentAfter - std::min(residentBefore, residentAfter)) / 1024
+              << " KiB for " << usedBlocks * blockSize / 1024 << " KiB of used blocks\n";
+    std::cout << "Stale free after Clear " << (staleRejected ? "rejected" : "ACCEPTED") << ", allocation "
+              << (restarted ? "restarts at the first block" : "DID NOT RESTART") << "\n";
+
+    pool.reset();
+    allocity::VirtualMemory::Release(slab, slabBytes);
+}
+
+// Counts dTLB load misses of the calling thread in user space. Valid()
+// is false where the kernel or hypervisor exposes no hardware counters.
+class DtlbMissCounter {
+public:
+    DtlbMissCounter() {
+#if defined(__linux__)
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+    ~DtlbMissCounter() {
+#if defined(__linux__)
+        if (m_fd >= 0) close(m_fd);
+#endif
+    }
+    DtlbMissCounter(const DtlbMissCounter&) = delete;
+    DtlbMissCounter& operator=(const DtlbMissCounter&) = delete;
+
+    bool Valid() const { return m_fd >= 0; }
+
+    void Start() {
+#if defined(__linux__)
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t Stop() {
+        uint64_t count = 0;
+#if defined(__linux__)
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+size_t anonymousHugePageBytes() {
+#if defined(__linux__)
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(rollup, line)) {
+        if (line.rfind("AnonHugePages:", 0) == 0) {
+            return static_cast<size_t>(std::strtoull(line.c_str() + 14, nullptr, 10)) * 1024;
+        }
+    }
+#endif
+    return 0;
+}
+
+struct SlabChaseResult {
+    double nsPerHop = 0;
+    uint64_t dtlbMisses = 0;
+    size_t hugePageBytes = 0;
+    bool intact = true;
+};
+
+// Fills every size-class pool with objects, links them into one cycle in
+// random order and chases it, like a traversal of a pointer-heavy graph
+// whose nodes come in many sizes.
+SlabChaseResult slabPointerChase(bool hugePageSlabs, size_t hops) {
+    SlabChaseResult result;
+    const size_t hugeBefore = anonymousHugePageBytes();
+    {
+        allocity::Allocator allocator(allocity::AllocatorConfig::FromString(
+            std::string("workers=0,tracking=minimal,pool_blocks=1048576,huge_slabs=") + (hugePageSlabs ? "1" : "0")));
+        std::vector<void*> nodes;
+        for (size_t size = 8; size <= allocity::AllocatorConfig::MAX_SMALL_OBJECT_LIMIT; size += 8) {
+            for (size_t i = 0; i < allocity::VirtualMemory::HUGE_PAGE_SIZE / size; ++i) {
+                nodes.push_back(allocator.Allocate(size));
+            }
+        }
+        std::vector<void*> order(nodes);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(48));
+        for (size_t i = 0; i < order.size(); ++i) {
+            *static_cast<void**>(order[i]) = order[(i + 1) % order.size()];
+        }
+
+        DtlbMissCounter counter;
+        void* node = order.front();
+        auto start = std::chrono::high_resolution_clock::now();
+        counter.Start();
+        for (size_t i = 0; i < hops; ++i) {
+            node = *static_cast<void**>(node);
+        }
+        result.dtlbMisses = counter.Stop();
+        auto end = std::chrono::high_resolution_clock::now();
+        result.nsPerHop = std::chrono::duration<double, std::nano>(end - start).count() / hops;
+        result.intact = node == order[hops % order.size()];
+        result.hugePageBytes = anonymousHugePageBytes() - std::min(hugeBefore, anonymousHugePageBytes());
+        allocator.DeallocateBatch(nodes.data(), nodes.size());
+        result.intact = result.intact && allocator.IsEmpty();
+    }
+    return result;
+}
+
+void hugePageSlabBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|   Huge-Page Slab dTLB Benchmark    |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t hops = 1 << 23;
+    const bool counters = DtlbMissCounter().Valid();
+    std::cout << "One 2 MiB slab per size class, " << hops << " random hops across all of them\n";
+    if (!counters) {
+        std::cout << "dTLB miss counters are unavailable here; timings and huge page coverage only\n";
+    }
+    std::cout << std::setw(16) << "Slabs" << std::setw(14) << "ns/hop" << std::setw(18) << "dTLB misses"
+              << std::setw(22) << "Huge pages (MiB)" << "\n";
+    bool intact = true;
+    for (const bool huge : {false, true}) {
+        const SlabChaseResult result = slabPointerChase(huge, hops);
+        intact = intact && result.intact;
+        std::cout << std::setw(16) << (huge ? "huge-page arena" : "page heap") << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.nsPerHop << std::defaultfloat << std::setw(18)
+                  << (counters ? std::to_string(result.dtlbMisses) : std::string("n/a")) << std::setw(22)
+                  << result.hugePageBytes / (1024 * 1024) << "\n";
+    }
+    std::cout << "Pointer cycle " << (intact ? "intact, all nodes returned" : "BROKEN OR LEAKED") << "\n";
+
+#if !defined(_WIN32)
+    // With no address space left for a new arena region, a pool cannot be
+    // created; the request must fall back to the slow path (or fail) rather
+    // than throw with its tag still charged.
+    allocity::Allocator allocator(allocity::AllocatorConfig::FromString("workers=0,lazy=1,tracking=minimal,huge_slabs=1"));
+    const allocity::MemoryTag tag = allocity::MemoryTags::Register("slab.exhausted");
+    rlimit previous{};
+    getrlimit(RLIMIT_AS, &previous);
+    rlimit exhausted = previous;
+    exhausted.rlim_cur = 1;
+    setrlimit(RLIMIT_AS, &exhausted);
+    void* ptr = nullptr;
+    bool threw = false;
+    try {
+        ptr = allocator.Allocate(48, tag);
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    setrlimit(RLIMIT_AS, &previous);
+    if (ptr != nullptr) {
+        allocator.Deallocate(ptr);
+    }
+    allocity::MemoryTags::Flush();
+    const bool balanced = !threw && allocity::MemoryTags::GetLiveBytes(tag) == 0;
+    std::cout << "Arena out of address space: " << (balanced ? "fell back, tag charge released" : "THREW OR LEAKED CHARGE") << "\n";
+#endif
+}
+
+enum class SmallBlockCache { None, PerThread, PerCpu };
+
+struct CacheChurnResult {
+    double nsPerOperation = 0;
+    double wallMs = 0;
+    size_t cachedBytes = 0;
+    bool intact = true;
+};
+
+// Each of threadCount threads churns a few blocks of one size class, then
+// parks until every thread is done, like a large pool of mostly idle
+// service threads; whatever the caches hold at that point is the memory
+// they cost.
+CacheChurnResult smallBlockCacheChurn(SmallBlockCache mode, size_t threadCount, size_t roundsPerThread) {
+    constexpr size_t classSizes[] = {32, 64, 128, 256};
+    constexpr size_t classCount = sizeof(classSizes) / sizeof(classSizes[0]);
+    constexpr size_t blocksHeld = 8;
+    constexpr size_t cacheCapacity = allocity::PerCpuCache::DEFAULT_CAPACITY;
+
+    std::vector<std::unique_ptr<allocity::MemoryPool>> pools;
+    for (size_t size : classSizes) {
+        pools.push_back(std::make_unique<allocity::MemoryPool>(size, threadCount * cacheCapacity));
+    }
+    allocity::PerCpuCache cpuCache(classCount, cacheCapacity);
+
+    std::atomic<size_t> parked{0};
+    std::atomic<size_t> threadCachedBytes{0};
+    std::atomic<uint64_t> busyNanoseconds{0};
+    std::atomic<bool> failed{false};
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    auto wallStart = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            const size_t sizeClass = t % classCount;
+            allocity::MemoryPool& pool = *pools[sizeClass];
+            std::vector<void*> threadCache;
+            threadCache.reserve(cacheCapacity);
+            void* blocks[blocksHeld];
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t round = 0; round < roundsPerThread; ++round) {
+                for (auto& block : blocks) {
+                    block = nullptr;
+                    if (mode == SmallBlockCache::PerThread && !threadCache.empty()) {
+                        block = threadCache.back();
+                        threadCache.pop_back();
+                    } else if (mode == SmallBlockCache::PerCpu) {
+                        block = cpuCache.Pop(sizeClass);
+                    }
+                    if (block == nullptr) {
+                        block = pool.Allocate();
+                    }
+                    *static_cast<uint64_t*>(block) = t;
+                }
+                for (auto& block : blocks) {
+                    if (*static_cast<uint64_t*>(block) != t) {
+                        failed = true;
+                    }
+                    if (mode == SmallBlockCache::PerThread && threadCache.size() < cacheCapacity) {
+                        threadCache.push_back(block);
+                    } else if (mode != SmallBlockCache::PerCpu || !cpuCache.Push(sizeClass, block)) {
+                        pool.Deallocate(block);
+                    }
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            busyNanoseconds += static_cast<uint64_t>(std::chrono::duration<double, std::nano>(end - start).count());
+
+            threadCachedBytes += threadCache.size() * pool.GetBlockSize();
+            ++parked;
+            released.wait();
+            for (void* block : threadCache) {
+                pool.Deallocate(block);
+            }
+        });
+    }
+    while (parked.load() != threadCount) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto wallEnd = std::chrono::high_resolution_clock::now();
+
+    CacheChurnResult result;
+    result.cachedBytes = threadCachedBytes.load();
+    for (size_t c = 0; c < classCount; ++c) {
+        result.cachedBytes += cpuCache.GetCachedBlocks(c) * classSizes[c];
+    }
+    release.set_value();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    cpuCache.Drain([&](size_t sizeClass, void* block) { pools[sizeClass]->Deallocate(block); });
+
+    result.nsPerOperation = static_cast<double>(busyNanoseconds.load()) / (2.0 * threadCount * roundsPerThread * blocksHeld);
+    result.wallMs = std::chrono::duration<double, std::milli>(wallEnd - wallStart).count();
+    result.intact = !failed;
+    for (const auto& pool : pools) {
+        result.intact = result.intact && pool->GetUsedBlocks() == 0;
+    }
+    return result;
+}
+
+void perCpuCacheBenchmark() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|    Per-CPU Cache Benchmark         |";
+    std::cout << "\n+------------------------------------+\n";
+
+    constexpr size_t threadCount = 10000;
+    constexpr size_t roundsPerThread = 64;
+    std::cout << "rseq available: " << (allocity::PerCpuCache::IsAvailable() ? "yes" : "no, per-CPU mode falls back to the pool")
+              << ", CPUs: " << allocity::PerCpuCache(1).GetCpuCount() << ", " << threadCount << " threads\n";
+    std::cout << std::setw(20) << "Cache" << std::setw(14) << "ns/op" << std::setw(14) << "wall (ms)"
+              << std::setw(20) << "cached (KiB)" << "\n";
+    bool intact = true;
+    const std::pair<SmallBlockCache, const char*> modes[] = {
+        {SmallBlockCache::None, "shared pool"}, {SmallBlockCache::PerThread, "per-thread"}, {SmallBlockCache::PerCpu, "per-CPU (rseq)"}};
+    for (const auto& mode : modes) {
+        const CacheChurnResult result = smallBlockCacheChurn(mode.first, threadCount, roundsPerThread);
+        intact = intact && result.intact;
+        std::cout << std::setw(20) << mode.second << std::fixed << std::setprecision(1) << std::setw(14)
+                  << result.nsPerOperation << std::setw(14) << result.wallMs << std::defaultfloat << std::setw(20)
+                  << result.cachedBytes / 1024 << "\n";
+    }
+
+    // The same mode behind Allocator, which falls back to the pools on its
+    // own where rseq is missing. With percpu=1 pool blocks also skip the
+    // allocation tracker, so a cache hit takes no lock at all.
+    constexpr size_t allocatorThreads = 8;
+    constexpr size_t allocatorRounds = 20000;
+    for (const char* settings : {"workers=0,tracking=minimal,percpu=0", "workers=0,tracking=minimal,percpu=1"}) {
+        allocity::Allocator allocator(allocity::AllocatorConfig::FromString(settings));
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < allocatorThreads; ++t) {
+            threads.emplace_back([&allocator] {
+                for (size_t round = 0; round < allocatorRounds; ++round) {
+                    void* blocks[4];
+                    for (auto& block : blocks) {
+                        block = allocator.Allocate(48);
+                    }
+                    for (auto& block : blocks) {
+                        allocator.Deallocate(block);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        intact = intact && allocator.IsEmpty();
+        std::cout << "Allocator " << settings << ": " << std::fixed << std::setprecision(1)
+                  << elapsedNs / (2.0 * allocatorThreads * allocatorRounds * 4) << " ns/op" << std::defaultfloat;
+        if (allocator.GetPerCpuCache() != nullptr) {
+            std::cout << ", " << allocator.GetPerCpuCache()->GetCachedBlocks(5) << " blocks of 48 bytes cached after the threads exit";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "Blocks " << (intact ? "never shared, all returned" : "SHARED OR LEAKED") << "\n";
+
+    // Untracked pool blocks keep their size and tag through Reallocate and
+    // DeallocateBatch, and a second free of a cached block is still caught.
+    allocity::Allocator allocator(allocity::AllocatorConfig::FromString("workers=0,percpu=1"));
+    const allocity::MemoryTag tag = allocity::MemoryTags::Register("percpu.blocks");
+    void* batch[2] = {allocator.Allocate(40, tag), allocator.Reallocate(allocator.Allocate(24, tag), 56)};
+    bool untracked = allocator.GetAllocationCount() == 2 && *allocator.FindAllocation(batch[1]) == 56;
+    allocator.DeallocateBatch(batch, 2);
+    bool doubleFreeCaught = false;
+    try {
+        allocator.Deallocate(batch[0]);
+    } catch (const std::runtime_error&) {
+        doubleFreeCaught = true;
+    }
+    allocity::MemoryTags::Flush();
+    untracked = untracked && doubleFreeCaught && allocator.IsEmpty() && allocity::MemoryTags::GetLiveBytes(tag) == 0;
+    std::cout << "Untracked pool blocks: " << (untracked ? "tags balanced, double free caught" : "TAGS OR FREES WRONG") << "\n";
+}
+
+void heapSnapshotTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|         Heap Snapshot Test         |";
+    std::cout << "\n+------------------------------------+\n";
+
+    allocity::Allocator allocator(allocity::AllocatorConfig::FromString("workers=0,tracking=minimal"));
+    const allocity::MemoryTag cacheTag = allocity::MemoryTags::Register("snapshot.cache");
+    const allocity::MemoryTag bufferTag = allocity::MemoryTags::Register("snapshot.buffers");
+
+    // Fill two size-class pools, then free most blocks, leaving every
+    // eighth 40-byte block and every other 200-byte one: sparse pages that
+    // only compaction could give back.
+    size_t liveBytes = 0;
+    std::vector<void*> small;
+    {
+        allocity::MemoryTagScope scope(cacheTag);
+        for (size_t i = 0; i < 2048; ++i) {
+            small.push_back(allocator.Allocate(i % 2 == 0 ? 40 : 200));
+        }
+    }
+    for (size_t i = 0; i < small.size(); ++i) {
+        const bool keep = i % 2 == 0 ? i % 16 == 0 : i % 4 == 1;
+        if (keep) {
+            liveBytes += i % 2 == 0 ? 40 : 200;
+        } else {
+            allocator.Deallocate(small[i]);
+            small[i] = nullptr;
+        }
+    }
+    std::vector<void*> buffers;
+    for (size_t i = 0; i < 32; ++i) {
+        const size_t size = i % 2 == 0 ? 3000 + i * 100 : 4 * allocity::VirtualMemory::PageSize();
+        buffers.push_back(allocator.Allocate(size, bufferTag));
+        std::memset(buffers.back(), 1, size);
+        liveBytes += size;
+    }
+    for (size_t i = 0; i < buffers.size(); i += 4) {
+        allocator.Deallocate(buffers[i]);
+        liveBytes -= 3000 + i * 100;
+        buffers[i] = nullptr;
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "allocity_heap.snapshot").string();
+    allocator.DumpHeapSnapshot(path);
+    std::ifstream in(path, std::ios::binary);
+    const allocity::HeapSnapshot snapshot = allocity::HeapSnapshot::Read(in);
+    in.close();
+    std::cout << "Snapshot: " << std::filesystem::file_size(path) / 1024 << " KiB, " << snapshot.Slabs.size()
+              << " slabs, " << snapshot.Spans.size() << " spans\n";
+    std::cout << "Live bytes " << (snapshot.GetLiveBytes() == liveBytes ? "match" : "DO NOT MATCH")
+              << " the allocations still held\n\n";
+    snapshot.Report(std::cout);
+    std::filesystem::remove(path);
+
+    for (void* ptr : small) {
+        if (ptr != nullptr) {
+            allocator.Deallocate(ptr);
+        }
+    }
+    for (void* ptr : buffers) {
+        if (ptr != nullptr) {
+            allocator.Deallocate(ptr);
+        }
+    }
+}
+
+// Padding inside and between members: 1-byte char, 8-byte double, 2-byte
+// short, so the record is 24 bytes aligned to 8.
+struct PaddedRecord {
+    char kind;
+    double value;
+    short count;
+};
+
+struct alignas(64) CacheLineCounter {
+    std::uint64_t value;
+};
+
+using PaddedRecordLayout = allocity::VariadicLayout<char, PaddedRecord, std::uint16_t, std::uint64_t>;
+static_assert(PaddedRecordLayout::OFFSETS[0] == 0 && PaddedRecordLayout::OFFSETS[1] == 8 &&
+                  PaddedRecordLayout::OFFSETS[2] == 32 && PaddedRecordLayout::OFFSETS[3] == 40,
+              "members are packed in order at their natural alignment");
+static_assert(PaddedRecordLayout::SIZE == 48 && PaddedRecordLayout::ALIGNMENT == 8,
+              "size is rounded up to the strictest member alignment");
+
+using OverAlignedLayout = allocity::VariadicLayout<char, CacheLineCounter>;
+static_assert(OverAlignedLayout::OFFSETS[1] == 64 && OverAlignedLayout::SIZE == 128 &&
+                  OverAlignedLayout::ALIGNMENT == 64,
+              "an over-aligned member sets the alignment of the whole composite");
+
+void variadicLayoutTest() {
+    std::cout << "\n+------------------------------------+";
+    std::cout << "\n|        Variadic Layout Test        |";
+    std::cout << "\n+------------------------------------+\n";
+
+    allocity::Allocator allocator(allocity::AllocatorConfig::FromString("workers=0"));
+    // A header followed by three trailing arrays, one of them over-aligned
+    // so the composite takes the aligned path.
+    using PacketLayout = allocity::VariadicArrayLayout<PaddedRecord, float, std::uint16_t, CacheLineCounter>;
+    const PacketLayout layout({1, 101, 7, 3});
+
+    void* base = layout.Create(allocator);
+    bool aligned = reinterpret_cast<std::uintptr_t>(base) % PacketLayout::ALIGNMENT == 0;
+    bool disjoint = true;
+    for (size_t i = 0; i < PacketLayout::COUNT; ++i) {
+        aligned = aligned && layout.GetOffset(i) % PacketLayout::ALIGNMENTS[i] == 0;
+        const size_t end = layout.GetOffset(i) + layout.GetCount(i) * PacketLayout::SIZES[i];
+        const size_t next = i + 1 < PacketLayout::COUNT ? layout.GetOffset(i + 1) : layout.GetSize();
+        disjoint = disjoint && end <= next;
+    }
+
+    PaddedRecord* header = layout.Get<0>(base);
+    float* samples = layout.Get<1>(base);
+    std::uint16_t* ports = layout.Get<2>(base);
+    CacheLineCounter* counters = layout.Get<3>(base);
+    header->kind = 'p';
+    header->value = 2.5;
+    header->count = 101;
+    for (size_t i = 0; i < layout.GetCount(1); ++i) samples[i] = static_cast<float>(i);
+    for (size_t i = 0; i < layout.GetCount(2); ++i) ports[i] = static_cast<std::uint16_t>(8000 + i);
+    for (size_t i = 0; i < layout.GetCount(3); ++i) counters[i].value = i * 1000;
+    bool intact = header->kind == 'p' && header->value == 2.5 && header->count == 101;
+    for (size_t i = 0; i < layout.GetCount(1); ++i) intact = intact && samples[i] == static_cast<float>(i);
+    for (size_t i = 0; i < layout.GetCount(2); ++i) intact = intact && ports[i] == 8000 + i;
+    for (size_t i = 0; i < layout.GetCount(3); ++i) intact = intact && counters[i].value == i * 1000;
+
+    std::cout << "Composite: " << layout.GetSize() << " bytes, offsets";
+    for (size_t i = 0; i < PacketLayout::COUNT; ++i) {
+        std::cout << " " << layout.GetOffset(i);
+    }
+    std::cout << "\n";
+    std::cout << "Members " << (aligned ? "aligned" : "MISALIGNED") << ", " << (disjoint ? "disjoint" : "OVERLAPPING")
+              << ", " << (intact ? "intact" : "CORRUPTED") << "\n";
+    layout.Destroy(allocator, base);
+    std::cout << "Freed with one call: " << (allocator.IsEmpty() ? "allocator empty" : "LEAKED") << "\n";
+
+    const allocity::MemoryTag budgetTag = allocity::MemoryTags::Register("layout.budget");
+    allocity::MemoryTags::SetBudget(budgetTag, allocity::MemoryTags::NO_BUDGET, 64);
+    void* refused = nullptr;
+    {
+        allocity::MemoryTagScope scope(budgetTag);
+        refused = layout.Create(allocator);
+    }
+    allocity::MemoryTags::SetBudget(budgetTag, allocity::MemoryTags::NO_BUDGET, allocity::MemoryTags::NO_BUDGET);
+    std::cout << "Create over a hard budget " << (refused == nullptr ? "returns nullptr" : "SUCCEEDED") << "\n";
+    layout.Destroy(allocator, refused);
+
+    // Counts whose byte size, or whose running offset, wraps size_t must be
+    // refused up front rather than produce a short composite.
+    const size_t huge = std::numeric_limits<size_t>::max();
+    int refusedLayouts = 0;
+    for (const auto& counts : {std::array<size_t, PacketLayout::COUNT>{1, huge / 2, 1, 1},
+                               std::array<size_t, PacketLayout::COUNT>{1, huge / sizeof(float), 1, 1},
+                               std::array<size_t, PacketLayout::COUNT>{1, 1, 1, huge / sizeof(CacheLineCounter)}}) {
+        try {
+            PacketLayout overflowing(counts);
+            std::cout << "Overflowing layout accepted with size " << overflowing.GetSize() << "\n";
+        } catch (const std::bad_alloc&) {
+            ++refusedLayouts;
+        }
+    }
+    std::cout << "Overflowing counts: " << refusedLayouts << " of 3 refused with bad_alloc\n";
+}
+
 void compareWithStandardAllocator() {
     std::cout << "\n+------------------------------------------------------------+";
     std::cout << "\n|     Comparison with Standard Allocator (malloc/free)       |";
@@ -227,6 +2393,78 @@ int main() {
         std::cout << "\n5. Comparison with Standard Allocator (Large Allocations)\n";
         compareWithStandardAllocator();
 
+        std::cout << "\n6. Latency Histogram Test\n";
+        latencyHistogramTest(allocator);
+
+        std::cout << "\n7. ObjectPool Benchmark\n";
+        objectPoolBenchmark();
+
+        std::cout << "\n8. AoS vs SoA Column Benchmark\n";
+        soaColumnBenchmark();
+
+        std::cout << "\n9. TLSF Fragmentation Latency Test\n";
+        tlsfLatencyTest();
+
+        std::cout << "\n10. Buddy Allocator RSS Churn Benchmark\n";
+        buddyChurnBenchmark();
+
+        std::cout << "\n11. MemoryManager Compaction Test\n";
+        memoryManagerCompactionTest();
+
+        std::cout << "\n12. Memory Tag and Budget Test\n";
+        memoryTagBudgetTest(allocator);
+
+        std::cout << "\n13. Persistent Pool Restart Benchmark\n";
+        persistentPoolRestartBenchmark();
+
+        std::cout << "\n14. Shared Memory Handoff Benchmark\n";
+        sharedMemoryHandoffBenchmark();
+
+        std::cout << "\n15. Allocator Startup Benchmark\n";
+        allocatorStartupBenchmark();
+
+        std::cout << "\n16. First-Request Latency Benchmark\n";
+        firstRequestLatencyBenchmark();
+
+        std::cout << "\n17. Async Logging Benchmark\n";
+        asyncLoggingBenchmark();
+
+        std::cout << "\n18. Slab Bitmap Free Check Test\n";
+        slabBitmapFreeCheckTest(allocator);
+
+        std::cout << "\n19. AllocateAsync Benchmark\n";
+        allocateAsyncBenchmark();
+
+        std::cout << "\n20. Parallel Fill/Copy Benchmark\n";
+        parallelFillCopyBenchmark();
+
+        std::cout << "\n21. Epoch Reclamation Stack Benchmark\n";
+        epochReclamationBenchmark();
+
+        std::cout << "\n22. Scratch Stack Benchmark\n";
+        scratchStackBenchmark();
+
+        std::cout << "\n23. Lock-Free MemoryPool Benchmark\n";
+        lockFreePoolBenchmark();
+
+        std::cout << "\n24. Hashtable Rehash Latency Test\n";
+        hashtableRehashLatencyTest();
+
+        std::cout << "\n25. Lazy Pool Initialization Test\n";
+        lazyPoolInitializationTest();
+
+        std::cout << "\n26. Huge-Page Slab dTLB Benchmark\n";
+        hugePageSlabBenchmark();
+
+        std::cout << "\n27. Per-CPU Cache Benchmark\n";
+        perCpuCacheBenchmark();
+
+        std::cout << "\n28. Heap Snapshot Test\n";
+        heapSnapshotTest();
+
+        std::cout << "\n29. Variadic Layout Test\n";
+        variadicLayoutTest();
+
         std::cout << "\n+------------------------------------+\n";
         std::cout << "|        All tests completed          |\n";
         std::cout << "+------------------------------------+\n";
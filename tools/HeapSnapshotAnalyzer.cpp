@@ -0,0 +1,26 @@
+#include "../include/HeapSnapshot.hpp"
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+// Prints the fragmentation report for a file written by
+// Allocator::DumpHeapSnapshot, so that a snapshot taken on a production
+// host can be examined elsewhere.
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <snapshot file>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "Failed to open heap snapshot file: " << argv[1] << "\n";
+        return 1;
+    }
+    try {
+        allocity::HeapSnapshot::Read(in).Report(std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}